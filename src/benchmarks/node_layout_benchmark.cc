@@ -0,0 +1,101 @@
+#include <core/Definitions.hpp>
+#include <core/Utilities.hpp>
+#include <models/TreeRegressor.hpp>
+#include <models/RandomForestClassifier.hpp>
+#include <chrono>
+using namespace Lib15x;
+using namespace Lib15x::Models;
+
+template<class Model>
+double timePredictOne(const Model& model, const MatrixXd& testData, const long numberOfRepeats,
+                      double* checksum)
+{
+  double bestTime = std::numeric_limits<double>::max();
+  vector<VectorXd> instances;
+  for (long dataId = 0; dataId < testData.rows(); ++dataId)
+    instances.push_back(testData.row(dataId).transpose());
+  for (long repeatId = 0; repeatId < numberOfRepeats; ++repeatId) {
+    auto startTime = std::chrono::steady_clock::now();
+    double sum = 0;
+    for (const VectorXd& instance : instances)
+      sum += model.predictOne(instance);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now()-startTime;
+    bestTime = std::min(bestTime, elapsed.count());
+    *checksum = sum;
+  }
+  return bestTime;
+}
+
+template<class Model>
+double timePredict(const Model& model, const MatrixXd& testData, const long numberOfRepeats,
+                   double* checksum)
+{
+  double bestTime = std::numeric_limits<double>::max();
+  for (long repeatId = 0; repeatId < numberOfRepeats; ++repeatId) {
+    auto startTime = std::chrono::steady_clock::now();
+    Labels predictedLabels = model.predict(testData);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now()-startTime;
+    bestTime = std::min(bestTime, elapsed.count());
+    *checksum = predictedLabels._labelData.sum();
+  }
+  return bestTime;
+}
+
+template<class Model>
+void
+compareLayouts(const std::string& name, Model* model, const MatrixXd& sampleData,
+               const MatrixXd& testData, const long numberOfRepeats)
+{
+  double breadthFirstChecksum = 0;
+  double hotPathChecksum = 0;
+  const double breadthFirstTime = timePredictOne(*model, testData, numberOfRepeats,
+                                                 &breadthFirstChecksum);
+  const double breadthFirstBatchTime = timePredict(*model, testData, numberOfRepeats,
+                                                   &breadthFirstChecksum);
+  model->reorderNodesByPaths(sampleData);
+  const double hotPathTime = timePredictOne(*model, testData, numberOfRepeats,
+                                            &hotPathChecksum);
+  const double hotPathBatchTime = timePredict(*model, testData, numberOfRepeats,
+                                              &hotPathChecksum);
+  cout << name << ": predictOne breadth first "
+       << 1e6*breadthFirstTime/static_cast<double>(testData.rows()) << "us, hot path first "
+       << 1e6*hotPathTime/static_cast<double>(testData.rows()) << "us; predict "
+       << breadthFirstBatchTime << "s, " << hotPathBatchTime << "s"
+       << (breadthFirstChecksum == hotPathChecksum ? "" : " (MISMATCH)") << endl;
+}
+
+int main(int argc, char* argv[])
+{
+  ignoreUnusedVariables(argc, argv);
+  const long numberOfData = 200000;
+  const long numberOfTestData = 100000;
+  const long numberOfFeatures = 20;
+  const long numberOfRepeats = 3;
+
+  srand(1);
+  const MatrixXd data = MatrixXd::Random(numberOfData, numberOfFeatures);
+  const MatrixXd testData = MatrixXd::Random(numberOfTestData, numberOfFeatures);
+  Labels classLabels{ProblemType::Classification};
+  Labels regressionLabels{ProblemType::Regression};
+  classLabels._labelData.resize(numberOfData);
+  regressionLabels._labelData.resize(numberOfData);
+  for (long dataId = 0; dataId < numberOfData; ++dataId) {
+    double noise = 0.3*(rand()%100)/100.0;
+    double signal = data(dataId, 0) + data(dataId, 1)*data(dataId, 2) + noise;
+    classLabels._labelData(dataId) = (signal > 0.2) + (data(dataId, 3) > 0.5);
+    regressionLabels._labelData(dataId) = signal + data(dataId, 3)*data(dataId, 3);
+  }
+
+  // fully grown trees: deep, with many nodes off the hot paths
+  TreeRegressor<> treeRegressor{numberOfFeatures};
+  treeRegressor.train(data, regressionLabels);
+  compareLayouts("tree regressor", &treeRegressor, data, testData, numberOfRepeats);
+
+  RandomForestClassifier<> randomForest{numberOfFeatures, 3, 50, 1, 1,
+      std::numeric_limits<long>::max(), 4};
+  srand(2);
+  randomForest.train(data, classLabels);
+  compareLayouts("random forest", &randomForest, data, testData, numberOfRepeats);
+
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include <core/Definitions.hpp>
+#include <core/Utilities.hpp>
+#include <models/RandomForestClassifier.hpp>
+#include <models/GradientBoostingRegressor.hpp>
+#include <chrono>
+using namespace Lib15x;
+using namespace Lib15x::Models;
+
+template<class Model>
+double timePredict(const Model& model, const MatrixXd& testData, const long numberOfRepeats,
+                   double* checksum)
+{
+  double bestTime = std::numeric_limits<double>::max();
+  for (long repeatId = 0; repeatId < numberOfRepeats; ++repeatId) {
+    auto startTime = std::chrono::steady_clock::now();
+    Labels predictedLabels = model.predict(testData);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now()-startTime;
+    bestTime = std::min(bestTime, elapsed.count());
+    *checksum = predictedLabels._labelData.sum();
+  }
+  return bestTime;
+}
+
+int main(int argc, char* argv[])
+{
+  ignoreUnusedVariables(argc, argv);
+  const long numberOfData = 20000;
+  const long numberOfTestData = 100000;
+  const long numberOfFeatures = 20;
+  const long numberOfTrees = 200;
+  const long numberOfRepeats = 3;
+
+  srand(1);
+  const MatrixXd data = MatrixXd::Random(numberOfData, numberOfFeatures);
+  const MatrixXd testData = MatrixXd::Random(numberOfTestData, numberOfFeatures);
+  Labels classLabels{ProblemType::Classification};
+  Labels regressionLabels{ProblemType::Regression};
+  classLabels._labelData.resize(numberOfData);
+  regressionLabels._labelData.resize(numberOfData);
+  for (long dataId = 0; dataId < numberOfData; ++dataId) {
+    double noise = 0.3*(rand()%100)/100.0;
+    double signal = data(dataId, 0) + data(dataId, 1)*data(dataId, 2) + noise;
+    classLabels._labelData(dataId) = (signal > 0.2) + (data(dataId, 3) > 0.5);
+    regressionLabels._labelData(dataId) = signal + data(dataId, 3)*data(dataId, 3);
+  }
+
+  for (long maxNumberOfLeafNodes : {16L, 32L, 64L}) {
+    RandomForestClassifier<> randomForest{numberOfFeatures, 3, numberOfTrees, 1, 1,
+        std::numeric_limits<long>::max(), 4, maxNumberOfLeafNodes};
+    GradientBoostingRegressor gradientBoosting{numberOfFeatures, numberOfTrees, 1, 1,
+        std::numeric_limits<long>::max(), maxNumberOfLeafNodes};
+    gradientBoosting.setLearningRate() = 0.1;
+
+    double traversalChecksum = 0;
+    double quickScorerChecksum = 0;
+
+    srand(2);
+    randomForest.train(data, classLabels);
+    double traversalTime = timePredict(randomForest, testData, numberOfRepeats,
+                                       &traversalChecksum);
+    randomForest.setUseQuickScorer() = true;
+    srand(2);
+    randomForest.train(data, classLabels);
+    double quickScorerTime = timePredict(randomForest, testData, numberOfRepeats,
+                                         &quickScorerChecksum);
+    cout << "random forest, " << maxNumberOfLeafNodes << " leaves: traversal "
+         << traversalTime << "s, quick scorer " << quickScorerTime << "s"
+         << (traversalChecksum == quickScorerChecksum ? "" : " (MISMATCH)") << endl;
+
+    srand(3);
+    gradientBoosting.train(data, regressionLabels);
+    traversalTime = timePredict(gradientBoosting, testData, numberOfRepeats,
+                                &traversalChecksum);
+    gradientBoosting.setUseQuickScorer() = true;
+    srand(3);
+    gradientBoosting.train(data, regressionLabels);
+    quickScorerTime = timePredict(gradientBoosting, testData, numberOfRepeats,
+                                  &quickScorerChecksum);
+    cout << "gradient boosting, " << maxNumberOfLeafNodes << " leaves: traversal "
+         << traversalTime << "s, quick scorer " << quickScorerTime << "s"
+         << (traversalChecksum == quickScorerChecksum ? "" : " (MISMATCH)") << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,89 @@
+#include <core/Definitions.hpp>
+#include <core/Utilities.hpp>
+#include <internal/_Builder.hpp>
+#include <internal/_ClassificationTree.hpp>
+#include <internal/_RegressionTree.hpp>
+#include <internal/_ClassificationCriterion.hpp>
+#include <internal/_RegressionCriterion.hpp>
+#include <chrono>
+using namespace Lib15x;
+
+template<class _Tree, class _Criterion, template<class> class _Splitter>
+double timeDepthFirstBuild(const MatrixXd& data, _Criterion* criterion, _Tree* tree,
+                           const long numberOfRepeats)
+{
+  const long numberOfFeatures = data.cols();
+  _DepthFirstBuilder<_Criterion, _Splitter> builder{1, 2, std::numeric_limits<long>::max(),
+      numberOfFeatures, criterion};
+  double bestTime = std::numeric_limits<double>::max();
+  for (long repeatId = 0; repeatId < numberOfRepeats; ++repeatId) {
+    vector<long> sampleIndices(data.rows());
+    std::iota(std::begin(sampleIndices), std::end(sampleIndices), 0);
+    srand(5);
+    auto startTime = std::chrono::steady_clock::now();
+    tree->reset();
+    builder.build(data, tree, &sampleIndices);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now()-startTime;
+    bestTime = std::min(bestTime, elapsed.count());
+  }
+  return bestTime;
+}
+
+int main(int argc, char* argv[])
+{
+  ignoreUnusedVariables(argc, argv);
+  const long numberOfData = 100000;
+  const long numberOfFeatures = 10;
+  const long numberOfClasses = 3;
+  const long numberOfRepeats = 3;
+
+  srand(1);
+  const MatrixXd data = MatrixXd::Random(numberOfData, numberOfFeatures);
+  VectorXd classLabels(numberOfData);
+  VectorXd binaryLabels(numberOfData);
+  VectorXd regressionLabels(numberOfData);
+  for (long dataId = 0; dataId < numberOfData; ++dataId) {
+    double noise = 0.3*(rand()%100)/100.0;
+    double signal = data(dataId, 0) + data(dataId, 1)*data(dataId, 2) + noise;
+    classLabels(dataId) = (signal > 0.2) + (data(dataId, 3) > 0.5);
+    binaryLabels(dataId) = (signal > 0.2);
+    regressionLabels(dataId) = signal + data(dataId, 3)*data(dataId, 3);
+  }
+
+  _ClassificationCriterion<gini> classificationCriterion{&classLabels, numberOfClasses};
+  _ClassificationTree classificationTree{numberOfFeatures, numberOfClasses};
+  _ClassificationCriterion<gini> binaryCriterion{&binaryLabels, 2};
+  _ClassificationCriterion<gini, 2> fixedBinaryCriterion{&binaryLabels, 2};
+  _ClassificationTree binaryTree{numberOfFeatures, 2};
+  _RegressionCriterion regressionCriterion{&regressionLabels};
+  _RegressionTree regressionTree{numberOfFeatures};
+
+  cout << "classification, best splitter:         "
+       << timeDepthFirstBuild<_ClassificationTree, _ClassificationCriterion<gini>, _BestSplitter>
+    (data, &classificationCriterion, &classificationTree, numberOfRepeats) << "s" << endl;
+  cout << "classification, presort best splitter: "
+       << timeDepthFirstBuild<_ClassificationTree, _ClassificationCriterion<gini>,
+                              _PresortBestSplitter>
+    (data, &classificationCriterion, &classificationTree, numberOfRepeats) << "s" << endl;
+  cout << "classification, random splitter:       "
+       << timeDepthFirstBuild<_ClassificationTree, _ClassificationCriterion<gini>, _RandomSplitter>
+    (data, &classificationCriterion, &classificationTree, numberOfRepeats) << "s" << endl;
+  cout << "binary, best splitter:                 "
+       << timeDepthFirstBuild<_ClassificationTree, _ClassificationCriterion<gini>, _BestSplitter>
+    (data, &binaryCriterion, &binaryTree, numberOfRepeats) << "s" << endl;
+  cout << "binary, fixed class count criterion:   "
+       << timeDepthFirstBuild<_ClassificationTree, _ClassificationCriterion<gini, 2>,
+                              _BestSplitter>
+    (data, &fixedBinaryCriterion, &binaryTree, numberOfRepeats) << "s" << endl;
+  cout << "regression, best splitter:             "
+       << timeDepthFirstBuild<_RegressionTree, _RegressionCriterion, _BestSplitter>
+    (data, &regressionCriterion, &regressionTree, numberOfRepeats) << "s" << endl;
+  cout << "regression, presort best splitter:     "
+       << timeDepthFirstBuild<_RegressionTree, _RegressionCriterion, _PresortBestSplitter>
+    (data, &regressionCriterion, &regressionTree, numberOfRepeats) << "s" << endl;
+  cout << "regression, random splitter:           "
+       << timeDepthFirstBuild<_RegressionTree, _RegressionCriterion, _RandomSplitter>
+    (data, &regressionCriterion, &regressionTree, numberOfRepeats) << "s" << endl;
+
+  return 0;
+}
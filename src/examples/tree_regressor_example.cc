@@ -1,7 +1,7 @@
 #include <Lib15x.hpp>
 using namespace Lib15x;
 
-using LearningModel=Models::TreeRegressor;
+using LearningModel=Models::TreeRegressor<>;
 
 int main(int argc, char* argv[])
 {
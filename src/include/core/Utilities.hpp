@@ -5,6 +5,7 @@
 #include "./Definitions.hpp"
 #include <Eigen/Eigenvalues>
 #include <sys/stat.h>
+#include <cstdint>
 
 namespace Lib15x
 {
@@ -353,6 +354,148 @@ namespace Lib15x
       std::move(sortedDataVector.begin(), sortedDataVector.end(), firstStart);
       std::move(sortedIndicesVector.begin(), sortedIndicesVector.end(), secondStart);
     }
+
+    template<typename ValueType=long>
+    struct KeyValueSortBuffer {
+      vector<uint64_t> _keys;
+      vector<uint64_t> _keysBuffer;
+      vector<ValueType> _valuesBuffer;
+      vector<long> _histograms;
+      vector<char> _zeroSigns;
+    };
+
+    template<typename KeyType, typename ValueType>
+    void
+    _insertionSortKeyValue(KeyType* keys, ValueType* values, const long size)
+    {
+      for (long id = 1; id < size; ++id) {
+        const KeyType key = keys[id];
+        const ValueType value = values[id];
+        long position = id;
+        for (; position > 0 && key < keys[position-1]; --position) {
+          keys[position] = keys[position-1];
+          values[position] = values[position-1];
+        }
+        keys[position] = key;
+        values[position] = value;
+      }
+    }
+
+    // stable sort of (double, value) pairs by key, same result as sortTwoArray.
+    // The keys are mapped to order-preserving unsigned integers, which are merge
+    // sorted for medium ranges and LSD radix sorted (11-bit digits) for large ones.
+    // -0.0 and 0.0 share a sort key and keep their signs in the sorted keys.
+    template<typename ValueType>
+    void
+    sortKeyValue(double* keys, ValueType* values, const long size,
+                 KeyValueSortBuffer<ValueType>* buffer)
+    {
+      const long maxSizeForInsertionSort = 16;
+      const long minSizeForRadixSort = 4096;
+      if (size <= maxSizeForInsertionSort) {
+        _insertionSortKeyValue(keys, values, size);
+        return;
+      }
+
+      const uint64_t signBit = uint64_t{1} << 63;
+      if (static_cast<long>(buffer->_keys.size()) < size) {
+        buffer->_keys.resize(size);
+        buffer->_keysBuffer.resize(size);
+        buffer->_valuesBuffer.resize(size);
+      }
+
+      uint64_t* sortKeys = buffer->_keys.data();
+      bool hasNegativeZero = false;
+      for (long id = 0; id < size; ++id) {
+        uint64_t bits = 0;
+        if (keys[id] != 0.0) std::memcpy(&bits, &keys[id], sizeof(bits));
+        else hasNegativeZero = hasNegativeZero || std::signbit(keys[id]);
+        sortKeys[id] = (bits & signBit) ? ~bits : (bits | signBit);
+      }
+
+      uint64_t* keysBuffer = buffer->_keysBuffer.data();
+      ValueType* sortValues = values;
+      ValueType* valuesBuffer = buffer->_valuesBuffer.data();
+
+      if (size < minSizeForRadixSort) {
+        for (long runStart = 0; runStart < size; runStart += maxSizeForInsertionSort)
+          _insertionSortKeyValue(sortKeys+runStart, sortValues+runStart,
+                                 std::min(maxSizeForInsertionSort, size-runStart));
+
+        for (long width = maxSizeForInsertionSort; width < size; width *= 2) {
+          for (long runStart = 0; runStart < size; runStart += 2*width) {
+            const long middle = std::min(runStart+width, size);
+            const long runEnd = std::min(runStart+2*width, size);
+            long left = runStart;
+            long right = middle;
+            long position = runStart;
+            while (left < middle && right < runEnd) {
+              const long from = (sortKeys[right] < sortKeys[left]) ? right++ : left++;
+              keysBuffer[position] = sortKeys[from];
+              valuesBuffer[position++] = sortValues[from];
+            }
+            for (; left < middle; ++left, ++position) {
+              keysBuffer[position] = sortKeys[left];
+              valuesBuffer[position] = sortValues[left];
+            }
+            for (; right < runEnd; ++right, ++position) {
+              keysBuffer[position] = sortKeys[right];
+              valuesBuffer[position] = sortValues[right];
+            }
+          }
+          std::swap(sortKeys, keysBuffer);
+          std::swap(sortValues, valuesBuffer);
+        }
+      }
+      else {
+        const long bitsPerDigit = 11;
+        const long numberOfBuckets = 1L << bitsPerDigit;
+        const long numberOfPasses = (64 + bitsPerDigit - 1)/bitsPerDigit;
+        buffer->_histograms.assign(numberOfPasses*numberOfBuckets, 0);
+        long* histograms = buffer->_histograms.data();
+        for (long id = 0; id < size; ++id)
+          for (long pass = 0; pass < numberOfPasses; ++pass)
+            ++histograms[pass*numberOfBuckets +
+                         static_cast<long>((sortKeys[id] >> (bitsPerDigit*pass)) &
+                                           (numberOfBuckets-1))];
+
+        for (long pass = 0; pass < numberOfPasses; ++pass) {
+          long* histogram = histograms + pass*numberOfBuckets;
+          const long shift = bitsPerDigit*pass;
+          if (histogram[(sortKeys[0] >> shift) & (numberOfBuckets-1)] == size) continue;
+
+          long offset = 0;
+          for (long bucket = 0; bucket < numberOfBuckets; ++bucket) {
+            const long count = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += count;
+          }
+          for (long id = 0; id < size; ++id) {
+            const long position = histogram[(sortKeys[id] >> shift) & (numberOfBuckets-1)]++;
+            keysBuffer[position] = sortKeys[id];
+            valuesBuffer[position] = sortValues[id];
+          }
+          std::swap(sortKeys, keysBuffer);
+          std::swap(sortValues, valuesBuffer);
+        }
+      }
+
+      // the sort is stable, so the zeros come out in input order and take back their signs
+      vector<char>& zeroSigns = buffer->_zeroSigns;
+      zeroSigns.clear();
+      if (hasNegativeZero)
+        for (long id = 0; id < size; ++id)
+          if (keys[id] == 0.0) zeroSigns.push_back(std::signbit(keys[id]));
+
+      for (long id = 0, zeroId = 0; id < size; ++id) {
+        uint64_t bits = sortKeys[id];
+        bits = (bits & signBit) ? (bits ^ signBit) : ~bits;
+        std::memcpy(&keys[id], &bits, sizeof(bits));
+        if (hasNegativeZero && keys[id] == 0.0 && zeroSigns[zeroId++]) keys[id] = -0.0;
+      }
+      if (sortValues != values)
+        std::copy(sortValues, sortValues+size, values);
+    }
   }
 }
 
@@ -140,13 +140,22 @@ namespace Lib15x
         predictedLabels._labelData.resize(testData.rows());
         predictedLabels._labelData.fill(-1.0);
 
+        static_cast<const DerivedClassifier*>(this)->
+          _predictBatch(testData, testIndices, &predictedLabels._labelData);
+
+        return predictedLabels;
+      }
+
+      // Models that can score many rows at once hide this with their own _predictBatch.
+      void
+      _predictBatch(const MatrixXd& testData, const vector<long>& testIndices,
+                    VectorXd* predictedLabelData) const
+      {
         for (auto testDataId : testIndices){
           Map<const VectorXd> instance(&testData(testDataId, 0), _numberOfFeatures);
-          predictedLabels._labelData(testDataId) =
+          (*predictedLabelData)(testDataId) =
             static_cast<const DerivedClassifier*>(this)->predictOne(instance);
         }
-
-        return predictedLabels;
       }
 
       const long&
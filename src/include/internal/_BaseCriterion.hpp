@@ -1,16 +1,51 @@
 #ifndef _BASE_CRITERION
 #define _BASE_CRITERION
 
+#include <cstdint>
 #include "../core/Definitions.hpp"
 
 namespace Lib15x
 {
+  // Rows with zero weight are dropped before building; all-one weights are passed to the
+  // criteria as nullptr so they keep the unweighted scan.
+  inline vector<long>
+  _trainIndicesOfWeights(const VectorXd& weights, const char* modelName)
+  {
+    vector<long> trainIndices;
+    for (long dataId=0; dataId<weights.size(); ++dataId){
+      if (weights(dataId) < 0.0) {
+        throwException("Error happened when training %s model: "
+                       "sample weights cannot be negative, weight=%f",
+                       modelName, weights(dataId));
+      }
+      if (weights(dataId) > 0.0)
+        trainIndices.push_back(dataId);
+    }
+    return trainIndices;
+  }
+
+  inline const VectorXd*
+  _criterionWeightsOf(const VectorXd& weights)
+  {
+    return (weights.array() == 1.0).all() ? nullptr : &weights;
+  }
+
   template <class DerivedCriterion>
   class _BaseCriterion {
   public:
-    _BaseCriterion(const VectorXd* labelData) : _labelData{labelData}, _sampleIndices{nullptr},
+    _BaseCriterion(const VectorXd* labelData, const VectorXd* sampleWeights) :
+      _labelData{labelData}, _sampleWeights{sampleWeights}, _sampleCounts{nullptr},
+      _sampleIndices{nullptr},
+      _sortedLabels{nullptr}, _sortedWeights{nullptr},
       _numberOfSamplesInThisNode{0}, _startIndex{-1}, _endIndex{-1}, _currentPosition{-1},
-      _numberOfSamplesOnLeft{0}, _numberOfSamplesOnRight{0} { }
+      _numberOfSamplesOnLeft{0}, _numberOfSamplesOnRight{0},
+      _weightedNumberOfData{sampleWeights ? sampleWeights->sum() :
+          static_cast<double>(labelData->size())},
+      _weightedNumberOfSamplesInThisNode{0.0}, _weightedNumberOfSamplesOnLeft{0.0},
+      _weightedNumberOfSamplesOnRight{0.0}
+    {
+      assert(!sampleWeights || sampleWeights->size() == labelData->size());
+    }
 
     void
     init(const vector<long>* sampleIndices, const long startIndex, const long endIndex)
@@ -20,7 +55,7 @@ namespace Lib15x
       _endIndex = endIndex;
       _numberOfSamplesInThisNode = endIndex - startIndex;
 
-      static_cast<DerivedCriterion*>(this)->_init();
+      _weightedNumberOfSamplesInThisNode = static_cast<DerivedCriterion*>(this)->_init();
       reset();
     }
 
@@ -29,34 +64,128 @@ namespace Lib15x
     {
       _numberOfSamplesOnLeft=0;
       _numberOfSamplesOnRight=_numberOfSamplesInThisNode;
+      _weightedNumberOfSamplesOnLeft=0.0;
+      _weightedNumberOfSamplesOnRight=_weightedNumberOfSamplesInThisNode;
       _currentPosition = _startIndex;
       static_cast<DerivedCriterion*>(this)->_reset();
     }
 
+    void
+    resetToSortedLabels(const double* sortedLabels, const double* sortedWeights=nullptr)
+    {
+      assert((sortedWeights != nullptr) == isWeighted());
+      _sortedLabels = sortedLabels;
+      _sortedWeights = sortedWeights;
+      reset();
+    }
+
+    const VectorXd*
+    labelData() const
+    {
+      return _labelData;
+    }
+
+    // Multiplicities of the rows, e.g. the bootstrap of a forest tree; the weight of a row
+    // becomes its count times its sample weight. nullptr counts every row once. The builders
+    // take each counted row once, so minSamplesInALeaf and minSamplesInANode count distinct
+    // rows, not draws.
+    void
+    setSampleCounts(const uint8_t* sampleCounts)
+    {
+      _sampleCounts = sampleCounts;
+    }
+
+    // Impurity improvements are weighted by the share of the tree's samples in the node. The
+    // builders set the total from the samples they build from, so repeated rows and the same
+    // rows weighted by their repeats give the same improvements.
+    void
+    setTrainingSamples(const vector<long>& sampleIndices)
+    {
+      _weightedNumberOfData = 0.0;
+      for (long dataId : sampleIndices)
+        _weightedNumberOfData += sampleWeight(dataId);
+    }
+
+    bool
+    isWeighted() const
+    {
+      return _sampleWeights || _sampleCounts;
+    }
+
+    double
+    sampleWeight(const long dataId) const
+    {
+      const double weight = _sampleWeights ? (*_sampleWeights)(dataId) : 1.0;
+      return _sampleCounts ? weight*_sampleCounts[dataId] : weight;
+    }
+
     void
     update(const long newPos)
     {
       _numberOfSamplesOnLeft += newPos-_currentPosition;
       _numberOfSamplesOnRight -= newPos-_currentPosition;
-      static_cast<DerivedCriterion*>(this)->_update(newPos);
+      double weight = static_cast<DerivedCriterion*>(this)->_update(newPos);
+      _weightedNumberOfSamplesOnLeft += weight;
+      _weightedNumberOfSamplesOnRight -= weight;
       _currentPosition = newPos;
     }
 
+    void
+    resetBins(const long numberOfBins)
+    {
+      _binSampleCounts.assign(numberOfBins, 0);
+      _binWeights.assign(numberOfBins, 0.0);
+      static_cast<DerivedCriterion*>(this)->_resetBins(numberOfBins);
+    }
+
+    void
+    accumulateBin(const long binIndex, const long dataId)
+    {
+      double weight = sampleWeight(dataId);
+      ++_binSampleCounts[binIndex];
+      _binWeights[binIndex] += weight;
+      static_cast<DerivedCriterion*>(this)->_accumulateBin(binIndex, dataId, weight);
+    }
+
+    void
+    updateByBin(const long binIndex)
+    {
+      _numberOfSamplesOnLeft += _binSampleCounts[binIndex];
+      _numberOfSamplesOnRight -= _binSampleCounts[binIndex];
+      _weightedNumberOfSamplesOnLeft += _binWeights[binIndex];
+      _weightedNumberOfSamplesOnRight -= _binWeights[binIndex];
+      static_cast<DerivedCriterion*>(this)->_updateByBin(binIndex);
+    }
+
+    long
+    binSampleCount(const long binIndex) const
+    {
+      return _binSampleCounts[binIndex];
+    }
+
+    long
+    numberOfSamplesOnLeft() const
+    {
+      return _numberOfSamplesOnLeft;
+    }
+
+    long
+    numberOfSamplesOnRight() const
+    {
+      return _numberOfSamplesOnRight;
+    }
+
     double
     impurityImprove(const double impurity)
     {
       double impurityLeft = 0;
       double impurityRight = 0;
-      long numberOfData=_labelData->size();
       static_cast<DerivedCriterion*>(this)->
         calculateChildrenImpurity(&impurityLeft, &impurityRight);
 
-      double weightTotal = static_cast<double>(_numberOfSamplesInThisNode)/
-        static_cast<double>(numberOfData);
-      double weightLeft = static_cast<double>(_numberOfSamplesOnLeft)/
-        static_cast<double>(_numberOfSamplesInThisNode);
-      double weightRight = static_cast<double>(_numberOfSamplesOnRight)/
-        static_cast<double>(_numberOfSamplesInThisNode);
+      double weightTotal = _weightedNumberOfSamplesInThisNode/_weightedNumberOfData;
+      double weightLeft = _weightedNumberOfSamplesOnLeft/_weightedNumberOfSamplesInThisNode;
+      double weightRight = _weightedNumberOfSamplesOnRight/_weightedNumberOfSamplesInThisNode;
 
       double impurityImprove =
         weightTotal * (impurity - weightRight * impurityRight - weightLeft * impurityLeft);
@@ -66,13 +195,23 @@ namespace Lib15x
 
   protected:
     const VectorXd* _labelData;
+    const VectorXd* _sampleWeights;
+    const uint8_t* _sampleCounts;
     const vector<long>* _sampleIndices;
+    const double* _sortedLabels;
+    const double* _sortedWeights;
     long _numberOfSamplesInThisNode;
     long _startIndex;
     long _endIndex;
     long _currentPosition;
     long _numberOfSamplesOnLeft;
     long _numberOfSamplesOnRight;
+    double _weightedNumberOfData;
+    double _weightedNumberOfSamplesInThisNode;
+    double _weightedNumberOfSamplesOnLeft;
+    double _weightedNumberOfSamplesOnRight;
+    vector<long> _binSampleCounts;
+    vector<double> _binWeights;
   };
 }
 #endif //_BASE_CRITERION
@@ -1,5 +1,6 @@
 #ifndef _BASE_TREE
 #define _BASE_TREE
+#include <cstdint>
 #include "../core/Definitions.hpp"
 
 namespace Lib15x
@@ -25,16 +26,28 @@ namespace Lib15x
   public:
     explicit _BaseTree (const long numberOfFeatures) :
       _maxDepthOfThisTree{0}, _headNodeIndex{-1} , _nodeCount{0},
-      _numberOfFeatures{numberOfFeatures} { }
+      _numberOfFeatures{numberOfFeatures}, _isFinalized{false} { }
 
     void reset()
     {
       _maxDepthOfThisTree = 0;
       _headNodeIndex = -1;
+      _nodeCount = 0;
       _nodes.clear();
+      _flatChildIndices.clear();
+      _flatFeatureIndices.clear();
+      _flatThresholds.clear();
+      _isFinalized = false;
       static_cast<DerivedTree*>(this)->_reset();
     }
 
+    void
+    reserve(const long numberOfNodes)
+    {
+      _nodes.reserve(numberOfNodes);
+      static_cast<DerivedTree*>(this)->_reserve(numberOfNodes);
+    }
+
     long
     addNode(long parentNodeIndex, const bool isLeft, const long featureIndex,
             const double threshold)
@@ -52,12 +65,197 @@ namespace Lib15x
       return _nodeCount-1;
     }
 
+    // Compiles the built tree into the arrays used for prediction and releases the build
+    // representation. Nodes are laid out breadth first so the right child of a split is
+    // always its left child plus one; leaves have a negative feature index. Children always
+    // come after their parent, also after reorderNodes.
+    void
+    finalize()
+    {
+      if (_nodeCount >= std::numeric_limits<int32_t>::max()) {
+        throwException("Error happened when finalizing tree: "
+                       "number of nodes %ld does not fit 32-bit indices", _nodeCount);
+      }
+
+      _flatChildIndices.assign(_nodeCount, -1);
+      _flatFeatureIndices.assign(_nodeCount, -1);
+      _flatThresholds.assign(_nodeCount, 0.0);
+      vector<long> flatIndexOfNode(_nodeCount, -1);
+      vector<long> nodeOfFlatIndex;
+      nodeOfFlatIndex.reserve(_nodeCount);
+      if (_nodeCount > 0) nodeOfFlatIndex.push_back(_headNodeIndex);
+
+      for (long flatIndex = 0; flatIndex < static_cast<long>(nodeOfFlatIndex.size());
+           ++flatIndex) {
+        const _Node& node = _nodes[nodeOfFlatIndex[flatIndex]];
+        flatIndexOfNode[nodeOfFlatIndex[flatIndex]] = flatIndex;
+        if (node._isLeaf) continue;
+
+        _flatFeatureIndices[flatIndex] = static_cast<int32_t>(node._featureIndex);
+        _flatThresholds[flatIndex] = node._threshold;
+        _flatChildIndices[flatIndex] = static_cast<int32_t>(nodeOfFlatIndex.size());
+        nodeOfFlatIndex.push_back(node._leftChildIndex);
+        nodeOfFlatIndex.push_back(node._rightChildIndex);
+      }
+
+      static_cast<DerivedTree*>(this)->_finalizeLeaves(flatIndexOfNode);
+      vector<_Node>().swap(_nodes);
+      _headNodeIndex = 0;
+      _isFinalized = true;
+    }
+
+    long
+    leafIndexOf(const double* instance) const
+    {
+      assert(_isFinalized);
+      long nodeIndex = 0;
+      while (_flatFeatureIndices[nodeIndex] >= 0) {
+        bool goesRight = !(instance[_flatFeatureIndices[nodeIndex]] < _flatThresholds[nodeIndex]);
+        nodeIndex = _flatChildIndices[nodeIndex] + goesRight;
+      }
+      return nodeIndex;
+    }
+
+    // Finds the leaves of a block of rows. data+rowOffsets[rowId] is the first feature of a
+    // row; the rows advance through the tree together so their loads overlap.
+    void
+    leafIndicesOf(const double* data, const long* rowOffsets, const long numberOfRows,
+                  int32_t* leafIndices) const
+    {
+      assert(_isFinalized);
+      long rowId = 0;
+      for (; rowId+4 <= numberOfRows; rowId += 4)
+        _leafIndicesOfFourRows(data, rowOffsets+rowId, leafIndices+rowId);
+      for (; rowId < numberOfRows; ++rowId)
+        leafIndices[rowId] = static_cast<int32_t>(leafIndexOf(data+rowOffsets[rowId]));
+    }
+
+    // How many of the rows pass through every node.
+    vector<double>
+    nodeVisitCountsOf(const double* data, const long* rowOffsets,
+                      const long numberOfRows) const
+    {
+      assert(_isFinalized);
+      vector<double> visitCounts(numberOfNodes(), 0.0);
+      for (long rowId = 0; rowId < numberOfRows; ++rowId) {
+        const double* instance = data+rowOffsets[rowId];
+        long nodeIndex = 0;
+        ++visitCounts[nodeIndex];
+        while (_flatFeatureIndices[nodeIndex] >= 0) {
+          bool goesRight = !(instance[_flatFeatureIndices[nodeIndex]] < _flatThresholds[nodeIndex]);
+          nodeIndex = _flatChildIndices[nodeIndex] + goesRight;
+          ++visitCounts[nodeIndex];
+        }
+      }
+      return visitCounts;
+    }
+
+    // Lays the nodes out hot path first, depth first into the more visited child: the children
+    // of a node come right after the pair holding it when it is the more visited of the pair,
+    // so following the likely branch walks forward through memory and the hot paths share
+    // cache lines. visitCounts holds a frequency per node, e.g. from nodeVisitCountsOf.
+    // Predictions do not change, the leaf indices do.
+    void
+    reorderNodes(const vector<double>& visitCounts)
+    {
+      assert(_isFinalized);
+      assert(static_cast<long>(visitCounts.size()) == numberOfNodes());
+      const long numberOfNodesInTree = numberOfNodes();
+      vector<int32_t> childIndices(numberOfNodesInTree);
+      vector<int32_t> featureIndices(numberOfNodesInTree);
+      vector<double> thresholds(numberOfNodesInTree);
+      vector<std::pair<long, long> > pendingNodes;
+      if (numberOfNodesInTree > 0) pendingNodes.emplace_back(0, 0);
+      long numberOfPlacedNodes = 1;
+      while (!pendingNodes.empty()) {
+        const long nodeIndex = pendingNodes.back().first;
+        const long newNodeIndex = pendingNodes.back().second;
+        pendingNodes.pop_back();
+        featureIndices[newNodeIndex] = _flatFeatureIndices[nodeIndex];
+        thresholds[newNodeIndex] = _flatThresholds[nodeIndex];
+        if (_flatFeatureIndices[nodeIndex] < 0) {
+          childIndices[newNodeIndex] = _flatChildIndices[nodeIndex];
+          continue;
+        }
+
+        const long leftChildIndex = _flatChildIndices[nodeIndex];
+        childIndices[newNodeIndex] = static_cast<int32_t>(numberOfPlacedNodes);
+        const bool rightIsHot = visitCounts[leftChildIndex+1] > visitCounts[leftChildIndex];
+        if (rightIsHot) {
+          pendingNodes.emplace_back(leftChildIndex, numberOfPlacedNodes);
+          pendingNodes.emplace_back(leftChildIndex+1, numberOfPlacedNodes+1);
+        }
+        else {
+          pendingNodes.emplace_back(leftChildIndex+1, numberOfPlacedNodes+1);
+          pendingNodes.emplace_back(leftChildIndex, numberOfPlacedNodes);
+        }
+        numberOfPlacedNodes += 2;
+      }
+
+      _flatChildIndices.swap(childIndices);
+      _flatFeatureIndices.swap(featureIndices);
+      _flatThresholds.swap(thresholds);
+    }
+
+    long
+    numberOfNodes() const
+    {
+      return _flatFeatureIndices.size();
+    }
+
+    // Memory of the arrays read by prediction.
+    long
+    numberOfBytes() const
+    {
+      return numberOfNodes()*static_cast<long>(2*sizeof(int32_t)+sizeof(double)) +
+        static_cast<const DerivedTree*>(this)->_numberOfLeafBytes();
+    }
+
+    // Nodes visited from the root to every node, e.g. the cost of reaching a leaf.
+    vector<long>
+    pathLengthsOfNodes() const
+    {
+      assert(_isFinalized);
+      vector<long> pathLengths(numberOfNodes(), 1);
+      for (long nodeIndex = 0; nodeIndex < numberOfNodes(); ++nodeIndex)
+        if (_flatFeatureIndices[nodeIndex] >= 0) {
+          pathLengths[_flatChildIndices[nodeIndex]] = pathLengths[nodeIndex]+1;
+          pathLengths[_flatChildIndices[nodeIndex]+1] = pathLengths[nodeIndex]+1;
+        }
+      return pathLengths;
+    }
+
   public:
     long _maxDepthOfThisTree;
     long _headNodeIndex;
     vector<_Node> _nodes;
     long _nodeCount;
     long _numberOfFeatures;
+    vector<int32_t> _flatChildIndices;
+    vector<int32_t> _flatFeatureIndices;
+    vector<double> _flatThresholds;
+    bool _isFinalized;
+
+  private:
+    void
+    _leafIndicesOfFourRows(const double* data, const long* rowOffsets, int32_t* leafIndices) const
+    {
+      const double* rows[4] = {data+rowOffsets[0], data+rowOffsets[1],
+                               data+rowOffsets[2], data+rowOffsets[3]};
+      int32_t nodes[4] = {0, 0, 0, 0};
+      bool allLeaves = false;
+      while (!allLeaves) {
+        allLeaves = true;
+        for (int lane = 0; lane < 4; ++lane) {
+          const int32_t feature = _flatFeatureIndices[nodes[lane]];
+          if (feature < 0) continue;
+          allLeaves = false;
+          const bool goesRight = !(rows[lane][feature] < _flatThresholds[nodes[lane]]);
+          nodes[lane] = _flatChildIndices[nodes[lane]] + goesRight;
+        }
+      }
+      std::copy(nodes, nodes+4, leafIndices);
+    }
   };
 }
 
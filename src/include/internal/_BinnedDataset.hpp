@@ -0,0 +1,157 @@
+#ifndef _BINNED_DATASET
+#define _BINNED_DATASET
+#include "../core/Definitions.hpp"
+#include "./_QuantileSketch.hpp"
+#include <cstdint>
+
+namespace Lib15x
+{
+  template<typename BinType>
+  class _BinnedDataset {
+  public:
+    static constexpr long MaxNumberOfBins =
+      static_cast<long>(std::numeric_limits<BinType>::max()) + 1;
+
+    // With sketchEpsilon > 0 the bin thresholds come from quantile sketches of the columns
+    // instead of sorting them, with at most 1/sketchEpsilon candidates per feature.
+    template<class FeatureStore>
+    explicit _BinnedDataset(const FeatureStore& data, const long maxNumberOfBins=MaxNumberOfBins,
+                            const double sketchEpsilon=0.0) :
+      _numberOfData{0}, _numberOfFeatures{0},
+      _maxNumberOfBins{std::min(maxNumberOfBins, MaxNumberOfBins)},
+      _sketchEpsilon{sketchEpsilon}
+    {
+      if (_maxNumberOfBins < 2) {
+        throwException("Error happened when binning data: "
+                       "maximum number of bins must be at least 2, provided (%ld).\n",
+                       maxNumberOfBins);
+      }
+      reset(data);
+    }
+
+    template<class FeatureStore>
+    void
+    reset(const FeatureStore& data)
+    {
+      _numberOfData = data.rows();
+      _numberOfFeatures = data.cols();
+      _bins.resize(static_cast<size_t>(_numberOfData*_numberOfFeatures));
+      _binThresholds.resize(_numberOfFeatures);
+
+      if (_sketchEpsilon <= 0.0)
+        _sortedValues.resize(_numberOfData);
+      for (long featId = 0; featId < _numberOfFeatures; ++featId) {
+        const double* column = data.column(featId);
+        if (_sketchEpsilon > 0.0)
+          _computeSketchedBinThresholds(column, &_binThresholds[featId]);
+        else {
+          std::copy(column, column+_numberOfData, std::begin(_sortedValues));
+          std::sort(std::begin(_sortedValues), std::end(_sortedValues));
+          _computeBinThresholds(&_binThresholds[featId]);
+        }
+
+        BinType* binColumn = &_bins[featId*_numberOfData];
+        for (long dataId = 0; dataId < _numberOfData; ++dataId)
+          binColumn[dataId] = static_cast<BinType>(findBin(featId, column[dataId]));
+      }
+    }
+
+    const BinType*
+    column(const long featureIndex) const
+    {
+      return &_bins[featureIndex*_numberOfData];
+    }
+
+    long
+    findBin(const long featureIndex, const double value) const
+    {
+      const vector<double>& thresholds = _binThresholds[featureIndex];
+      return std::lower_bound(std::begin(thresholds), std::end(thresholds), value) -
+        std::begin(thresholds);
+    }
+
+    long
+    numberOfBins(const long featureIndex) const
+    {
+      return static_cast<long>(_binThresholds[featureIndex].size())+1;
+    }
+
+    double
+    threshold(const long featureIndex, const long binIndex) const
+    {
+      return _binThresholds[featureIndex][binIndex];
+    }
+
+    long
+    numberOfData() const
+    {
+      return _numberOfData;
+    }
+
+    double
+    sketchEpsilon() const
+    {
+      return _sketchEpsilon;
+    }
+
+  private:
+    void
+    _computeBinThresholds(vector<double>* thresholds)
+    {
+      thresholds->clear();
+      const vector<double>& sortedValues = _sortedValues;
+      vector<long>& ranks = _ranks;
+      ranks.clear();
+      for (long dataId = 1; dataId < _numberOfData; ++dataId)
+        if (sortedValues[dataId] > sortedValues[dataId-1] + _featureThreshold)
+          ranks.push_back(dataId);
+
+      const long numberOfCandidates = static_cast<long>(ranks.size());
+      if (numberOfCandidates < _maxNumberOfBins) {
+        for (auto rank : ranks)
+          thresholds->push_back((sortedValues[rank-1] + sortedValues[rank])/2.0);
+        return;
+      }
+
+      long candidateId = 0;
+      for (long binId = 1; binId < _maxNumberOfBins && candidateId < numberOfCandidates; ++binId) {
+        const long targetRank = binId*_numberOfData/_maxNumberOfBins;
+        while (candidateId < numberOfCandidates && ranks[candidateId] < targetRank)
+          ++candidateId;
+        if (candidateId == numberOfCandidates) break;
+        const long rank = ranks[candidateId++];
+        thresholds->push_back((sortedValues[rank-1] + sortedValues[rank])/2.0);
+      }
+    }
+
+    // Each chunk of rows is sketched on its own and merged, as separate threads or blocks of a
+    // streamed file would be.
+    void
+    _computeSketchedBinThresholds(const double* column, vector<double>* thresholds) const
+    {
+      _QuantileSketch sketch{_sketchEpsilon};
+      for (long chunkStart = 0; chunkStart < _numberOfData; chunkStart += _sketchChunkSize) {
+        _QuantileSketch chunkSketch{_sketchEpsilon};
+        const long chunkEnd = std::min(_numberOfData, chunkStart+_sketchChunkSize);
+        for (long dataId = chunkStart; dataId < chunkEnd; ++dataId)
+          chunkSketch.push(column[dataId]);
+        sketch.merge(chunkSketch);
+      }
+      const long maxNumberOfCuts =
+        std::min(_maxNumberOfBins-1, static_cast<long>(std::ceil(1.0/_sketchEpsilon)));
+      *thresholds = sketch.cutPoints(maxNumberOfCuts, _featureThreshold);
+    }
+
+    long _numberOfData;
+    long _numberOfFeatures;
+    long _maxNumberOfBins;
+    double _sketchEpsilon;
+    long _sketchChunkSize=1L<<16;
+    vector<BinType> _bins;
+    vector<vector<double> > _binThresholds;
+    vector<double> _sortedValues;
+    vector<long> _ranks;
+    double _featureThreshold=1e-7;
+  };
+}
+#endif // _BINNED_DATASET
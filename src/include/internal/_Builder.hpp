@@ -2,8 +2,14 @@
 #define _BUILDER
 #include "../core/Definitions.hpp"
 #include "./_Splitter.hpp"
-#include <stack>
-#include <queue>
+#include "./_BinnedDataset.hpp"
+#include "./_FeatureStore.hpp"
+#include "./_Parallel.hpp"
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 
 namespace Lib15x
 {
@@ -14,25 +20,145 @@ namespace Lib15x
 
     _DepthFirstBuilder(const long minSamplesInALeaf, const long minSamplesInANode,
                        const long maxDepthAllowed, const long numberOfFeaturesToSplit,
-                       _Criterion* criterion) :
+                       _Criterion* criterion, const long numberOfThreads=1,
+                       const long minSamplesInAParallelTask=10000,
+                       const long numberOfSplitThreads=1) :
       _minSamplesInANode{minSamplesInANode}, _minSamplesInALeaf{minSamplesInALeaf},
       _maxDepthAllowed{maxDepthAllowed}, _numberOfFeaturesToSplit{numberOfFeaturesToSplit},
-      _criterion{criterion} { }
+      _criterion{criterion}, _numberOfThreads{numberOfThreads},
+      _minSamplesInAParallelTask{minSamplesInAParallelTask},
+      _numberOfSplitThreads{numberOfSplitThreads} { }
 
     template<class Tree>
     void
     build(const MatrixXd& trainData, Tree* tree, vector<long>* sampleIndices)
     {
-      const long numberOfData = trainData.rows();
-      Splitter splitter(&trainData, _criterion,
-                        _minSamplesInALeaf, _numberOfFeaturesToSplit, sampleIndices);
-      std::stack<_StackRecord> recordStack;
+      _featureStore.reset(trainData);
+      build(_featureStore, tree, sampleIndices);
+    }
+
+    template<class Tree>
+    void
+    build(const _FeatureStore& featureStore, Tree* tree, vector<long>* sampleIndices)
+    {
+      const long numberOfData = sampleIndices->size();
+      _criterion->setTrainingSamples(*sampleIndices);
+      if (_splitter)
+        _splitter->resetData(&featureStore, sampleIndices);
+      else
+        _splitter = std::make_unique<Splitter>(&featureStore, _criterion,
+                                               _minSamplesInALeaf, _numberOfFeaturesToSplit,
+                                               sampleIndices, _numberOfSplitThreads);
+      _splitter->setRandomEngine(_randomEngine);
+      tree->reserve(_numberOfNodesOfLastTree);
+      _StackRecord rootRecord(0, numberOfData, 0, false, std::numeric_limits<double>::max(),
+                              0, -1);
+
+      if (_numberOfThreads > 1 && numberOfData >= _minSamplesInAParallelTask)
+        tree->_maxDepthOfThisTree = _parallelBuild(*_splitter, tree, rootRecord);
+      else
+        tree->_maxDepthOfThisTree = _serialBuild(_splitter.get(), _criterion, tree, rootRecord,
+                                                 &_recordStack, nullptr, nullptr);
+      _numberOfNodesOfLastTree = tree->_nodeCount;
+    }
+
+    // Takes the feature sampling and random thresholds from randomEngine instead of rand(), so
+    // trees built concurrently each have a reproducible stream.
+    void
+    setRandomEngine(std::mt19937* randomEngine)
+    {
+      _randomEngine = randomEngine;
+    }
+
+    // Subtrees with fewer samples than this are built by the thread that split their parent.
+    long&
+    setMinSamplesInAParallelTask()
+    {
+      return _minSamplesInAParallelTask;
+    }
+
+  private:
+    struct _TaskQueue {
+      std::mutex _mutex;
+      std::condition_variable _condition;
+      vector<_StackRecord> _records;
+      long _numberOfPendingTasks=0;
+      std::exception_ptr _exception;
+    };
+
+    template<class Tree>
+    long
+    _parallelBuild(const Splitter& splitter, Tree* tree, const _StackRecord& rootRecord)
+    {
+      _TaskQueue taskQueue;
+      taskQueue._records.push_back(rootRecord);
+      taskQueue._numberOfPendingTasks = 1;
+      std::mutex treeMutex;
+      vector<long> maxDepthOfEachThread(_numberOfThreads, -1);
+      vector<std::mt19937> threadRandomEngines;
+      if (_randomEngine)
+        for (long threadId = 0; threadId < _numberOfThreads; ++threadId)
+          threadRandomEngines.emplace_back((*_randomEngine)());
+
+      auto worker = [&](const long threadId) {
+        _Criterion criterion{*_criterion};
+        Splitter threadSplitter{splitter, &criterion};
+        if (_randomEngine) threadSplitter.setRandomEngine(&threadRandomEngines[threadId]);
+        vector<_StackRecord> recordStack;
+        while (true) {
+          std::unique_lock<std::mutex> lock(taskQueue._mutex);
+          taskQueue._condition.wait(lock, [&taskQueue]
+                                    {return !taskQueue._records.empty() ||
+                                        taskQueue._numberOfPendingTasks == 0 ||
+                                        taskQueue._exception;});
+          if (taskQueue._records.empty() || taskQueue._exception) break;
+          _StackRecord record = taskQueue._records.back();
+          taskQueue._records.pop_back();
+          lock.unlock();
+
+          long maxDepth = -1;
+          try {
+            maxDepth = _serialBuild(&threadSplitter, &criterion, tree, record,
+                                    &recordStack, &treeMutex, &taskQueue);
+          }
+          catch (...) {
+            lock.lock();
+            if (!taskQueue._exception) taskQueue._exception = std::current_exception();
+            taskQueue._condition.notify_all();
+            break;
+          }
+          maxDepthOfEachThread[threadId] = std::max(maxDepthOfEachThread[threadId], maxDepth);
+
+          lock.lock();
+          if (--taskQueue._numberOfPendingTasks == 0) taskQueue._condition.notify_all();
+        }
+      };
+
+      vector<std::thread> threads;
+      for (long threadId = 1; threadId < _numberOfThreads; ++threadId)
+        threads.emplace_back(worker, threadId);
+      worker(0);
+      for (auto& thread : threads)
+        thread.join();
+
+      if (taskQueue._exception) std::rethrow_exception(taskQueue._exception);
+
+      return *std::max_element(std::begin(maxDepthOfEachThread), std::end(maxDepthOfEachThread));
+    }
+
+    template<class Tree>
+    long
+    _serialBuild(Splitter* splitter, _Criterion* criterion, Tree* tree,
+                 const _StackRecord& subtreeRecord, vector<_StackRecord>* recordStack,
+                 std::mutex* treeMutex, _TaskQueue* taskQueue)
+    {
       long maxDepthSoFar = -1;
-      recordStack.emplace(0, numberOfData, 0, false, std::numeric_limits<double>::max(), 0, -1);
+      recordStack->clear();
+      recordStack->push_back(subtreeRecord);
 
-      while (!recordStack.empty()) {
-        _StackRecord stackRecord = recordStack.top();
-        recordStack.pop();
+      while (!recordStack->empty()) {
+        _StackRecord stackRecord = recordStack->back();
+        recordStack->pop_back();
 
         const long startIndex = stackRecord._startIndex;
         const long endIndex = stackRecord._endIndex;
@@ -43,52 +169,77 @@ namespace Lib15x
         long numberOfConstantFeatures = stackRecord._numberOfConstantFeatures;
         const long numberOfSamplesInThisNode = endIndex - startIndex;
 
-        splitter.resetToThisNode(startIndex, endIndex);
+        splitter->resetToThisNode(startIndex, endIndex);
 
         bool isLeaf = (nodeDepth >= _maxDepthAllowed) ||
           (numberOfSamplesInThisNode < _minSamplesInANode) ||
           (numberOfSamplesInThisNode < 2 * _minSamplesInALeaf);
 
-        if (parentNodeIndex<0) impurity = splitter.calculateNodeImpurity();
+        if (parentNodeIndex<0) impurity = splitter->calculateNodeImpurity();
 
         isLeaf = isLeaf || (impurity <= _minImpurity);
 
         _SplitRecord splitRecord;
         if (!isLeaf) {
-          splitRecord = splitter.splitNode(impurity, &numberOfConstantFeatures);
+          splitRecord = splitter->splitNode(impurity, &numberOfConstantFeatures);
           isLeaf = isLeaf || (splitRecord._splitSampleIndex >= endIndex);
         }
 
+        std::unique_lock<std::mutex> treeLock;
+        if (treeMutex) treeLock = std::unique_lock<std::mutex>(*treeMutex);
+
         const long currentNodeIndex = tree->addNode(parentNodeIndex, isLeft,
                                                     splitRecord._featureIndexToSplit,
                                                     splitRecord._threshold);
 
         if (isLeaf) {
-          auto leafValue = _criterion->nodeValue();
+          auto leafValue = criterion->nodeValue();
           tree->addLeaf(currentNodeIndex, std::move(leafValue));
         }
-        else {
-          recordStack.emplace(splitRecord._splitSampleIndex, endIndex, nodeDepth + 1,
-                              false, splitRecord._impurityRight, numberOfConstantFeatures,
-                              currentNodeIndex);
-          recordStack.emplace(startIndex, splitRecord._splitSampleIndex, nodeDepth + 1,
-                              true, splitRecord._impurityLeft, numberOfConstantFeatures,
-                              currentNodeIndex);
+
+        if (treeMutex) treeLock.unlock();
+
+        if (!isLeaf) {
+          _StackRecord rightRecord(splitRecord._splitSampleIndex, endIndex, nodeDepth + 1,
+                                   false, splitRecord._impurityRight, numberOfConstantFeatures,
+                                   currentNodeIndex);
+          if (taskQueue && endIndex - splitRecord._splitSampleIndex >= _minSamplesInAParallelTask) {
+            // the constant features counted so far sit at the front of this splitter's
+            // feature order, which the splitter of whichever worker takes the task does not share
+            rightRecord._numberOfConstantFeatures = 0;
+            std::lock_guard<std::mutex> lock(taskQueue->_mutex);
+            taskQueue->_records.push_back(rightRecord);
+            ++taskQueue->_numberOfPendingTasks;
+            taskQueue->_condition.notify_one();
+          }
+          else
+            recordStack->push_back(rightRecord);
+
+          recordStack->emplace_back(startIndex, splitRecord._splitSampleIndex, nodeDepth + 1,
+                                    true, splitRecord._impurityLeft, numberOfConstantFeatures,
+                                    currentNodeIndex);
         }
 
         if (nodeDepth > maxDepthSoFar)
           maxDepthSoFar = nodeDepth;
       }
 
-      tree->_maxDepthOfThisTree = maxDepthSoFar;
+      return maxDepthSoFar;
     }
 
-  private:
     long _minSamplesInANode;
     long _minSamplesInALeaf;
     long _maxDepthAllowed;
     long _numberOfFeaturesToSplit;
     _Criterion* _criterion;
+    long _numberOfThreads;
+    long _minSamplesInAParallelTask;
+    long _numberOfSplitThreads;
+    _FeatureStore _featureStore;
+    std::unique_ptr<Splitter> _splitter;
+    vector<_StackRecord> _recordStack;
+    long _numberOfNodesOfLastTree=0;
+    std::mt19937* _randomEngine=nullptr;
     double _minImpurity=1e-7;
   };
 
@@ -99,29 +250,45 @@ namespace Lib15x
 
     _BestFirstBuilder(const long minSamplesInALeaf, const long minSamplesInANode,
                       const long maxDepthAllowed, const long maxNumberOfLeafNodes,
-                      const long numberOfFeaturesToSplit, _Criterion* criterion) :
+                      const long numberOfFeaturesToSplit, _Criterion* criterion,
+                      const long numberOfSplitThreads=1) :
       _minSamplesInANode{minSamplesInANode}, _minSamplesInALeaf{minSamplesInALeaf},
       _maxDepthAllowed{maxDepthAllowed}, _maxNumberOfLeafNodes{maxNumberOfLeafNodes},
-      _numberOfFeaturesToSplit{numberOfFeaturesToSplit}, _criterion{criterion} { }
+      _numberOfFeaturesToSplit{numberOfFeaturesToSplit}, _criterion{criterion},
+      _numberOfSplitThreads{numberOfSplitThreads} { }
 
     template<class Tree>
     void
     build(const MatrixXd& trainData, Tree* tree, vector<long>* sampleIndices)
+    {
+      _featureStore.reset(trainData);
+      build(_featureStore, tree, sampleIndices);
+    }
+
+    template<class Tree>
+    void
+    build(const _FeatureStore& featureStore, Tree* tree, vector<long>* sampleIndices)
     {
       auto compareRecord =
         [](const _PriorityQueueRecord& a, const _PriorityQueueRecord& b)
         {return a._impurityImprovement < b._impurityImprovement;};
 
-      using PriorityQueue =
-        std::priority_queue<_PriorityQueueRecord, vector<_PriorityQueueRecord>, decltype(compareRecord)>;
-
-      const long numberOfData = trainData.rows();
-
-      Splitter splitter(&trainData, _criterion,
-                        _minSamplesInALeaf, _numberOfFeaturesToSplit, sampleIndices);
+      const long numberOfData = sampleIndices->size();
+      _criterion->setTrainingSamples(*sampleIndices);
+
+      if (_splitter)
+        _splitter->resetData(&featureStore, sampleIndices);
+      else
+        _splitter = std::make_unique<Splitter>(&featureStore, _criterion,
+                                               _minSamplesInALeaf, _numberOfFeaturesToSplit,
+                                               sampleIndices, _numberOfSplitThreads);
+      _splitter->setRandomEngine(_randomEngine);
+      Splitter& splitter = *_splitter;
       splitter.resetToThisNode(0, numberOfData);
+      tree->reserve(_numberOfNodesOfLastTree);
 
-      PriorityQueue recordQueue(compareRecord);
+      vector<_PriorityQueueRecord>& recordQueue = _recordQueue;
+      recordQueue.clear();
 
       long numberOfInnerNodes = _maxNumberOfLeafNodes - 1;
       long maxDepthSoFar = -1;
@@ -131,17 +298,25 @@ namespace Lib15x
       _PriorityQueueRecord record =
         _splitAndAddNode(tree, &splitter,  0, numberOfData, impurity, true, -1, 0);
 
-      recordQueue.emplace(record);
+      recordQueue.push_back(record);
 
       while (!recordQueue.empty()) {
-        _PriorityQueueRecord record = recordQueue.top();
-        recordQueue.pop();
+        std::pop_heap(std::begin(recordQueue), std::end(recordQueue), compareRecord);
+        _PriorityQueueRecord record = recordQueue.back();
+        recordQueue.pop_back();
 
         bool isLeaf = (record._isLeaf || numberOfInnerNodes <= 0);
         if (record._nodeDepth > maxDepthSoFar)
           maxDepthSoFar = record._nodeDepth;
 
-        if (isLeaf) continue;
+        if (isLeaf) {
+          // splittable nodes left over once the leaf budget is spent still need leaf values
+          if (!record._isLeaf) {
+            splitter.resetToThisNode(record._startIndex, record._endIndex);
+            tree->addLeaf(record._thisNodeIndex, _criterion->nodeValue());
+          }
+          continue;
+        }
 
         --numberOfInnerNodes;
 
@@ -154,11 +329,20 @@ namespace Lib15x
                            record._impurityRight, false, record._thisNodeIndex,
                            record._nodeDepth + 1);
 
-        recordQueue.emplace(leftRecord);
-        recordQueue.emplace(rightRecord);
+        recordQueue.push_back(leftRecord);
+        std::push_heap(std::begin(recordQueue), std::end(recordQueue), compareRecord);
+        recordQueue.push_back(rightRecord);
+        std::push_heap(std::begin(recordQueue), std::end(recordQueue), compareRecord);
       }
 
       tree->_maxDepthOfThisTree = maxDepthSoFar;
+      _numberOfNodesOfLastTree = tree->_nodeCount;
+    }
+
+    void
+    setRandomEngine(std::mt19937* randomEngine)
+    {
+      _randomEngine = randomEngine;
     }
 
     template<class Tree>
@@ -210,7 +394,311 @@ namespace Lib15x
     long _maxNumberOfLeafNodes;
     long _numberOfFeaturesToSplit;
     _Criterion* _criterion;
+    long _numberOfSplitThreads;
+    _FeatureStore _featureStore;
+    std::unique_ptr<Splitter> _splitter;
+    vector<_PriorityQueueRecord> _recordQueue;
+    long _numberOfNodesOfLastTree=0;
+    std::mt19937* _randomEngine=nullptr;
+    double _minImpurity=1e-7;
+  };
+
+  template<class _Criterion, typename BinType=uint8_t>
+  class _LevelWiseBuilder {
+  public:
+    using BinnedDataset = _BinnedDataset<BinType>;
+
+    _LevelWiseBuilder(const long minSamplesInALeaf, const long minSamplesInANode,
+                      const long maxDepthAllowed, const long numberOfFeaturesToSplit,
+                      _Criterion* criterion, const long numberOfThreads=1) :
+      _minSamplesInANode{minSamplesInANode}, _minSamplesInALeaf{minSamplesInALeaf},
+      _maxDepthAllowed{maxDepthAllowed}, _numberOfFeaturesToSplit{numberOfFeaturesToSplit},
+      _criterion{criterion}, _numberOfThreads{std::max(numberOfThreads, 1L)} { }
+
+    template<class Tree>
+    void
+    build(const MatrixXd& trainData, Tree* tree, vector<long>* sampleIndices)
+    {
+      _featureStore.reset(trainData);
+      build(_featureStore, tree, sampleIndices);
+    }
+
+    template<class Tree>
+    void
+    build(const _FeatureStore& featureStore, Tree* tree, vector<long>* sampleIndices)
+    {
+      const long numberOfData = featureStore.rows();
+      const long numberOfFeatures = featureStore.cols();
+      const long numberOfFeaturesToSplit = std::min(_numberOfFeaturesToSplit, numberOfFeatures);
+      const BinnedDataset& binnedData = featureStore.binnedData<BinType>();
+      tree->reserve(_numberOfNodesOfLastTree);
+      _criterion->setTrainingSamples(*sampleIndices);
+      std::fill(std::begin(_nodeCriteria), std::end(_nodeCriteria), *_criterion);
+
+      vector<long>& rowCounts = _rowCounts;
+      rowCounts.assign(numberOfData, 0);
+      for (long dataId : *sampleIndices)
+        ++rowCounts[dataId];
+      vector<long>& nodeOfRow = _nodeOfRow;
+      nodeOfRow.resize(numberOfData);
+      vector<long>& featureIndices = _featureIndices;
+      featureIndices.resize(numberOfFeatures);
+      std::iota(std::begin(featureIndices), std::end(featureIndices), 0);
+
+      vector<_LevelRecord>& levelRecords = _levelRecords;
+      vector<_LevelRecord>& nextLevelRecords = _nextLevelRecords;
+      levelRecords.clear();
+      levelRecords.emplace_back(0, static_cast<long>(sampleIndices->size()), -1, false,
+                                std::numeric_limits<double>::max());
+      long maxDepthSoFar = -1;
+
+      for (long nodeDepth = 0; !levelRecords.empty(); ++nodeDepth) {
+        const long numberOfNodes = levelRecords.size();
+        maxDepthSoFar = nodeDepth;
+
+        vector<_Criterion>& nodeCriteria = _nodeCriteria;
+        if (static_cast<long>(nodeCriteria.size()) < numberOfNodes)
+          nodeCriteria.resize(numberOfNodes, *_criterion);
+        vector<char>& isLeaf = _isLeaf;
+        isLeaf.assign(numberOfNodes, 0);
+        vector<long>& featureSplitSlots = _featureSplitSlots;
+        featureSplitSlots.assign(numberOfNodes*numberOfFeatures, -1);
+        vector<_SplitRecord>& featureSplits = _featureSplits;
+        featureSplits.clear();
+        std::fill(std::begin(nodeOfRow), std::end(nodeOfRow), -1);
+
+        for (long nodeId = 0; nodeId < numberOfNodes; ++nodeId) {
+          _LevelRecord& record = levelRecords[nodeId];
+          const long numberOfSamplesInThisNode = record._endIndex - record._startIndex;
+          _Criterion& criterion = nodeCriteria[nodeId];
+          criterion.init(sampleIndices, record._startIndex, record._endIndex);
+          if (record._parentNodeIndex < 0) record._impurity = criterion.calculateNodeImpurity();
+
+          isLeaf[nodeId] = (nodeDepth >= _maxDepthAllowed) ||
+            (numberOfSamplesInThisNode < _minSamplesInANode) ||
+            (numberOfSamplesInThisNode < 2 * _minSamplesInALeaf) ||
+            (record._impurity <= _minImpurity);
+          if (isLeaf[nodeId]) continue;
+
+          for (long sampleId = record._startIndex; sampleId < record._endIndex; ++sampleId)
+            nodeOfRow[(*sampleIndices)[sampleId]] = nodeId;
+
+          for (long featId = 0; featId < numberOfFeaturesToSplit; ++featId) {
+            long featIdJ = featId + _randomIndex(_randomEngine, numberOfFeatures - featId);
+            std::swap(featureIndices[featId], featureIndices[featIdJ]);
+            featureSplitSlots[nodeId*numberOfFeatures + featureIndices[featId]] =
+              static_cast<long>(featureSplits.size());
+            featureSplits.emplace_back();
+          }
+        }
+
+        vector<vector<_Criterion> >& threadCriteria = _threadCriteria;
+        threadCriteria.resize(std::min(_numberOfThreads, numberOfFeatures));
+        for (long batchBegin = 0; batchBegin < numberOfNodes; batchBegin += _maxNodesInABatch) {
+          const long batchEnd = std::min(batchBegin + _maxNodesInABatch, numberOfNodes);
+          for (auto& criteria : threadCriteria) {
+            if (static_cast<long>(criteria.size()) < batchEnd - batchBegin)
+              criteria.resize(batchEnd - batchBegin, *_criterion);
+            std::copy(std::begin(nodeCriteria)+batchBegin, std::begin(nodeCriteria)+batchEnd,
+                      std::begin(criteria));
+          }
+          _parallelFor(_numberOfThreads, numberOfFeatures,
+                       [&](const long featId, const long threadId) {
+                         _findBestSplitsOfFeature(binnedData, featId, levelRecords,
+                                                  batchBegin, batchEnd, *sampleIndices,
+                                                  featureSplitSlots, nodeOfRow, rowCounts,
+                                                  &threadCriteria[threadId], &featureSplits);
+                       });
+        }
+
+        vector<_SplitRecord>& nodeSplits = _nodeSplits;
+        nodeSplits.assign(numberOfNodes, _SplitRecord());
+        for (long nodeId = 0, slot = 0; nodeId < numberOfNodes; ++nodeId) {
+          if (isLeaf[nodeId]) continue;
+          for (long featId = 0; featId < numberOfFeaturesToSplit; ++featId) {
+            const _SplitRecord& featureSplit = featureSplits[slot++];
+            if (featureSplit._impurityImprovement > nodeSplits[nodeId]._impurityImprovement)
+              nodeSplits[nodeId] = featureSplit;
+          }
+          isLeaf[nodeId] = (nodeSplits[nodeId]._featureIndexToSplit < 0);
+        }
+
+        _parallelFor(_numberOfThreads, numberOfNodes,
+                     [&](const long nodeId, const long threadId) {
+                       ignoreUnusedVariable(threadId);
+                       if (isLeaf[nodeId]) return;
+                       _partitionSamples(binnedData, nodeSplits[nodeId],
+                                         levelRecords[nodeId], sampleIndices);
+                     });
+
+        nextLevelRecords.clear();
+        for (long nodeId = 0; nodeId < numberOfNodes; ++nodeId) {
+          const _LevelRecord& record = levelRecords[nodeId];
+          const _SplitRecord& splitRecord = nodeSplits[nodeId];
+          const long currentNodeIndex = tree->addNode(record._parentNodeIndex, record._isLeft,
+                                                      splitRecord._featureIndexToSplit,
+                                                      splitRecord._threshold);
+          if (isLeaf[nodeId]) {
+            auto leafValue = nodeCriteria[nodeId].nodeValue();
+            tree->addLeaf(currentNodeIndex, std::move(leafValue));
+            continue;
+          }
+
+          nextLevelRecords.emplace_back(record._startIndex, splitRecord._splitSampleIndex,
+                                        currentNodeIndex, true, splitRecord._impurityLeft);
+          nextLevelRecords.emplace_back(splitRecord._splitSampleIndex, record._endIndex,
+                                        currentNodeIndex, false, splitRecord._impurityRight);
+        }
+        levelRecords.swap(nextLevelRecords);
+      }
+
+      tree->_maxDepthOfThisTree = maxDepthSoFar;
+      _numberOfNodesOfLastTree = tree->_nodeCount;
+    }
+
+    void
+    setRandomEngine(std::mt19937* randomEngine)
+    {
+      _randomEngine = randomEngine;
+    }
+
+    // Splits at most this many nodes of a level per pass over the features, which bounds the
+    // node criteria each thread keeps.
+    long&
+    setMaxNodesInABatch()
+    {
+      return _maxNodesInABatch;
+    }
+
+  private:
+    struct _LevelRecord {
+      long _startIndex;
+      long _endIndex;
+      long _parentNodeIndex;
+      bool _isLeft;
+      double _impurity;
+      _LevelRecord(const long startIndex, const long endIndex, const long parentNodeIndex,
+                   const bool isLeft, const double impurity) :
+        _startIndex{startIndex}, _endIndex{endIndex}, _parentNodeIndex{parentNodeIndex},
+        _isLeft{isLeft}, _impurity{impurity} { }
+    };
+
+    // nodeCriteria holds the criteria of the nodes in [batchBegin, batchEnd). A batch covering
+    // the whole level scans the bin column in row order; a smaller batch only visits the
+    // samples of its nodes, which are contiguous in sampleIndices.
+    void
+    _findBestSplitsOfFeature(const BinnedDataset& binnedData, const long featureIndex,
+                             const vector<_LevelRecord>& levelRecords,
+                             const long batchBegin, const long batchEnd,
+                             const vector<long>& sampleIndices,
+                             const vector<long>& featureSplitSlots, const vector<long>& nodeOfRow,
+                             const vector<long>& rowCounts, vector<_Criterion>* nodeCriteria,
+                             vector<_SplitRecord>* featureSplits) const
+    {
+      const long numberOfNodes = levelRecords.size();
+      const long numberOfFeatures = featureSplitSlots.size()/numberOfNodes;
+      const long numberOfBins = binnedData.numberOfBins(featureIndex);
+      for (long nodeId = batchBegin; nodeId < batchEnd; ++nodeId)
+        if (featureSplitSlots[nodeId*numberOfFeatures + featureIndex] >= 0)
+          (*nodeCriteria)[nodeId-batchBegin].resetBins(numberOfBins);
+
+      const BinType* binColumn = binnedData.column(featureIndex);
+      if (batchBegin == 0 && batchEnd == numberOfNodes) {
+        const long numberOfData = binnedData.numberOfData();
+        for (long dataId = 0; dataId < numberOfData; ++dataId) {
+          const long nodeId = nodeOfRow[dataId];
+          if (nodeId < 0 || featureSplitSlots[nodeId*numberOfFeatures + featureIndex] < 0)
+            continue;
+          _Criterion& criterion = (*nodeCriteria)[nodeId];
+          for (long rep = 0; rep < rowCounts[dataId]; ++rep)
+            criterion.accumulateBin(binColumn[dataId], dataId);
+        }
+      }
+      else {
+        for (long sampleId = levelRecords[batchBegin]._startIndex;
+             sampleId < levelRecords[batchEnd-1]._endIndex; ++sampleId) {
+          const long dataId = sampleIndices[sampleId];
+          const long nodeId = nodeOfRow[dataId];
+          if (nodeId < 0 || featureSplitSlots[nodeId*numberOfFeatures + featureIndex] < 0)
+            continue;
+          (*nodeCriteria)[nodeId-batchBegin].accumulateBin(binColumn[dataId], dataId);
+        }
+      }
+
+      for (long nodeId = batchBegin; nodeId < batchEnd; ++nodeId) {
+        const long slot = featureSplitSlots[nodeId*numberOfFeatures + featureIndex];
+        if (slot < 0) continue;
+        _Criterion& criterion = (*nodeCriteria)[nodeId-batchBegin];
+        const _LevelRecord& record = levelRecords[nodeId];
+        _SplitRecord& featureSplit = (*featureSplits)[slot];
+        _SplitRecord currentSplit;
+        currentSplit._featureIndexToSplit = featureIndex;
+
+        criterion.reset();
+        for (long binIndex = 0; binIndex < numberOfBins - 1; ++binIndex) {
+          if (criterion.binSampleCount(binIndex) == 0) continue;
+          criterion.updateByBin(binIndex);
+          if (criterion.numberOfSamplesOnRight() == 0) break;
+
+          if ((criterion.numberOfSamplesOnLeft() < _minSamplesInALeaf) ||
+              (criterion.numberOfSamplesOnRight() < _minSamplesInALeaf))
+            continue;
+
+          currentSplit._impurityImprovement = criterion.impurityImprove(record._impurity);
+
+          if (currentSplit._impurityImprovement > featureSplit._impurityImprovement) {
+            criterion.calculateChildrenImpurity(&currentSplit._impurityLeft,
+                                                &currentSplit._impurityRight);
+            currentSplit._splitSampleIndex = record._startIndex + criterion.numberOfSamplesOnLeft();
+            currentSplit._threshold = binnedData.threshold(featureIndex, binIndex);
+            featureSplit = currentSplit;
+          }
+        }
+      }
+    }
+
+    void
+    _partitionSamples(const BinnedDataset& binnedData, const _SplitRecord& splitRecord,
+                      const _LevelRecord& record, vector<long>* sampleIndices) const
+    {
+      const long splitBin = binnedData.findBin(splitRecord._featureIndexToSplit,
+                                               splitRecord._threshold);
+      const BinType* binColumn = binnedData.column(splitRecord._featureIndexToSplit);
+      long partitionEnd = record._endIndex;
+      long sampleId = record._startIndex;
+      while (sampleId < partitionEnd){
+        if (binColumn[(*sampleIndices)[sampleId]] <= splitBin) {
+          ++sampleId;
+          continue;
+        }
+        --partitionEnd;
+        std::swap((*sampleIndices)[partitionEnd], (*sampleIndices)[sampleId]);
+      }
+      assert(partitionEnd == splitRecord._splitSampleIndex);
+    }
+
+    long _minSamplesInANode;
+    long _minSamplesInALeaf;
+    long _maxDepthAllowed;
+    long _numberOfFeaturesToSplit;
+    _Criterion* _criterion;
+    long _numberOfThreads;
+    _FeatureStore _featureStore;
+    vector<long> _rowCounts;
+    vector<long> _nodeOfRow;
+    vector<long> _featureIndices;
+    vector<_LevelRecord> _levelRecords;
+    vector<_LevelRecord> _nextLevelRecords;
+    vector<_Criterion> _nodeCriteria;
+    vector<vector<_Criterion> > _threadCriteria;
+    vector<char> _isLeaf;
+    vector<long> _featureSplitSlots;
+    vector<_SplitRecord> _featureSplits;
+    vector<_SplitRecord> _nodeSplits;
+    long _numberOfNodesOfLastTree=0;
+    std::mt19937* _randomEngine=nullptr;
     double _minImpurity=1e-7;
+    long _maxNodesInABatch=1024;
   };
 }
 #endif // _BUILDER
@@ -1,121 +1,262 @@
 #ifndef _CLASSIFICATION_CRITERION
 #define _CLASSIFICATION_CRITERION
 
+#include <array>
+#include <numeric>
 #include "../core/Definitions.hpp"
 #include "./_BaseCriterion.hpp"
 
 namespace Lib15x
 {
+  template<class LabelsCount>
   double
-  bernoulli(const vector<long>& labelsCount) {
-    const long numberOfSamples =
-      std::accumulate(std::begin(labelsCount), std::end(labelsCount), 0);
-
+  _bernoulli(const LabelsCount& labelsCount, const double numberOfSamples) {
     double impurity = 1.0;
     for (auto thisLabelCount : labelsCount)
-      impurity *= static_cast<double>(thisLabelCount)/static_cast<double>(numberOfSamples);
+      impurity *= thisLabelCount/numberOfSamples;
 
     return impurity;
   }
 
+  template<class LabelsCount>
   double
-  gini(const vector<long>& labelsCount) {
-    const long numberOfSamples =
-      std::accumulate(std::begin(labelsCount), std::end(labelsCount), 0);
-
+  _gini(const LabelsCount& labelsCount, const double numberOfSamples) {
     double impurity = 1.0;
     for (auto thisLabelCount : labelsCount) {
-      double temp = static_cast<double>(thisLabelCount)/static_cast<double>(numberOfSamples);
+      double temp = thisLabelCount/numberOfSamples;
       impurity -= temp*temp;
     }
 
     return impurity;
   }
 
+  template<class LabelsCount>
   double
-  entropy(const vector<long>& labelsCount) {
-    const long numberOfSamples =
-      std::accumulate(std::begin(labelsCount), std::end(labelsCount), 0);
-
+  _entropy(const LabelsCount& labelsCount, const double numberOfSamples) {
     double impurity = 0.0;
     for (auto thisLabelCount : labelsCount)
       if (thisLabelCount > 0){
-        double temp = static_cast<double>(thisLabelCount)/static_cast<double>(numberOfSamples);
+        double temp = thisLabelCount/numberOfSamples;
         impurity -= temp*log(temp);
       }
 
     return impurity;
   }
 
-  template<double (*ImpurityRule)(const vector<long>&)>
+  double
+  bernoulli(const vector<double>& labelsCount) {
+    return _bernoulli(labelsCount,
+                      std::accumulate(std::begin(labelsCount), std::end(labelsCount), 0.0));
+  }
+
+  double
+  gini(const vector<double>& labelsCount) {
+    return _gini(labelsCount,
+                 std::accumulate(std::begin(labelsCount), std::end(labelsCount), 0.0));
+  }
+
+  double
+  entropy(const vector<double>& labelsCount) {
+    return _entropy(labelsCount,
+                    std::accumulate(std::begin(labelsCount), std::end(labelsCount), 0.0));
+  }
+
+  // Impurity from class counts and a sample total the criterion already tracks; rules
+  // other than the built-in ones fall back to the vector interface.
+  template<double (*ImpurityRule)(const vector<double>&)>
+  struct _ImpurityOfLabelsCount {
+    template<class LabelsCount>
+    static double
+    evaluate(const LabelsCount& labelsCount, const double numberOfSamples)
+    {
+      ignoreUnusedVariable(numberOfSamples);
+      return ImpurityRule(vector<double>(std::begin(labelsCount), std::end(labelsCount)));
+    }
+  };
+
+  template<>
+  struct _ImpurityOfLabelsCount<bernoulli> {
+    template<class LabelsCount>
+    static double
+    evaluate(const LabelsCount& labelsCount, const double numberOfSamples)
+    {
+      return _bernoulli(labelsCount, numberOfSamples);
+    }
+  };
+
+  template<>
+  struct _ImpurityOfLabelsCount<gini> {
+    template<class LabelsCount>
+    static double
+    evaluate(const LabelsCount& labelsCount, const double numberOfSamples)
+    {
+      return _gini(labelsCount, numberOfSamples);
+    }
+  };
+
+  template<>
+  struct _ImpurityOfLabelsCount<entropy> {
+    template<class LabelsCount>
+    static double
+    evaluate(const LabelsCount& labelsCount, const double numberOfSamples)
+    {
+      return _entropy(labelsCount, numberOfSamples);
+    }
+  };
+
+  template<long NumberOfClasses>
+  struct _LabelsCountStorage {
+    using Type = std::array<double, NumberOfClasses>;
+
+    static void
+    reset(Type* labelsCount, const long numberOfClasses)
+    {
+      ignoreUnusedVariable(numberOfClasses);
+      labelsCount->fill(0.0);
+    }
+  };
+
+  template<>
+  struct _LabelsCountStorage<0> {
+    using Type = vector<double>;
+
+    static void
+    reset(Type* labelsCount, const long numberOfClasses)
+    {
+      labelsCount->assign(numberOfClasses, 0.0);
+    }
+  };
+
+  // NumberOfClasses == 0 keeps the class counts in vectors sized at runtime; a positive
+  // value fixes them at compile time so the split scan works on stack arrays.
+  template<double (*ImpurityRule)(const vector<double>&), long NumberOfClasses = 0>
   class _ClassificationCriterion :
-    public _BaseCriterion<_ClassificationCriterion<ImpurityRule> > {
+    public _BaseCriterion<_ClassificationCriterion<ImpurityRule, NumberOfClasses> > {
   public:
     using BaseCriterion = _BaseCriterion<_ClassificationCriterion>;
+    using Impurity = _ImpurityOfLabelsCount<ImpurityRule>;
+    using LabelsCountStorage = _LabelsCountStorage<NumberOfClasses>;
+    using LabelsCount = typename LabelsCountStorage::Type;
 
-    explicit _ClassificationCriterion(const VectorXd* labelData, const long numberOfClasses) :
-      BaseCriterion{labelData}, _numberOfClasses{numberOfClasses},
-      _labelsCountTotal(numberOfClasses,0),
-      _labelsCountLeft(numberOfClasses,0), _labelsCountRight(numberOfClasses,0) { }
+    _ClassificationCriterion(const VectorXd* labelData, const long numberOfClasses,
+                             const VectorXd* sampleWeights=nullptr) :
+      BaseCriterion{labelData, sampleWeights}, _numberOfClasses{numberOfClasses}
+    {
+      if (NumberOfClasses > 0 && numberOfClasses != NumberOfClasses) {
+        throwException("Error happened when constructing classification criterion: "
+                       "criterion is specialized for %ld classes but got %ld classes",
+                       NumberOfClasses, numberOfClasses);
+      }
+      LabelsCountStorage::reset(&_labelsCountTotal, _numberOfClasses);
+      LabelsCountStorage::reset(&_labelsCountLeft, _numberOfClasses);
+      LabelsCountStorage::reset(&_labelsCountRight, _numberOfClasses);
+    }
 
-    void
+    double
     _init()
     {
       long startIndex = BaseCriterion::_startIndex;
       long endIndex = BaseCriterion::_endIndex;
 
-      std::fill(std::begin(_labelsCountTotal), std::end(_labelsCountTotal), 0);
+      std::fill(std::begin(_labelsCountTotal), std::end(_labelsCountTotal), 0.0);
+      double weightTotal = 0.0;
       for (long sampleId = startIndex; sampleId < endIndex; ++sampleId) {
-        long dataId = BaseCriterion::_sampleIndices->at(sampleId);
+        long dataId = (*BaseCriterion::_sampleIndices)[sampleId];
         long thisLabel =  static_cast<long>((*BaseCriterion::_labelData)(dataId));
-        ++_labelsCountTotal[thisLabel];
+        double weight = BaseCriterion::sampleWeight(dataId);
+        _labelsCountTotal[thisLabel] += weight;
+        weightTotal += weight;
       }
+      return weightTotal;
     }
 
     void
     _reset()
     {
-      std::copy(std::begin(_labelsCountTotal), std::end(_labelsCountTotal),
-                std::begin(_labelsCountRight));
-      std::fill(std::begin(_labelsCountLeft), std::end(_labelsCountLeft), 0);
+      _labelsCountRight = _labelsCountTotal;
+      std::fill(std::begin(_labelsCountLeft), std::end(_labelsCountLeft), 0.0);
     }
 
-    void
+    double
     _update(const long newPos)
     {
-      for (long pos = BaseCriterion::_currentPosition; pos < newPos; ++pos){
-        long dataId = BaseCriterion::_sampleIndices->at(pos);
-        long thisLabel = static_cast<long>((*BaseCriterion::_labelData)(dataId));
-        ++_labelsCountLeft[thisLabel];
-        --_labelsCountRight[thisLabel];
+      const double* sortedLabels = BaseCriterion::_sortedLabels;
+      const double* sortedWeights = BaseCriterion::_sortedWeights;
+      const long startIndex = BaseCriterion::_startIndex;
+      const long beginPos = BaseCriterion::_currentPosition-startIndex;
+      const long endPos = newPos-startIndex;
+      if (!sortedWeights) {
+        for (long pos = beginPos; pos < endPos; ++pos){
+          long thisLabel = static_cast<long>(sortedLabels[pos]);
+          _labelsCountLeft[thisLabel] += 1.0;
+          _labelsCountRight[thisLabel] -= 1.0;
+        }
+        return static_cast<double>(endPos-beginPos);
+      }
+
+      double weightSum = 0.0;
+      for (long pos = beginPos; pos < endPos; ++pos){
+        long thisLabel = static_cast<long>(sortedLabels[pos]);
+        _labelsCountLeft[thisLabel] += sortedWeights[pos];
+        _labelsCountRight[thisLabel] -= sortedWeights[pos];
+        weightSum += sortedWeights[pos];
+      }
+      return weightSum;
+    }
+
+    void
+    _resetBins(const long numberOfBins)
+    {
+      _binLabelsCount.assign(numberOfBins*_numberOfClasses, 0.0);
+    }
+
+    void
+    _accumulateBin(const long binIndex, const long dataId, const double weight)
+    {
+      long thisLabel = static_cast<long>((*BaseCriterion::_labelData)(dataId));
+      _binLabelsCount[binIndex*_numberOfClasses+thisLabel] += weight;
+    }
+
+    void
+    _updateByBin(const long binIndex)
+    {
+      const long numberOfClasses = NumberOfClasses > 0 ? NumberOfClasses : _numberOfClasses;
+      const double* binLabelsCount = &_binLabelsCount[binIndex*numberOfClasses];
+      for (long classId = 0; classId < numberOfClasses; ++classId) {
+        _labelsCountLeft[classId] += binLabelsCount[classId];
+        _labelsCountRight[classId] -= binLabelsCount[classId];
       }
     }
 
     double
     calculateNodeImpurity() const
     {
-      return ImpurityRule(_labelsCountTotal);
+      return Impurity::evaluate(_labelsCountTotal,
+                                BaseCriterion::_weightedNumberOfSamplesInThisNode);
     }
 
     void
     calculateChildrenImpurity(double* impurityLeft,
                               double* impurityRight) const
     {
-      *impurityLeft = ImpurityRule(_labelsCountLeft);
-      *impurityRight = ImpurityRule(_labelsCountRight);
+      *impurityLeft =
+        Impurity::evaluate(_labelsCountLeft, BaseCriterion::_weightedNumberOfSamplesOnLeft);
+      *impurityRight =
+        Impurity::evaluate(_labelsCountRight, BaseCriterion::_weightedNumberOfSamplesOnRight);
     }
 
-    const vector<long>&
+    vector<double>
     nodeValue() const
     {
-      return _labelsCountTotal;
+      return vector<double>(std::begin(_labelsCountTotal), std::end(_labelsCountTotal));
     }
 
   private:
     long _numberOfClasses;
-    vector<long> _labelsCountTotal;
-    vector<long> _labelsCountLeft;
-    vector<long> _labelsCountRight;
+    LabelsCount _labelsCountTotal;
+    LabelsCount _labelsCountLeft;
+    LabelsCount _labelsCountRight;
+    vector<double> _binLabelsCount;
   };
 }
 #endif //_CLASSIFICATION_CRITERION
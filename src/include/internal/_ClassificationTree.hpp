@@ -14,39 +14,60 @@ namespace Lib15x
     void _reset()
     {
       _leafNodeToLabel.clear();
+      _flatLeafValues.clear();
+    }
+
+    void _reserve(const long numberOfNodes)
+    {
+      _leafNodeToLabel.reserve((numberOfNodes+1)/2);
     }
 
     void
-    addLeaf(const long nodeIndex, vector<long> labelsCount)
+    addLeaf(const long nodeIndex, vector<double> labelsCount)
     {
       assert(static_cast<long>(labelsCount.size())==_numberOfClasses);
       _leafNodeToLabel.push_back(std::make_pair(nodeIndex, std::move(labelsCount)));
       _nodes[nodeIndex]._isLeaf = true;
     }
 
-    const vector<long>&
-    predictOne(const VectorXd& instance) const
+    // Leaves keep the ordinal of their class weights in _flatLeafValues as child index.
+    void
+    _finalizeLeaves(const vector<long>& flatIndexOfNode)
     {
-      assert(instance.size()==_numberOfFeatures);
-      long leafIndex=_headNodeIndex;
-      while (!_nodes[leafIndex]._isLeaf){
-        long splitFeatIndex=_nodes[leafIndex]._featureIndex;
-        leafIndex = instance(splitFeatIndex) < _nodes[leafIndex]._threshold ?
-          _nodes[leafIndex]._leftChildIndex : _nodes[leafIndex]._rightChildIndex;
+      _flatLeafValues.clear();
+      _flatLeafValues.reserve(_leafNodeToLabel.size()*_numberOfClasses);
+      long leafOrdinal = 0;
+      for (const auto& leaf : _leafNodeToLabel) {
+        _flatChildIndices[flatIndexOfNode[leaf.first]] = static_cast<int32_t>(leafOrdinal++);
+        _flatLeafValues.insert(std::end(_flatLeafValues), std::begin(leaf.second),
+                               std::end(leaf.second));
       }
+      vector<std::pair<long, vector<double> > >().swap(_leafNodeToLabel);
+    }
 
-      auto it = std::find_if(std::begin(_leafNodeToLabel), std::end(_leafNodeToLabel),
-                             [&leafIndex](auto i){return i.first==leafIndex;});
-      if (it==std::end(_leafNodeToLabel)){
-        throwException("Error happened in internal tree predicting method: "
-                       "cannot find the predicted data for leafIndex %ld\n.",
-                       leafIndex);
-      }
-      return it->second;
+    long
+    _numberOfLeafBytes() const
+    {
+      return _flatLeafValues.size()*sizeof(double);
+    }
+
+    // Returns the weighted class counts of the leaf, _numberOfClasses values.
+    const double*
+    leafValue(const long leafIndex) const
+    {
+      return &_flatLeafValues[_flatChildIndices[leafIndex]*_numberOfClasses];
+    }
+
+    const double*
+    predictOne(const VectorXd& instance) const
+    {
+      assert(instance.size()==_numberOfFeatures);
+      return leafValue(leafIndexOf(instance.data()));
     }
 
   public:
-    vector<std::pair<long, vector<long> > > _leafNodeToLabel;
+    vector<std::pair<long, vector<double> > > _leafNodeToLabel;
+    vector<double> _flatLeafValues;
     long _numberOfClasses;
   };
 }
@@ -0,0 +1,215 @@
+#ifndef _CODE_GENERATOR
+#define _CODE_GENERATOR
+
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include "../core/Definitions.hpp"
+#include "./_RegressionTree.hpp"
+#include "./_ClassificationTree.hpp"
+
+namespace Lib15x
+{
+  // Writes finalized trees as standalone C++. Trees up to maxBranchDepth levels become nested
+  // branches with the features and thresholds inlined; deeper trees become constexpr copies of
+  // the flat node arrays walked by a loop. Both compare with x < threshold like leafIndexOf,
+  // and the leaf values are summed in the same order as predict(), so the generated
+  // predictor returns exactly what the model does.
+
+  // 17 significant digits parse back to the same double.
+  inline std::string
+  _codeOfDouble(const double value)
+  {
+    if (std::isinf(value))
+      return value > 0 ? "std::numeric_limits<double>::infinity()" :
+        "-std::numeric_limits<double>::infinity()";
+    std::ostringstream code;
+    code << std::setprecision(17) << value;
+    return code.str();
+  }
+
+  inline long
+  _depthOfFlatTree(const vector<int32_t>& featureIndices, const vector<int32_t>& childIndices)
+  {
+    // children always come after their parent in the flat layout
+    vector<long> depthOfNode(featureIndices.size(), 0);
+    long maxDepth = 0;
+    for (long nodeIndex = 0; nodeIndex < static_cast<long>(featureIndices.size()); ++nodeIndex) {
+      maxDepth = std::max(maxDepth, depthOfNode[nodeIndex]);
+      if (featureIndices[nodeIndex] < 0) continue;
+      depthOfNode[childIndices[nodeIndex]] = depthOfNode[nodeIndex]+1;
+      depthOfNode[childIndices[nodeIndex]+1] = depthOfNode[nodeIndex]+1;
+    }
+    return maxDepth;
+  }
+
+  inline std::string
+  _treeFunctionSignature(const _RegressionTree& tree, const std::string& treeName)
+  {
+    ignoreUnusedVariable(tree);
+    return "double " + treeName + "(const double* instance)";
+  }
+
+  inline std::string
+  _treeFunctionSignature(const _ClassificationTree& tree, const std::string& treeName)
+  {
+    ignoreUnusedVariable(tree);
+    return "void " + treeName + "(const double* instance, double* labelsCount)";
+  }
+
+  inline void
+  _writeLeafCode(std::ostream& out, const _RegressionTree& tree, const long leafIndex,
+                 const std::string& indent)
+  {
+    out << indent << "return " << _codeOfDouble(tree.leafValue(leafIndex)) << ";\n";
+  }
+
+  inline void
+  _writeLeafCode(std::ostream& out, const _ClassificationTree& tree, const long leafIndex,
+                 const std::string& indent)
+  {
+    const double* labelsCount = tree.leafValue(leafIndex);
+    for (long classId = 0; classId < tree._numberOfClasses; ++classId)
+      if (labelsCount[classId] != 0.0)
+        out << indent << "labelsCount[" << classId << "] += "
+            << _codeOfDouble(labelsCount[classId]) << ";\n";
+    out << indent << "return;\n";
+  }
+
+  template<class Tree>
+  void
+  _writeBranchCode(std::ostream& out, const Tree& tree, const long nodeIndex,
+                   const std::string& indent)
+  {
+    const int32_t featureIndex = tree._flatFeatureIndices[nodeIndex];
+    if (featureIndex < 0) {
+      _writeLeafCode(out, tree, nodeIndex, indent);
+      return;
+    }
+    const int32_t leftChildIndex = tree._flatChildIndices[nodeIndex];
+    out << indent << "if (instance[" << featureIndex << "] < "
+        << _codeOfDouble(tree._flatThresholds[nodeIndex]) << ") {\n";
+    _writeBranchCode(out, tree, leftChildIndex, indent+"  ");
+    out << indent << "}\n";
+    _writeBranchCode(out, tree, leftChildIndex+1, indent);
+  }
+
+  template<class Value>
+  void
+  _writeArrayCode(std::ostream& out, const char* typeName, const std::string& arrayName,
+                  const vector<Value>& values)
+  {
+    out << "constexpr " << typeName << " " << arrayName << "[] = {";
+    for (long valueId = 0; valueId < static_cast<long>(values.size()); ++valueId) {
+      out << (valueId % 8 == 0 ? "\n  " : " ");
+      out << _codeOfDouble(static_cast<double>(values[valueId])) << ",";
+    }
+    out << "\n};\n";
+  }
+
+  inline void
+  _writeTableLeafCode(std::ostream& out, const _RegressionTree& tree,
+                      const std::string& treeName)
+  {
+    ignoreUnusedVariable(tree);
+    out << "  return " << treeName << "Thresholds[nodeIndex];\n";
+  }
+
+  inline void
+  _writeTableLeafCode(std::ostream& out, const _ClassificationTree& tree,
+                      const std::string& treeName)
+  {
+    out << "  const double* leafValues = " << treeName << "LeafValues+"
+        << treeName << "ChildIndices[nodeIndex]*" << tree._numberOfClasses << ";\n"
+        << "  for (int classId = 0; classId < " << tree._numberOfClasses << "; ++classId)\n"
+        << "    labelsCount[classId] += leafValues[classId];\n";
+  }
+
+  inline void
+  _writeTableLeafValues(std::ostream& out, const _RegressionTree& tree,
+                        const std::string& treeName)
+  {
+    ignoreUnusedVariables(out, tree, treeName);
+  }
+
+  inline void
+  _writeTableLeafValues(std::ostream& out, const _ClassificationTree& tree,
+                        const std::string& treeName)
+  {
+    _writeArrayCode(out, "double", treeName+"LeafValues", tree._flatLeafValues);
+  }
+
+  template<class Tree>
+  void
+  _writeTableCode(std::ostream& out, const Tree& tree, const std::string& treeName)
+  {
+    _writeArrayCode(out, "int", treeName+"FeatureIndices", tree._flatFeatureIndices);
+    _writeArrayCode(out, "int", treeName+"ChildIndices", tree._flatChildIndices);
+    _writeArrayCode(out, "double", treeName+"Thresholds", tree._flatThresholds);
+    _writeTableLeafValues(out, tree, treeName);
+    out << _treeFunctionSignature(tree, treeName) << "\n{\n"
+        << "  int nodeIndex = 0;\n"
+        << "  while (" << treeName << "FeatureIndices[nodeIndex] >= 0)\n"
+        << "    nodeIndex = " << treeName << "ChildIndices[nodeIndex]+\n"
+        << "      !(instance[" << treeName << "FeatureIndices[nodeIndex]] < "
+        << treeName << "Thresholds[nodeIndex]);\n";
+    _writeTableLeafCode(out, tree, treeName);
+    out << "}\n\n";
+  }
+
+  template<class Tree>
+  void
+  _writeTreesCode(std::ostream& out, const char* modelName, const Tree* trees,
+                  const long numberOfTrees, const long maxBranchDepth)
+  {
+    out << "// Generated by Lib15x from a trained " << modelName << ".\n"
+        << "#include <limits>\n\n"
+        << "namespace {\n\n";
+    for (long treeId = 0; treeId < numberOfTrees; ++treeId) {
+      const Tree& tree = trees[treeId];
+      if (!tree._isFinalized) {
+        throwException("Error happened when generating code for %s: "
+                       "tree %ld is not trained", modelName, treeId);
+      }
+      const std::string treeName = "tree" + std::to_string(treeId);
+      if (_depthOfFlatTree(tree._flatFeatureIndices, tree._flatChildIndices) > maxBranchDepth) {
+        _writeTableCode(out, tree, treeName);
+        continue;
+      }
+      out << _treeFunctionSignature(tree, treeName) << "\n{\n";
+      _writeBranchCode(out, tree, 0, "  ");
+      out << "}\n\n";
+    }
+    out << "}\n\n";
+  }
+
+  inline void
+  _writeClassifierCode(std::ostream& out, const std::string& functionName,
+                       const long numberOfTrees, const long numberOfClasses)
+  {
+    out << "extern \"C\" double\n" << functionName << "(const double* instance)\n{\n"
+        << "  double labelsCount[" << numberOfClasses << "] = {};\n";
+    for (long treeId = 0; treeId < numberOfTrees; ++treeId)
+      out << "  tree" << treeId << "(instance, labelsCount);\n";
+    out << "  int label = 0;\n"
+        << "  for (int classId = 1; classId < " << numberOfClasses << "; ++classId)\n"
+        << "    if (labelsCount[classId] > labelsCount[label]) label = classId;\n"
+        << "  return label;\n"
+        << "}\n";
+  }
+
+  inline void
+  _writeRegressorCode(std::ostream& out, const std::string& functionName,
+                      const long numberOfTrees, const double initialValue=0.0)
+  {
+    out << "extern \"C\" double\n" << functionName << "(const double* instance)\n{\n"
+        << "  double result = " << _codeOfDouble(initialValue) << ";\n";
+    for (long treeId = 0; treeId < numberOfTrees; ++treeId)
+      out << "  result += tree" << treeId << "(instance);\n";
+    out << "  return result;\n"
+        << "}\n";
+  }
+}
+
+#endif //_CODE_GENERATOR
@@ -0,0 +1,151 @@
+#ifndef _ENSEMBLE_PREDICTION
+#define _ENSEMBLE_PREDICTION
+
+#include <cstdint>
+#include "../core/Definitions.hpp"
+
+namespace Lib15x
+{
+  // Enough rows to keep the traversal busy while the block of test data stays in L2.
+  inline long
+  _predictionBlockSize(const long numberOfFeatures)
+  {
+    const long blockBytes = 256*1024;
+    return std::max(64L, std::min(4096L, blockBytes/(8*std::max(1L, numberOfFeatures))));
+  }
+
+  // Scores testIndices block by block: each block of rows goes through every tree before the
+  // next block is loaded. accumulateLeaves(treeId, blockStart, numberOfRowsInBlock,
+  // leafIndices) sees the trees of a block in order; finishBlock(blockStart,
+  // numberOfRowsInBlock) is called once all trees are done.
+  template<class Tree, class AccumulateFunction, class FinishFunction>
+  void
+  _predictInBlocks(const Tree* trees, const long numberOfTrees, const MatrixXd& testData,
+                   const vector<long>& testIndices, AccumulateFunction accumulateLeaves,
+                   FinishFunction finishBlock)
+  {
+    static_assert(MatrixXd::IsRowMajor, "block prediction reads rows contiguously");
+    const long numberOfTestData = testIndices.size();
+    const long blockSize = _predictionBlockSize(testData.cols());
+    vector<long> rowOffsets(blockSize);
+    vector<int32_t> leafIndices(blockSize);
+
+    for (long blockStart = 0; blockStart < numberOfTestData; blockStart += blockSize) {
+      const long numberOfRowsInBlock = std::min(blockSize, numberOfTestData-blockStart);
+      for (long rowId = 0; rowId < numberOfRowsInBlock; ++rowId)
+        rowOffsets[rowId] = testIndices[blockStart+rowId]*testData.cols();
+
+      for (long treeId = 0; treeId < numberOfTrees; ++treeId) {
+        trees[treeId].leafIndicesOf(testData.data(), rowOffsets.data(), numberOfRowsInBlock,
+                                    leafIndices.data());
+        accumulateLeaves(treeId, blockStart, numberOfRowsInBlock, leafIndices.data());
+      }
+      finishBlock(blockStart, numberOfRowsInBlock);
+    }
+  }
+
+  // Lays out the nodes of every tree hot path first by how often the rows of sampleData pass
+  // through them; see _BaseTree::reorderNodes.
+  template<class Tree>
+  void
+  _reorderNodesByPaths(Tree* trees, const long numberOfTrees, const MatrixXd& sampleData)
+  {
+    static_assert(MatrixXd::IsRowMajor, "path counting reads rows contiguously");
+    const long numberOfRows = sampleData.rows();
+    vector<long> rowOffsets(numberOfRows);
+    for (long rowId = 0; rowId < numberOfRows; ++rowId)
+      rowOffsets[rowId] = rowId*sampleData.cols();
+
+    for (long treeId = 0; treeId < numberOfTrees; ++treeId)
+      trees[treeId].reorderNodes(
+        trees[treeId].nodeVisitCountsOf(sampleData.data(), rowOffsets.data(), numberOfRows));
+  }
+
+  // _predictInBlocks for votes that may settle before the last tree: after every tree the rows
+  // for which isSettled(rowInBlock, numberOfTreesDone) holds leave the block, so the later
+  // trees only walk the open rows. accumulateLeaves(treeId, openRows, numberOfOpenRows,
+  // leafIndices) gets the open rows as positions in the block.
+  template<class Tree, class AccumulateFunction, class SettledFunction, class FinishFunction>
+  void
+  _predictInBlocksUntilSettled(const Tree* trees, const long numberOfTrees,
+                               const MatrixXd& testData, const vector<long>& testIndices,
+                               AccumulateFunction accumulateLeaves, SettledFunction isSettled,
+                               FinishFunction finishBlock)
+  {
+    static_assert(MatrixXd::IsRowMajor, "block prediction reads rows contiguously");
+    const long numberOfTestData = testIndices.size();
+    const long blockSize = _predictionBlockSize(testData.cols());
+    vector<long> rowOffsets(blockSize);
+    vector<long> openRows(blockSize);
+    vector<int32_t> leafIndices(blockSize);
+
+    for (long blockStart = 0; blockStart < numberOfTestData; blockStart += blockSize) {
+      const long numberOfRowsInBlock = std::min(blockSize, numberOfTestData-blockStart);
+      for (long rowId = 0; rowId < numberOfRowsInBlock; ++rowId) {
+        rowOffsets[rowId] = testIndices[blockStart+rowId]*testData.cols();
+        openRows[rowId] = rowId;
+      }
+
+      long numberOfOpenRows = numberOfRowsInBlock;
+      for (long treeId = 0; treeId < numberOfTrees && numberOfOpenRows > 0; ++treeId) {
+        trees[treeId].leafIndicesOf(testData.data(), rowOffsets.data(), numberOfOpenRows,
+                                    leafIndices.data());
+        accumulateLeaves(treeId, openRows.data(), numberOfOpenRows, leafIndices.data());
+        long numberOfStillOpenRows = 0;
+        for (long openId = 0; openId < numberOfOpenRows; ++openId)
+          if (!isSettled(openRows[openId], treeId+1)) {
+            rowOffsets[numberOfStillOpenRows] = rowOffsets[openId];
+            openRows[numberOfStillOpenRows++] = openRows[openId];
+          }
+        numberOfOpenRows = numberOfStillOpenRows;
+      }
+      finishBlock(blockStart, numberOfRowsInBlock);
+    }
+  }
+
+  // Decides when a vote can stop early. It stops once the leader's margin over the runner-up
+  // exceeds the most weight the remaining voters can give one class, so the winner is the
+  // one all voters would give. With a positive risk it also stops when, by Hoeffding's
+  // inequality with votes as heavy as the ones so far, the remaining voters overturn the
+  // margin with a probability below the risk.
+  class _EarlyExitRule {
+  public:
+    // maxVoteWeights[i] is the most weight voter i can give one class over another.
+    void
+    reset(const vector<double>& maxVoteWeights)
+    {
+      const long numberOfVoters = maxVoteWeights.size();
+      _remainingWeights.assign(numberOfVoters+1, 0.0);
+      for (long voterId = numberOfVoters-1; voterId >= 0; --voterId)
+        _remainingWeights[voterId] = _remainingWeights[voterId+1] + maxVoteWeights[voterId];
+    }
+
+    // squaredVoteWeights sums the squared largest class weight of the votes so far.
+    bool
+    isSettled(const double* labelsCount, const long numberOfClasses,
+              const long numberOfVotersDone, const double risk,
+              const double squaredVoteWeights) const
+    {
+      double leaderCount = -std::numeric_limits<double>::max();
+      double runnerUpCount = -std::numeric_limits<double>::max();
+      for (long classId = 0; classId < numberOfClasses; ++classId)
+        if (labelsCount[classId] > leaderCount) {
+          runnerUpCount = leaderCount;
+          leaderCount = labelsCount[classId];
+        }
+        else if (labelsCount[classId] > runnerUpCount)
+          runnerUpCount = labelsCount[classId];
+
+      const double margin = leaderCount-runnerUpCount;
+      if (margin > _remainingWeights[numberOfVotersDone]) return true;
+      const long numberOfRemainingVoters = _remainingWeights.size()-1-numberOfVotersDone;
+      return risk > 0.0 && margin*margin > 2.0*std::log(1.0/risk)*squaredVoteWeights*
+        static_cast<double>(numberOfRemainingVoters)/static_cast<double>(numberOfVotersDone);
+    }
+
+  private:
+    vector<double> _remainingWeights;
+  };
+}
+
+#endif //_ENSEMBLE_PREDICTION
@@ -0,0 +1,118 @@
+#ifndef _ENSEMBLE_PRUNING
+#define _ENSEMBLE_PRUNING
+
+#include <cstdint>
+#include "../core/Definitions.hpp"
+
+namespace Lib15x
+{
+  // Limits of a pruned ensemble; a negative limit is no limit.
+  struct PruningBudget {
+    long _maxNumberOfTrees = -1;
+    long _maxNumberOfNodes = -1;
+    long _maxNumberOfBytes = -1;
+  };
+
+  // The ensemble of the trees picked up to one step of the pruning: its size, the nodes a
+  // held-out row visits in it, which prediction time follows, and its held-out loss.
+  struct PruningStep {
+    // position in the unpruned ensemble of the tree picked at this step
+    long _treeId;
+    long _numberOfTrees;
+    long _numberOfNodes;
+    long _numberOfBytes;
+    double _averagePathLength;
+    double _loss;
+  };
+
+  struct _TreeCost {
+    long _numberOfNodes;
+    long _numberOfBytes;
+    double _averagePathLength;
+  };
+
+  // The leaf of every row of data in every tree, and the cost of every tree.
+  template<class Tree>
+  void
+  _leavesAndCostsOf(const Tree* trees, const long numberOfTrees, const MatrixXd& data,
+                    vector<vector<int32_t> >* leafIndices, vector<_TreeCost>* costs)
+  {
+    static_assert(MatrixXd::IsRowMajor, "leaf search reads rows contiguously");
+    const long numberOfRows = data.rows();
+    vector<long> rowOffsets(numberOfRows);
+    for (long rowId = 0; rowId < numberOfRows; ++rowId)
+      rowOffsets[rowId] = rowId*data.cols();
+
+    leafIndices->assign(numberOfTrees, vector<int32_t>(numberOfRows));
+    costs->clear();
+    for (long treeId = 0; treeId < numberOfTrees; ++treeId) {
+      const Tree& tree = trees[treeId];
+      vector<int32_t>& treeLeafIndices = (*leafIndices)[treeId];
+      tree.leafIndicesOf(data.data(), rowOffsets.data(), numberOfRows, treeLeafIndices.data());
+      const vector<long> pathLengths = tree.pathLengthsOfNodes();
+      double totalPathLength = 0.0;
+      for (const int32_t leafIndex : treeLeafIndices)
+        totalPathLength += static_cast<double>(pathLengths[leafIndex]);
+      costs->push_back(_TreeCost{tree.numberOfNodes(), tree.numberOfBytes(),
+            numberOfRows > 0 ? totalPathLength/static_cast<double>(numberOfRows) : 0.0});
+    }
+  }
+
+  // Greedy forward selection (Caruana et al., 2004): every step picks, among the trees that
+  // still fit the budget, the one giving the lowest held-out loss, the earlier tree on ties.
+  // lossWith(treeId) is the loss of the picked trees and treeId; add(treeId) picks it.
+  template<class LossFunction, class AddFunction>
+  vector<PruningStep>
+  _selectTreesGreedily(const vector<_TreeCost>& costs, const PruningBudget& budget,
+                       LossFunction lossWith, AddFunction add)
+  {
+    auto isWithin = [](const long size, const long limit) { return limit < 0 || size <= limit; };
+    const long numberOfTrees = costs.size();
+    vector<bool> isPicked(numberOfTrees, false);
+    vector<PruningStep> steps;
+    PruningStep step{-1, 0, 0, 0, 0.0, 0.0};
+    while (step._numberOfTrees < numberOfTrees &&
+           isWithin(step._numberOfTrees+1, budget._maxNumberOfTrees)) {
+      long bestTreeId = -1;
+      double bestLoss = std::numeric_limits<double>::max();
+      for (long treeId = 0; treeId < numberOfTrees; ++treeId) {
+        if (isPicked[treeId] ||
+            !isWithin(step._numberOfNodes+costs[treeId]._numberOfNodes,
+                      budget._maxNumberOfNodes) ||
+            !isWithin(step._numberOfBytes+costs[treeId]._numberOfBytes,
+                      budget._maxNumberOfBytes))
+          continue;
+        const double loss = lossWith(treeId);
+        if (loss < bestLoss) {
+          bestLoss = loss;
+          bestTreeId = treeId;
+        }
+      }
+      if (bestTreeId < 0) break;
+
+      add(bestTreeId);
+      isPicked[bestTreeId] = true;
+      step._treeId = bestTreeId;
+      ++step._numberOfTrees;
+      step._numberOfNodes += costs[bestTreeId]._numberOfNodes;
+      step._numberOfBytes += costs[bestTreeId]._numberOfBytes;
+      step._averagePathLength += costs[bestTreeId]._averagePathLength;
+      step._loss = bestLoss;
+      steps.push_back(step);
+    }
+    return steps;
+  }
+
+  // The number of steps of the smallest ensemble with the lowest loss.
+  inline long
+  _bestNumberOfSteps(const vector<PruningStep>& steps)
+  {
+    if (steps.empty()) return 0;
+    long bestStepId = 0;
+    for (long stepId = 1; stepId < static_cast<long>(steps.size()); ++stepId)
+      if (steps[stepId]._loss < steps[bestStepId]._loss) bestStepId = stepId;
+    return bestStepId+1;
+  }
+}
+
+#endif //_ENSEMBLE_PRUNING
@@ -0,0 +1,97 @@
+#ifndef _FEATURE_STORE
+#define _FEATURE_STORE
+#include "../core/Definitions.hpp"
+#include "./_BinnedDataset.hpp"
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace Lib15x
+{
+  class _FeatureStore {
+  public:
+    _FeatureStore() : _numberOfData{0}, _numberOfFeatures{0},
+      _binnedDataMutex{std::make_unique<std::mutex>()} { }
+
+    explicit _FeatureStore(const MatrixXd& data) : _FeatureStore{}
+    {
+      reset(data);
+    }
+
+    void
+    reset(const MatrixXd& data)
+    {
+      _numberOfData = data.rows();
+      _numberOfFeatures = data.cols();
+      _columns.resize(static_cast<size_t>(_numberOfData*_numberOfFeatures));
+      for (long dataId = 0; dataId < _numberOfData; ++dataId) {
+        const double* row = &data(dataId, 0);
+        for (long featId = 0; featId < _numberOfFeatures; ++featId)
+          _columns[featId*_numberOfData + dataId] = row[featId];
+      }
+
+      for (auto& epsilonAndCache : std::get<0>(_binnedData))
+        epsilonAndCache.second._isValid = false;
+      for (auto& epsilonAndCache : std::get<1>(_binnedData))
+        epsilonAndCache.second._isValid = false;
+    }
+
+    const double*
+    column(const long featureIndex) const
+    {
+      return &_columns[featureIndex*_numberOfData];
+    }
+
+    double
+    operator()(const long dataIndex, const long featureIndex) const
+    {
+      return _columns[featureIndex*_numberOfData + dataIndex];
+    }
+
+    long
+    rows() const
+    {
+      return _numberOfData;
+    }
+
+    long
+    cols() const
+    {
+      return _numberOfFeatures;
+    }
+
+    // sketchEpsilon > 0 bins by quantile sketches, see _BinnedDataset. One dataset is kept
+    // per epsilon and rebinned in place, so splitters may hold on to the returned reference.
+    template<typename BinType>
+    const _BinnedDataset<BinType>&
+    binnedData(const double sketchEpsilon=0.0) const
+    {
+      std::lock_guard<std::mutex> lock(*_binnedDataMutex);
+      auto& cache = std::get<_BinnedDataCaches<BinType> >(_binnedData)[sketchEpsilon];
+      if (!cache._data)
+        cache._data = std::make_unique<_BinnedDataset<BinType> >(
+          *this, _BinnedDataset<BinType>::MaxNumberOfBins, sketchEpsilon);
+      else if (!cache._isValid)
+        cache._data->reset(*this);
+      cache._isValid = true;
+      return *cache._data;
+    }
+
+  private:
+    template<typename BinType>
+    struct _BinnedDataCache {
+      std::unique_ptr<_BinnedDataset<BinType> > _data;
+      bool _isValid=false;
+    };
+
+    template<typename BinType>
+    using _BinnedDataCaches = std::map<double, _BinnedDataCache<BinType> >;
+
+    long _numberOfData;
+    long _numberOfFeatures;
+    vector<double> _columns;
+    std::unique_ptr<std::mutex> _binnedDataMutex;
+    mutable std::tuple<_BinnedDataCaches<uint8_t>, _BinnedDataCaches<uint16_t> > _binnedData;
+  };
+}
+#endif // _FEATURE_STORE
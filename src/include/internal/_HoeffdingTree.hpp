@@ -0,0 +1,347 @@
+#ifndef _HOEFFDING_TREE
+#define _HOEFFDING_TREE
+#include "../core/Definitions.hpp"
+#include "./_ClassificationCriterion.hpp"
+#include "./_ClassificationTree.hpp"
+#include "./_TreeUtilities.hpp"
+
+namespace Lib15x
+{
+  struct _HoeffdingOptions {
+    long _numberOfFeaturesToSplit;
+    long _maxDepth;
+    long _maxNumberOfLeafNodes;
+    // samples a new leaf buffers to pick its candidate thresholds from
+    long _numberOfCandidates = 32;
+    // weight a leaf sees between two split attempts
+    double _gracePeriod = 200.0;
+    // probability of choosing the wrong feature at a split
+    double _splitConfidence = 1e-6;
+    // a bound this small splits on the best candidate even when two features tie
+    double _tieThreshold = 0.05;
+  };
+
+  // A classification tree grown from a stream of samples (the VFDT of Domingos and Hulten).
+  // A leaf counts the classes in the bins of a few candidate thresholds of a random subset of
+  // features, and splits once the Hoeffding bound tells its best feature apart from the
+  // runner-up. Leaves drop their bins when they split or the tree is full, so the memory does
+  // not grow with the length of the stream.
+  template<double (*ImpurityRule)(const vector<double>&)>
+  class _HoeffdingTree {
+  public:
+    struct _LeafStatistics {
+      vector<long> _featureIndices;
+      // numberOfCandidates-1 per feature, the unused ones at max
+      vector<double> _thresholds;
+      // numberOfCandidates bins per feature and numberOfClasses counts per bin; bin b holds
+      // the samples above b thresholds
+      vector<double> _binLabelsCount;
+      vector<double> _bufferedValues;
+      vector<std::pair<long, double> > _bufferedLabels;
+      double _weight = 0.0;
+      double _weightSinceAttempt = 0.0;
+    };
+
+    struct _Node {
+      long _featureIndex = -1;
+      double _threshold = 0.0;
+      // the right child follows the left one
+      long _leftChildIndex = -1;
+      long _depth = 0;
+      vector<double> _labelsCount;
+      std::unique_ptr<_LeafStatistics> _statistics;
+    };
+
+    _HoeffdingTree(const long numberOfFeatures, const long numberOfClasses,
+                   const _HoeffdingOptions& options, std::mt19937* randomEngine=nullptr) :
+      _numberOfFeatures{numberOfFeatures}, _numberOfClasses{numberOfClasses},
+      _options(options),
+      _impurityRange{ImpurityRule(vector<double>(numberOfClasses, 1.0))},
+      _randomEngine{randomEngine}
+    {
+      reset();
+    }
+
+    void
+    reset()
+    {
+      _nodes.clear();
+      _nodes.emplace_back();
+      _nodes[0]._labelsCount.assign(_numberOfClasses, 0.0);
+      _numberOfLeaves = 1;
+      _startCollecting(0);
+    }
+
+    void
+    update(const double* instance, const long label, const double weight)
+    {
+      long nodeIndex = 0;
+      while (_nodes[nodeIndex]._featureIndex >= 0) {
+        const _Node& node = _nodes[nodeIndex];
+        nodeIndex = node._leftChildIndex + !(instance[node._featureIndex] < node._threshold);
+      }
+      _Node& leaf = _nodes[nodeIndex];
+      leaf._labelsCount[label] += weight;
+
+      _LeafStatistics* statistics = leaf._statistics.get();
+      if (!statistics) return;
+      statistics->_weight += weight;
+      if (statistics->_thresholds.empty()) {
+        for (const long featureIndex : statistics->_featureIndices)
+          statistics->_bufferedValues.push_back(instance[featureIndex]);
+        statistics->_bufferedLabels.push_back(std::make_pair(label, weight));
+        const long numberOfBufferedSamples = statistics->_bufferedLabels.size();
+        if (numberOfBufferedSamples >= _options._numberOfCandidates)
+          _pickThresholds(statistics);
+        return;
+      }
+
+      _countInBins(statistics, instance, label, weight);
+      statistics->_weightSinceAttempt += weight;
+      if (statistics->_weightSinceAttempt >= _options._gracePeriod) {
+        statistics->_weightSinceAttempt = 0.0;
+        _attemptToSplit(nodeIndex);
+      }
+    }
+
+    // Writes the current tree, with the class frequencies of every leaf, as a finalized tree.
+    void
+    compile(_ClassificationTree* tree) const
+    {
+      tree->reset();
+      tree->reserve(_nodes.size());
+      vector<long> compiledIndexOfNode(_nodes.size(), -1);
+      vector<long> parentOfNode(_nodes.size(), -1);
+      for (long nodeIndex = 0; nodeIndex < static_cast<long>(_nodes.size()); ++nodeIndex) {
+        const _Node& node = _nodes[nodeIndex];
+        const long parentIndex = parentOfNode[nodeIndex];
+        const bool isLeft =
+          parentIndex >= 0 && _nodes[parentIndex]._leftChildIndex == nodeIndex;
+        compiledIndexOfNode[nodeIndex] =
+          tree->addNode(parentIndex < 0 ? -1 : compiledIndexOfNode[parentIndex], isLeft,
+                        node._featureIndex, node._threshold);
+        if (node._featureIndex >= 0) {
+          parentOfNode[node._leftChildIndex] = nodeIndex;
+          parentOfNode[node._leftChildIndex+1] = nodeIndex;
+          continue;
+        }
+        vector<double> frequencies = node._labelsCount;
+        const double weight =
+          std::accumulate(std::begin(frequencies), std::end(frequencies), 0.0);
+        if (weight > 0.0)
+          for (auto& frequency : frequencies) frequency /= weight;
+        tree->addLeaf(compiledIndexOfNode[nodeIndex], std::move(frequencies));
+      }
+      tree->finalize();
+    }
+
+    long
+    numberOfLeaves() const
+    {
+      return _numberOfLeaves;
+    }
+
+    long
+    numberOfCollectingLeaves() const
+    {
+      long count = 0;
+      for (const auto& node : _nodes)
+        count += node._statistics != nullptr;
+      return count;
+    }
+
+  private:
+    bool
+    _isFull() const
+    {
+      return _options._maxNumberOfLeafNodes > 0 &&
+        _numberOfLeaves >= _options._maxNumberOfLeafNodes;
+    }
+
+    void
+    _startCollecting(const long nodeIndex)
+    {
+      if (_nodes[nodeIndex]._depth >= _options._maxDepth || _isFull()) return;
+
+      auto statistics = std::make_unique<_LeafStatistics>();
+      vector<long> featureIndices(_numberOfFeatures);
+      std::iota(std::begin(featureIndices), std::end(featureIndices), 0);
+      const long numberOfFeaturesToSplit =
+        std::max(1L, std::min(_options._numberOfFeaturesToSplit, _numberOfFeatures));
+      for (long featId = 0; featId < numberOfFeaturesToSplit; ++featId)
+        std::swap(featureIndices[featId],
+                  featureIndices[featId+_randomIndex(_randomEngine, _numberOfFeatures-featId)]);
+      featureIndices.resize(numberOfFeaturesToSplit);
+      std::sort(std::begin(featureIndices), std::end(featureIndices));
+      statistics->_featureIndices = std::move(featureIndices);
+      _nodes[nodeIndex]._statistics = std::move(statistics);
+    }
+
+    // Thresholds halfway between the distinct buffered values; the buffer is then counted.
+    void
+    _pickThresholds(_LeafStatistics* statistics)
+    {
+      const long numberOfFeatures = statistics->_featureIndices.size();
+      const long numberOfSamples = statistics->_bufferedLabels.size();
+      const long numberOfThresholds = _options._numberOfCandidates-1;
+      statistics->_thresholds.assign(numberOfFeatures*numberOfThresholds,
+                                     std::numeric_limits<double>::max());
+      statistics->_binLabelsCount.assign(numberOfFeatures*_options._numberOfCandidates*
+                                         _numberOfClasses, 0.0);
+      vector<double> values(numberOfSamples);
+      for (long featId = 0; featId < numberOfFeatures; ++featId) {
+        for (long sampleId = 0; sampleId < numberOfSamples; ++sampleId)
+          values[sampleId] = statistics->_bufferedValues[sampleId*numberOfFeatures+featId];
+        values.erase(std::remove_if(std::begin(values), std::end(values),
+                                    [](const double value) { return std::isnan(value); }),
+                     std::end(values));
+        std::sort(std::begin(values), std::end(values));
+        values.erase(std::unique(std::begin(values), std::end(values)), std::end(values));
+        double* thresholds = &statistics->_thresholds[featId*numberOfThresholds];
+        for (long valueId = 0; valueId+1 < static_cast<long>(values.size()); ++valueId)
+          thresholds[valueId] = (values[valueId]+values[valueId+1])/2.0;
+        values.resize(numberOfSamples);
+      }
+
+      vector<double> instance(_numberOfFeatures);
+      for (long sampleId = 0; sampleId < numberOfSamples; ++sampleId) {
+        for (long featId = 0; featId < numberOfFeatures; ++featId)
+          instance[statistics->_featureIndices[featId]] =
+            statistics->_bufferedValues[sampleId*numberOfFeatures+featId];
+        const auto& labelAndWeight = statistics->_bufferedLabels[sampleId];
+        _countInBins(statistics, instance.data(), labelAndWeight.first, labelAndWeight.second);
+      }
+      vector<double>().swap(statistics->_bufferedValues);
+      vector<std::pair<long, double> >().swap(statistics->_bufferedLabels);
+    }
+
+    void
+    _countInBins(_LeafStatistics* statistics, const double* instance, const long label,
+                 const double weight) const
+    {
+      const long numberOfThresholds = _options._numberOfCandidates-1;
+      const long numberOfFeatures = statistics->_featureIndices.size();
+      for (long featId = 0; featId < numberOfFeatures; ++featId) {
+        const double value = instance[statistics->_featureIndices[featId]];
+        const double* thresholds = &statistics->_thresholds[featId*numberOfThresholds];
+        // a missing value goes right of every threshold, as in prediction
+        const long binId = std::isnan(value) ? numberOfThresholds :
+          std::upper_bound(thresholds, thresholds+numberOfThresholds, value) - thresholds;
+        statistics->_binLabelsCount[(featId*_options._numberOfCandidates+binId)*
+                                    _numberOfClasses+label] += weight;
+      }
+    }
+
+    void
+    _attemptToSplit(const long nodeIndex)
+    {
+      _LeafStatistics* statistics = _nodes[nodeIndex]._statistics.get();
+      const long numberOfThresholds = _options._numberOfCandidates-1;
+      const long numberOfFeatures = statistics->_featureIndices.size();
+      const double weight = statistics->_weight;
+
+      vector<double> labelsCount(_numberOfClasses, 0.0);
+      for (long binId = 0; binId < _options._numberOfCandidates; ++binId)
+        for (long classId = 0; classId < _numberOfClasses; ++classId)
+          labelsCount[classId] += statistics->_binLabelsCount[binId*_numberOfClasses+classId];
+      const double impurity =
+        _ImpurityOfLabelsCount<ImpurityRule>::evaluate(labelsCount, weight);
+      if (impurity <= 0.0) return;
+
+      // the runner-up is at least the gain of not splitting
+      double bestImprovement = 0.0;
+      double secondImprovement = 0.0;
+      long bestFeatId = -1;
+      long bestThresholdId = -1;
+      vector<double> leftLabelsCount(_numberOfClasses);
+      vector<double> rightLabelsCount(_numberOfClasses);
+      for (long featId = 0; featId < numberOfFeatures; ++featId) {
+        const double* binLabelsCount =
+          &statistics->_binLabelsCount[featId*_options._numberOfCandidates*_numberOfClasses];
+        const double* thresholds = &statistics->_thresholds[featId*numberOfThresholds];
+        std::fill(std::begin(leftLabelsCount), std::end(leftLabelsCount), 0.0);
+        double featureImprovement = 0.0;
+        long featureThresholdId = -1;
+        for (long thresholdId = 0; thresholdId < numberOfThresholds &&
+               thresholds[thresholdId] < std::numeric_limits<double>::max(); ++thresholdId) {
+          for (long classId = 0; classId < _numberOfClasses; ++classId) {
+            leftLabelsCount[classId] += binLabelsCount[thresholdId*_numberOfClasses+classId];
+            rightLabelsCount[classId] = labelsCount[classId]-leftLabelsCount[classId];
+          }
+          const double leftWeight =
+            std::accumulate(std::begin(leftLabelsCount), std::end(leftLabelsCount), 0.0);
+          const double rightWeight = weight-leftWeight;
+          if (leftWeight <= 0.0 || rightWeight <= 0.0) continue;
+          const double improvement = impurity-
+            (leftWeight*_ImpurityOfLabelsCount<ImpurityRule>::evaluate(leftLabelsCount,
+                                                                        leftWeight)+
+             rightWeight*_ImpurityOfLabelsCount<ImpurityRule>::evaluate(rightLabelsCount,
+                                                                         rightWeight))/weight;
+          if (improvement > featureImprovement) {
+            featureImprovement = improvement;
+            featureThresholdId = thresholdId;
+          }
+        }
+        if (featureImprovement > bestImprovement) {
+          secondImprovement = bestImprovement;
+          bestImprovement = featureImprovement;
+          bestFeatId = featId;
+          bestThresholdId = featureThresholdId;
+        }
+        else
+          secondImprovement = std::max(secondImprovement, featureImprovement);
+      }
+      if (bestFeatId < 0) return;
+
+      const double bound = _impurityRange*
+        std::sqrt(std::log(1.0/_options._splitConfidence)/(2.0*weight));
+      if (bestImprovement-secondImprovement <= bound && bound >= _options._tieThreshold)
+        return;
+      _split(nodeIndex, bestFeatId, bestThresholdId);
+    }
+
+    void
+    _split(const long nodeIndex, const long featId, const long thresholdId)
+    {
+      std::unique_ptr<_LeafStatistics> statistics = std::move(_nodes[nodeIndex]._statistics);
+      const long numberOfThresholds = _options._numberOfCandidates-1;
+      const double* binLabelsCount =
+        &statistics->_binLabelsCount[featId*_options._numberOfCandidates*_numberOfClasses];
+      const long leftChildIndex = _nodes.size();
+      _nodes.emplace_back();
+      _nodes.emplace_back();
+
+      _Node& node = _nodes[nodeIndex];
+      node._featureIndex = statistics->_featureIndices[featId];
+      node._threshold = statistics->_thresholds[featId*numberOfThresholds+thresholdId];
+      node._leftChildIndex = leftChildIndex;
+      for (long childId = 0; childId < 2; ++childId) {
+        _Node& child = _nodes[leftChildIndex+childId];
+        child._depth = node._depth+1;
+        child._labelsCount.assign(_numberOfClasses, 0.0);
+      }
+      for (long binId = 0; binId < _options._numberOfCandidates; ++binId) {
+        _Node& child = _nodes[leftChildIndex+(binId > thresholdId)];
+        for (long classId = 0; classId < _numberOfClasses; ++classId)
+          child._labelsCount[classId] += binLabelsCount[binId*_numberOfClasses+classId];
+      }
+      ++_numberOfLeaves;
+      _startCollecting(leftChildIndex);
+      _startCollecting(leftChildIndex+1);
+      if (_isFull())
+        for (auto& leaf : _nodes)
+          leaf._statistics.reset();
+    }
+
+    long _numberOfFeatures;
+    long _numberOfClasses;
+    _HoeffdingOptions _options;
+    // the largest impurity, so the bound on the gain estimate
+    double _impurityRange;
+    // draws the features of new leaves; rand() when null
+    std::mt19937* _randomEngine;
+    vector<_Node> _nodes;
+    long _numberOfLeaves = 0;
+  };
+}
+#endif // _HOEFFDING_TREE
@@ -0,0 +1,44 @@
+#ifndef _PARALLEL
+#define _PARALLEL
+#include "../core/Definitions.hpp"
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+
+namespace Lib15x
+{
+  template<class Function>
+  void
+  _parallelFor(const long numberOfThreads, const long numberOfTasks, Function&& function)
+  {
+    std::atomic<long> nextTaskId{0};
+    std::exception_ptr exception;
+    std::mutex exceptionMutex;
+
+    auto worker = [&](const long threadId) {
+      long taskId;
+      while ((taskId = nextTaskId++) < numberOfTasks) {
+        try {
+          function(taskId, threadId);
+        }
+        catch (...) {
+          std::lock_guard<std::mutex> lock(exceptionMutex);
+          if (!exception) exception = std::current_exception();
+          nextTaskId = numberOfTasks;
+        }
+      }
+    };
+
+    const long numberOfWorkers = std::min(numberOfThreads, numberOfTasks);
+    vector<std::thread> threads;
+    for (long threadId = 1; threadId < numberOfWorkers; ++threadId)
+      threads.emplace_back(worker, threadId);
+    worker(0);
+    for (auto& thread : threads)
+      thread.join();
+
+    if (exception) std::rethrow_exception(exception);
+  }
+}
+#endif // _PARALLEL
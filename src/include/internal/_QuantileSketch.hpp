@@ -0,0 +1,284 @@
+#ifndef _QUANTILE_SKETCH
+#define _QUANTILE_SKETCH
+#include "../core/Definitions.hpp"
+
+namespace Lib15x
+{
+  // Weighted quantile summary in the style of Greenwald-Khanna as used by XGBoost. Every
+  // entry keeps a value with the weight of that value and the bounds of the weight below it.
+  // Values are buffered and folded in through levels of doubling weight, so a stream of
+  // total weight W answers rank queries within epsilon*W. Two sketches merge with the same
+  // bound, so chunks can be summarized separately, e.g. by threads or per file block.
+  //
+  // Pruning a summary to n+1 entries adds up to 1/n of its weight to the rank error. Level k
+  // keeps 2(k+1)(k+2)/epsilon+1 entries, so the levels add at most epsilon/2 however many
+  // there are, and the final summary of 2/epsilon+1 entries adds the other half.
+  class _QuantileSketch {
+  public:
+    struct _Entry {
+      double _value;
+      double _rankMin;
+      double _rankMax;
+      double _weight;
+
+      double
+      rankMinNext() const
+      {
+        return _rankMin + _weight;
+      }
+
+      double
+      rankMaxPrev() const
+      {
+        return _rankMax - _weight;
+      }
+    };
+
+    explicit _QuantileSketch(const double epsilon) :
+      _epsilon{epsilon},
+      _summarySize{static_cast<long>(std::ceil(2.0/epsilon))+1}
+    {
+      if (!(epsilon > 0.0 && epsilon < 1.0)) {
+        throwException("Error happened when constructing quantile sketch: "
+                       "epsilon must be in (0, 1), provided (%f).\n", epsilon);
+      }
+    }
+
+    void
+    push(const double value, const double weight=1.0)
+    {
+      if (std::isnan(value) || !(weight > 0.0)) return;
+      _buffer.push_back(std::make_pair(value, weight));
+      if (static_cast<long>(_buffer.size()) >= _summarySize)
+        _flushBuffer();
+    }
+
+    // The other sketch was pruned on its levels below other._levels.size() only, so its
+    // folded summary is carried in above them like a flushed level.
+    void
+    merge(const _QuantileSketch& other)
+    {
+      vector<_Entry> carry = other._foldedSummary();
+      if (!carry.empty())
+        _carryFrom(other._levels.size(), &carry);
+    }
+
+    // All levels and the buffer folded into one summary, sorted by value.
+    vector<_Entry>
+    summary() const
+    {
+      vector<_Entry> pruned;
+      _prune(_foldedSummary(), _summarySize, &pruned);
+      return pruned;
+    }
+
+    double
+    totalWeight() const
+    {
+      vector<_Entry> entries = summary();
+      return entries.empty() ? 0.0 : entries.back()._rankMax;
+    }
+
+    // Thresholds splitting the weight into about maxNumberOfCuts+1 equal parts. A cut lies
+    // halfway between two neighbouring summary values, so no summarized value equals it;
+    // neighbours closer than minGap are not cut.
+    vector<double>
+    cutPoints(const long maxNumberOfCuts, const double minGap=0.0) const
+    {
+      const vector<_Entry> entries = summary();
+      vector<double> cuts;
+      if (entries.size() < 2 || maxNumberOfCuts <= 0) return cuts;
+
+      const long numberOfEntries = entries.size();
+      const double totalWeight = entries.back()._rankMax;
+      long entryId = 0;
+      for (long cutId = 1; cutId <= maxNumberOfCuts; ++cutId) {
+        long pickedId = cutId-1;
+        if (numberOfEntries > maxNumberOfCuts+1) {
+          const double targetRank =
+            static_cast<double>(cutId)*totalWeight/static_cast<double>(maxNumberOfCuts+1);
+          while (entryId+1 < numberOfEntries-1 &&
+                 _rankOfCutAfter(entries[entryId+1]) <= targetRank)
+            ++entryId;
+          pickedId = entryId;
+          if (entryId+1 < numberOfEntries-1 &&
+              _rankOfCutAfter(entries[entryId+1])-targetRank <
+              targetRank-_rankOfCutAfter(entries[entryId]))
+            pickedId = entryId+1;
+        }
+        if (pickedId >= numberOfEntries-1) break;
+        if (entries[pickedId+1]._value <= entries[pickedId]._value + minGap) continue;
+        const double cut = (entries[pickedId]._value + entries[pickedId+1]._value)/2.0;
+        if (cuts.empty() || cut > cuts.back())
+          cuts.push_back(cut);
+      }
+      return cuts;
+    }
+
+    double
+    epsilon() const
+    {
+      return _epsilon;
+    }
+
+  private:
+    // the estimated weight at or below the entry
+    static double
+    _rankOfCutAfter(const _Entry& entry)
+    {
+      return (entry.rankMinNext() + entry._rankMax)/2.0;
+    }
+
+    vector<_Entry>
+    _summaryOfBuffer() const
+    {
+      vector<std::pair<double, double> > sortedBuffer = _buffer;
+      std::sort(std::begin(sortedBuffer), std::end(sortedBuffer));
+      vector<_Entry> entries;
+      double rank = 0.0;
+      for (const auto& valueAndWeight : sortedBuffer) {
+        if (!entries.empty() && entries.back()._value == valueAndWeight.first) {
+          entries.back()._weight += valueAndWeight.second;
+          entries.back()._rankMax += valueAndWeight.second;
+        }
+        else
+          entries.push_back(_Entry{valueAndWeight.first, rank, rank+valueAndWeight.second,
+                valueAndWeight.second});
+        rank += valueAndWeight.second;
+      }
+      return entries;
+    }
+
+    vector<_Entry>
+    _foldedSummary() const
+    {
+      vector<_Entry> result = _summaryOfBuffer();
+      vector<_Entry> combined;
+      for (const auto& level : _levels) {
+        _combine(result, level, &combined);
+        result.swap(combined);
+      }
+      return result;
+    }
+
+    long
+    _levelSize(const long levelId) const
+    {
+      return static_cast<long>(std::ceil(2.0*static_cast<double>((levelId+1)*(levelId+2))/
+                                         _epsilon))+1;
+    }
+
+    void
+    _flushBuffer()
+    {
+      vector<_Entry> carry;
+      _prune(_summaryOfBuffer(), _levelSize(0), &carry);
+      _buffer.clear();
+      _carryFrom(0, &carry);
+    }
+
+    // Stores carry at the first empty level from levelId on, combining it with the full
+    // levels it passes and pruning each result to the budget of the level above.
+    void
+    _carryFrom(long levelId, vector<_Entry>* carry)
+    {
+      if (static_cast<long>(_levels.size()) <= levelId)
+        _levels.resize(levelId+1);
+      vector<_Entry> combined;
+      for (; levelId < static_cast<long>(_levels.size()); ++levelId) {
+        vector<_Entry>& level = _levels[levelId];
+        if (level.empty()) {
+          level.swap(*carry);
+          return;
+        }
+        _combine(level, *carry, &combined);
+        _prune(combined, _levelSize(levelId+1), carry);
+        level.clear();
+      }
+      _levels.push_back(vector<_Entry>());
+      _levels.back().swap(*carry);
+    }
+
+    static void
+    _combine(const vector<_Entry>& a, const vector<_Entry>& b, vector<_Entry>* result)
+    {
+      result->clear();
+      if (a.empty()) { *result = b; return; }
+      if (b.empty()) { *result = a; return; }
+
+      auto itA = std::begin(a);
+      auto itB = std::begin(b);
+      double previousRankMinA = 0.0;
+      double previousRankMinB = 0.0;
+      while (itA != std::end(a) && itB != std::end(b)) {
+        if (itA->_value == itB->_value) {
+          result->push_back(_Entry{itA->_value, itA->_rankMin+itB->_rankMin,
+                itA->_rankMax+itB->_rankMax, itA->_weight+itB->_weight});
+          previousRankMinA = itA->rankMinNext();
+          previousRankMinB = itB->rankMinNext();
+          ++itA;
+          ++itB;
+        }
+        else if (itA->_value < itB->_value) {
+          result->push_back(_Entry{itA->_value, itA->_rankMin+previousRankMinB,
+                itA->_rankMax+itB->rankMaxPrev(), itA->_weight});
+          previousRankMinA = itA->rankMinNext();
+          ++itA;
+        }
+        else {
+          result->push_back(_Entry{itB->_value, itB->_rankMin+previousRankMinA,
+                itB->_rankMax+itA->rankMaxPrev(), itB->_weight});
+          previousRankMinB = itB->rankMinNext();
+          ++itB;
+        }
+      }
+      for (; itA != std::end(a); ++itA)
+        result->push_back(_Entry{itA->_value, itA->_rankMin+previousRankMinB,
+              itA->_rankMax+b.back()._rankMax, itA->_weight});
+      for (; itB != std::end(b); ++itB)
+        result->push_back(_Entry{itB->_value, itB->_rankMin+previousRankMinA,
+              itB->_rankMax+a.back()._rankMax, itB->_weight});
+    }
+
+    // Keeps maxSize entries spread evenly over the rank range, always with both ends.
+    static void
+    _prune(const vector<_Entry>& source, const long maxSize, vector<_Entry>* result)
+    {
+      const long sourceSize = source.size();
+      if (sourceSize <= maxSize) {
+        *result = source;
+        return;
+      }
+      result->clear();
+      const double beginRank = source.front()._rankMax;
+      const double rankRange = source.back()._rankMin - beginRank;
+      const long numberOfSteps = maxSize-1;
+      result->push_back(source.front());
+      long sourceId = 1;
+      long lastId = 0;
+      for (long stepId = 1; stepId < numberOfSteps; ++stepId) {
+        const double twiceTargetRank = 2.0*(static_cast<double>(stepId)*rankRange/
+                                             static_cast<double>(numberOfSteps) + beginRank);
+        while (sourceId < sourceSize-1 &&
+               twiceTargetRank >= source[sourceId+1]._rankMax + source[sourceId+1]._rankMin)
+          ++sourceId;
+        if (sourceId == sourceSize-1) break;
+        const long pickedId =
+          twiceTargetRank < source[sourceId].rankMinNext() + source[sourceId+1].rankMaxPrev() ?
+          sourceId : sourceId+1;
+        if (pickedId != lastId) {
+          result->push_back(source[pickedId]);
+          lastId = pickedId;
+        }
+      }
+      if (lastId != sourceSize-1)
+        result->push_back(source.back());
+    }
+
+    double _epsilon;
+    long _summarySize;
+    vector<std::pair<double, double> > _buffer;
+    vector<vector<_Entry> > _levels;
+  };
+}
+#endif // _QUANTILE_SKETCH
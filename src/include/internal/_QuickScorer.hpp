@@ -0,0 +1,160 @@
+#ifndef _QUICK_SCORER
+#define _QUICK_SCORER
+
+#include <cstdint>
+#include "../core/Definitions.hpp"
+
+namespace Lib15x
+{
+  // QuickScorer evaluation of a forest whose trees have at most 64 leaves. The split
+  // conditions of all trees are grouped by feature and sorted by threshold. Each tree keeps a
+  // 64-bit mask of the leaves that are still reachable, one bit per leaf from left to right.
+  // A row scans every feature's thresholds in ascending order while the row goes right,
+  // clearing the leaves of that node's left subtree. The lowest bit left set is the exit leaf.
+  class _QuickScorer {
+  public:
+    static constexpr long MaxNumberOfLeaves = 64;
+
+    template<class Tree>
+    static bool
+    fits(const Tree& tree)
+    {
+      return (static_cast<long>(tree._flatFeatureIndices.size())+1)/2 <= MaxNumberOfLeaves;
+    }
+
+    template<class Tree>
+    void
+    build(const Tree* trees, const long numberOfTrees, const long numberOfFeatures)
+    {
+      reset();
+      _numberOfTrees = numberOfTrees;
+      _leafNodeIndices.assign(numberOfTrees*MaxNumberOfLeaves, 0);
+
+      vector<_Condition> conditions;
+      for (long treeId = 0; treeId < numberOfTrees; ++treeId) {
+        const Tree& tree = trees[treeId];
+        if (!tree._isFinalized || !fits(tree)) {
+          throwException("Error happened when building QuickScorer: tree %ld has more than "
+                         "%ld leaves or is not trained, use maxNumberOfLeafNodes <= %ld",
+                         treeId, MaxNumberOfLeaves, MaxNumberOfLeaves);
+        }
+        long numberOfLeaves = 0;
+        _addConditionsOf(tree, treeId, 0, &numberOfLeaves, &conditions);
+      }
+
+      std::stable_sort(conditions.begin(), conditions.end(),
+                       [](const _Condition& a, const _Condition& b) {
+                         return a._feature < b._feature ||
+                           (a._feature == b._feature && a._threshold < b._threshold);
+                       });
+
+      _featureOffsets.assign(numberOfFeatures+1, 0);
+      _thresholds.reserve(conditions.size());
+      _treeIds.reserve(conditions.size());
+      _masks.reserve(conditions.size());
+      for (const _Condition& condition : conditions) {
+        ++_featureOffsets[condition._feature+1];
+        _thresholds.push_back(condition._threshold);
+        _treeIds.push_back(condition._treeId);
+        _masks.push_back(condition._mask);
+      }
+      std::partial_sum(_featureOffsets.begin(), _featureOffsets.end(), _featureOffsets.begin());
+    }
+
+    // Calls scoreRow(rowPosition, leafIndices) for every row of testIndices, with leafIndices
+    // holding the flat leaf index of each tree, as accepted by the trees' leafValue.
+    template<class ScoreFunction>
+    void
+    predictRows(const MatrixXd& testData, const vector<long>& testIndices,
+                ScoreFunction scoreRow) const
+    {
+      assert(_numberOfTrees > 0);
+      const long numberOfFeatures = _featureOffsets.size()-1;
+      assert(testData.cols() == numberOfFeatures);
+      vector<uint64_t> leafMasks(_numberOfTrees);
+      vector<int32_t> leafIndices(_numberOfTrees);
+
+      for (long rowPosition = 0; rowPosition < static_cast<long>(testIndices.size());
+           ++rowPosition) {
+        const double* instance = &testData(testIndices[rowPosition], 0);
+        std::fill(leafMasks.begin(), leafMasks.end(), ~uint64_t{0});
+
+        for (long featureId = 0; featureId < numberOfFeatures; ++featureId) {
+          const double value = instance[featureId];
+          const double* thresholds = _thresholds.data();
+          // The row goes right at every threshold not above its value. NaN compares false
+          // against every threshold and so goes right everywhere, as in the node traversal.
+          const long endOffset = std::isnan(value) ? _featureOffsets[featureId+1] :
+            std::upper_bound(thresholds+_featureOffsets[featureId],
+                             thresholds+_featureOffsets[featureId+1], value)-thresholds;
+          for (long offset = _featureOffsets[featureId]; offset < endOffset; ++offset)
+            leafMasks[_treeIds[offset]] &= _masks[offset];
+        }
+
+        for (long treeId = 0; treeId < _numberOfTrees; ++treeId)
+          leafIndices[treeId] =
+            _leafNodeIndices[treeId*MaxNumberOfLeaves+__builtin_ctzll(leafMasks[treeId])];
+        scoreRow(rowPosition, leafIndices.data());
+      }
+    }
+
+    long
+    numberOfTrees() const
+    {
+      return _numberOfTrees;
+    }
+
+    void
+    reset()
+    {
+      _numberOfTrees = 0;
+      _featureOffsets.clear();
+      _thresholds.clear();
+      _treeIds.clear();
+      _masks.clear();
+      _leafNodeIndices.clear();
+    }
+
+  private:
+    struct _Condition {
+      long _feature;
+      double _threshold;
+      int32_t _treeId;
+      uint64_t _mask;
+    };
+
+    // Numbers the leaves from left to right and records, for each split, the mask that clears
+    // the leaves of its left subtree.
+    template<class Tree>
+    void
+    _addConditionsOf(const Tree& tree, const long treeId, const int32_t nodeIndex,
+                     long* numberOfLeaves, vector<_Condition>* conditions)
+    {
+      const int32_t feature = tree._flatFeatureIndices[nodeIndex];
+      if (feature < 0) {
+        _leafNodeIndices[treeId*MaxNumberOfLeaves+*numberOfLeaves] = nodeIndex;
+        ++*numberOfLeaves;
+        return;
+      }
+
+      const long firstLeftLeaf = *numberOfLeaves;
+      const int32_t leftChildIndex = tree._flatChildIndices[nodeIndex];
+      _addConditionsOf(tree, treeId, leftChildIndex, numberOfLeaves, conditions);
+      const long numberOfLeftLeaves = *numberOfLeaves-firstLeftLeaf;
+      _addConditionsOf(tree, treeId, leftChildIndex+1, numberOfLeaves, conditions);
+
+      const uint64_t leftLeaves = ((uint64_t{1} << numberOfLeftLeaves)-1) << firstLeftLeaf;
+      conditions->push_back(_Condition{feature, tree._flatThresholds[nodeIndex],
+            static_cast<int32_t>(treeId), ~leftLeaves});
+    }
+
+    long _numberOfTrees = 0;
+    vector<long> _featureOffsets;
+    vector<double> _thresholds;
+    vector<int32_t> _treeIds;
+    vector<uint64_t> _masks;
+    vector<int32_t> _leafNodeIndices;
+  };
+}
+
+#endif //_QUICK_SCORER
@@ -11,97 +11,139 @@ namespace Lib15x
   public:
     using BaseCriterion = _BaseCriterion<_RegressionCriterion>;
 
-    explicit _RegressionCriterion(const VectorXd* labelData) :
-      BaseCriterion{labelData}, _meanLeft{0.0}, _meanRight{0.0}, _meanTotal{0.0},
-      _sqSumLeft{0.0}, _sqSumRight{0.0}, _sqSumTotal{0.0}, _varLeft{0.0}, _varRight{0.0},
+    explicit _RegressionCriterion(const VectorXd* labelData,
+                                  const VectorXd* sampleWeights=nullptr) :
+      BaseCriterion{labelData, sampleWeights},
+      _sqSumLeft{0.0}, _sqSumRight{0.0}, _sqSumTotal{0.0},
       _sumLeft{0.0}, _sumRight{0.0}, _sumTotal{0.0} { }
 
-    void
+    double
     _init()
     {
       long startIndex=BaseCriterion::_startIndex;
       long endIndex=BaseCriterion::_endIndex;
 
+      _sumTotal = 0.0;
+      _sqSumTotal = 0.0;
+      double weightTotal = 0.0;
       for (long sampleId = startIndex; sampleId < endIndex; ++sampleId) {
-        long dataId = BaseCriterion::_sampleIndices->at(sampleId);
+        long dataId = (*BaseCriterion::_sampleIndices)[sampleId];
         double thisLabel =  (*BaseCriterion::_labelData)(dataId);
-        _sumTotal+=thisLabel;
-        _sqSumTotal+=thisLabel*thisLabel;
+        double weight = BaseCriterion::sampleWeight(dataId);
+        _sumTotal += weight*thisLabel;
+        _sqSumTotal += weight*thisLabel*thisLabel;
+        weightTotal += weight;
       }
-
-      _meanTotal=_sumTotal/static_cast<double>(BaseCriterion::_numberOfSamplesInThisNode);
+      return weightTotal;
     }
 
     void
     _reset()
     {
-      _meanRight = _meanTotal;
-      _meanLeft = 0.0;
       _sqSumRight = _sqSumTotal;
       _sqSumLeft = 0.0;
-      _varRight = (_sqSumRight/static_cast<double>(BaseCriterion::_numberOfSamplesInThisNode) -
-                   _meanRight * _meanRight);
-      _varLeft = 0.0;
       _sumRight = _sumTotal;
       _sumLeft = 0.0;
     }
 
-    void
+    double
     _update(const long newPos)
     {
-      for (long pos = BaseCriterion::_currentPosition; pos < newPos; ++pos){
-        long dataId = BaseCriterion::_sampleIndices->at(pos);
-        double thisLabel = (*BaseCriterion::_labelData)(dataId);
-
-        _sumLeft += thisLabel;
-        _sumRight -= thisLabel;
-        _sqSumLeft += thisLabel * thisLabel;
-        _sqSumRight -= thisLabel*thisLabel;
+      const double* sortedLabels = BaseCriterion::_sortedLabels;
+      const double* sortedWeights = BaseCriterion::_sortedWeights;
+      const long startIndex = BaseCriterion::_startIndex;
+      const long beginPos = BaseCriterion::_currentPosition-startIndex;
+      const long endPos = newPos-startIndex;
+      double sum = 0.0;
+      double sqSum = 0.0;
+      double weightSum = 0.0;
+      if (!sortedWeights) {
+        for (long pos = beginPos; pos < endPos; ++pos){
+          double thisLabel = sortedLabels[pos];
+          sum += thisLabel;
+          sqSum += thisLabel * thisLabel;
+        }
+        weightSum = static_cast<double>(endPos-beginPos);
+      }
+      else {
+        for (long pos = beginPos; pos < endPos; ++pos){
+          double thisLabel = sortedLabels[pos];
+          double weight = sortedWeights[pos];
+          sum += weight * thisLabel;
+          sqSum += weight * thisLabel * thisLabel;
+          weightSum += weight;
+        }
       }
 
-      _meanLeft = _sumLeft/static_cast<double>(BaseCriterion::_numberOfSamplesOnLeft);
-      _meanRight = _sumRight/static_cast<double>(BaseCriterion::_numberOfSamplesOnRight);
-      _varRight = (_sqSumRight/static_cast<double>(BaseCriterion::_numberOfSamplesInThisNode) -
-                   _meanRight * _meanRight);
-      _varLeft = (_sqSumLeft/static_cast<double>(BaseCriterion::_numberOfSamplesOnLeft) -
-                  _meanLeft * _meanLeft);
-      _varRight = (_sqSumRight/static_cast<double>(BaseCriterion::_numberOfSamplesOnRight) -
-                   _meanRight * _meanRight);
+      _sumLeft += sum;
+      _sumRight -= sum;
+      _sqSumLeft += sqSum;
+      _sqSumRight -= sqSum;
+
+      return weightSum;
+    }
+
+    void
+    _resetBins(const long numberOfBins)
+    {
+      _binSum.assign(numberOfBins, 0.0);
+      _binSqSum.assign(numberOfBins, 0.0);
+    }
+
+    void
+    _accumulateBin(const long binIndex, const long dataId, const double weight)
+    {
+      double thisLabel = (*BaseCriterion::_labelData)(dataId);
+      _binSum[binIndex] += weight * thisLabel;
+      _binSqSum[binIndex] += weight * thisLabel * thisLabel;
+    }
+
+    void
+    _updateByBin(const long binIndex)
+    {
+      _sumLeft += _binSum[binIndex];
+      _sumRight -= _binSum[binIndex];
+      _sqSumLeft += _binSqSum[binIndex];
+      _sqSumRight -= _binSqSum[binIndex];
     }
 
     double
     calculateNodeImpurity() const
     {
-      double total = (_sqSumTotal/static_cast<double>(BaseCriterion::_numberOfSamplesInThisNode) -
-                      _meanTotal*_meanTotal);
-      return total;
+      return _variance(_sumTotal, _sqSumTotal, BaseCriterion::_weightedNumberOfSamplesInThisNode);
     }
 
     void
     calculateChildrenImpurity(double* impurityLeft, double* impurityRight) const
     {
-      *impurityLeft = _varLeft;
-      *impurityRight = _varRight;
+      *impurityLeft =
+        _variance(_sumLeft, _sqSumLeft, BaseCriterion::_weightedNumberOfSamplesOnLeft);
+      *impurityRight =
+        _variance(_sumRight, _sqSumRight, BaseCriterion::_weightedNumberOfSamplesOnRight);
     }
 
     double
     nodeValue() const
     {
-      return _meanTotal;
+      return _sumTotal/BaseCriterion::_weightedNumberOfSamplesInThisNode;
     }
 
   private:
-    double _meanLeft;
-    double _meanRight;
-    double _meanTotal;
+    static double
+    _variance(const double sum, const double sqSum, const double weight)
+    {
+      double mean = sum/weight;
+      return sqSum/weight - mean*mean;
+    }
+
     double _sqSumLeft;
     double _sqSumRight;
     double _sqSumTotal;
-    double _varLeft;
-    double _varRight;
     double _sumLeft;
     double _sumRight;
     double _sumTotal;
+    vector<double> _binSum;
+    vector<double> _binSqSum;
   };
 }
 #endif //_REGRESSION_CRITERION
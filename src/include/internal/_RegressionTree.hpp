@@ -15,6 +15,11 @@ namespace Lib15x
       _leafNodeToLabel.clear();
     }
 
+    void _reserve(const long numberOfNodes)
+    {
+      _leafNodeToLabel.reserve((numberOfNodes+1)/2);
+    }
+
     void
     addLeaf(const long nodeIndex, const double label)
     {
@@ -22,25 +27,42 @@ namespace Lib15x
       _nodes[nodeIndex]._isLeaf = true;
     }
 
+    void
+    _finalizeLeaves(const vector<long>& flatIndexOfNode)
+    {
+      for (const auto& leaf : _leafNodeToLabel)
+        _flatThresholds[flatIndexOfNode[leaf.first]] = leaf.second;
+      vector<std::pair<long, double> >().swap(_leafNodeToLabel);
+    }
+
+    // the leaf values share the thresholds array
+    long
+    _numberOfLeafBytes() const
+    {
+      return 0;
+    }
+
+    double
+    leafValue(const long leafIndex) const
+    {
+      return _flatThresholds[leafIndex];
+    }
+
     double
     predictOne(const VectorXd& instance) const
     {
       assert(instance.size()==_numberOfFeatures);
-      long leafIndex=_headNodeIndex;
-      while (!_nodes[leafIndex]._isLeaf){
-        long splitFeatIndex=_nodes[leafIndex]._featureIndex;
-        leafIndex = instance(splitFeatIndex) < _nodes[leafIndex]._threshold ?
-          _nodes[leafIndex]._leftChildIndex : _nodes[leafIndex]._rightChildIndex;
-      }
-
-      auto it = std::find_if(std::begin(_leafNodeToLabel), std::end(_leafNodeToLabel),
-                             [&leafIndex](auto i){return i.first==leafIndex;});
-      if (it==std::end(_leafNodeToLabel)){
-        throwException("Error happened in internal tree predicting method: "
-                       "cannot find the predicted data for leafIndex %ld\n.",
-                       leafIndex);
-      }
-      return it->second;
+      return leafValue(leafIndexOf(instance.data()));
+    }
+
+    // e.g. shrinks a boosting step by the learning rate
+    void
+    scaleLeafValues(const double factor)
+    {
+      assert(_isFinalized);
+      for (long nodeIndex = 0; nodeIndex < static_cast<long>(_flatFeatureIndices.size());
+           ++nodeIndex)
+        if (_flatFeatureIndices[nodeIndex] < 0) _flatThresholds[nodeIndex] *= factor;
     }
 
   public:
@@ -3,23 +3,51 @@
 #include "../core/Definitions.hpp"
 #include "../core/Utilities.hpp"
 #include "./_TreeUtilities.hpp"
+#include "./_BinnedDataset.hpp"
+#include "./_FeatureStore.hpp"
+#include "./_Parallel.hpp"
 
 namespace Lib15x
 {
-  template<class _Criterion>
-  class _BestSplitter {
+  template<class DerivedSplitter, class _Criterion>
+  class _BaseSplitter {
   public:
-    _BestSplitter(const MatrixXd* trainData, _Criterion* criterion,
+    struct _Scratch {
+      vector<double> _dataBuffer;
+      vector<double> _labelBuffer;
+      vector<double> _weightBuffer;
+      vector<long> _indexBuffer;
+      Utilities::KeyValueSortBuffer<long> _sortBuffer;
+      Utilities::KeyValueSortBuffer<double> _labelSortBuffer;
+    };
+
+    _BaseSplitter(const _FeatureStore* featureStore, _Criterion* criterion,
                   const long minSamplesInALeaf, const long numberOfFeaturesToSplit,
-                  vector<long>* sampleIndices) :
-      _trainData{trainData},
+                  vector<long>* sampleIndices, const long numberOfThreads) :
+      _featureStore{featureStore},
       _criterion{criterion}, _minSamplesInALeaf{minSamplesInALeaf},
       _numberOfFeaturesToSplit{numberOfFeaturesToSplit},
-      _numberOfFeatures{_trainData->cols()},
+      _numberOfFeatures{_featureStore->cols()},
       _sampleIndices{sampleIndices}, _featureIndices(_numberOfFeatures),
-      _startIndex{-1}, _endIndex{-1}
+      _startIndex{-1}, _endIndex{-1}, _numberOfThreads{std::max(numberOfThreads, 1L)},
+      _scratches(_numberOfThreads)
     {
       std::iota(std::begin(_featureIndices), std::end(_featureIndices),0);
+      if (_numberOfThreads > 1)
+        _threadCriteria.assign(_numberOfThreads, *_criterion);
+    }
+
+    void
+    resetData(const _FeatureStore* featureStore, vector<long>* sampleIndices)
+    {
+      _featureStore = featureStore;
+      _sampleIndices = sampleIndices;
+      _numberOfFeatures = _featureStore->cols();
+      _featureIndices.resize(_numberOfFeatures);
+      std::iota(std::begin(_featureIndices), std::end(_featureIndices),0);
+      _startIndex = -1;
+      _endIndex = -1;
+      static_cast<DerivedSplitter*>(this)->_resetData();
     }
 
     void
@@ -33,101 +61,186 @@ namespace Lib15x
     _SplitRecord
     splitNode(const double impurity,  long* numberOfConstantFeatures)
     {
-      _SplitRecord bestSplit, currentSplit;
+      _SplitRecord bestSplit;
       bestSplit._splitSampleIndex=_endIndex;
-      long featIdI = _numberOfFeatures;
       long totalNumberOfConstantFeatures = *numberOfConstantFeatures;
-      long numberOfSamplesInThisNode = _endIndex-_startIndex;
+      const long numberOfSamplesInThisNode = _endIndex-_startIndex;
+
+      if (_numberOfThreads > 1 &&
+          numberOfSamplesInThisNode*(_numberOfFeatures-totalNumberOfConstantFeatures) >=
+          _minWorkInAParallelSplit)
+        _parallelSplitNode(impurity, &totalNumberOfConstantFeatures, &bestSplit);
+      else
+        _serialSplitNode(impurity, &totalNumberOfConstantFeatures, &bestSplit);
+
+      if (bestSplit._splitSampleIndex < _endIndex)
+        static_cast<DerivedSplitter*>(this)->_partitionSamples(bestSplit);
+
+      *numberOfConstantFeatures = totalNumberOfConstantFeatures;
+      return bestSplit;
+    }
+
+    double
+    calculateNodeImpurity() {
+      return _criterion->calculateNodeImpurity();
+    }
+
+    void
+    setRandomEngine(std::mt19937* randomEngine)
+    {
+      _randomEngine = randomEngine;
+    }
+
+  protected:
+    void
+    _serialSplitNode(const double impurity, long* totalNumberOfConstantFeatures,
+                     _SplitRecord* bestSplit)
+    {
+      long featIdI = _numberOfFeatures;
       long numberOfVisitedFeatures = 0;
 
-      while (featIdI > totalNumberOfConstantFeatures &&
+      while (featIdI > *totalNumberOfConstantFeatures &&
              numberOfVisitedFeatures < _numberOfFeaturesToSplit) {
         ++numberOfVisitedFeatures;
-        long featIdJ =
-          rand() % (featIdI-totalNumberOfConstantFeatures) + totalNumberOfConstantFeatures;
-
-        currentSplit._featureIndexToSplit = _featureIndices[featIdJ];
+        long featIdJ = _randomIndex(_randomEngine, featIdI-*totalNumberOfConstantFeatures) +
+          *totalNumberOfConstantFeatures;
 
-        vector<double> dataBuffer(numberOfSamplesInThisNode);
+        _SplitRecord featureSplit;
+        bool isConstant = static_cast<DerivedSplitter*>(this)->
+          _findBestSplitOfFeature(_featureIndices[featIdJ], impurity, _criterion,
+                                  &_scratches[0], &featureSplit);
 
-        for (long sampleId = 0; sampleId < numberOfSamplesInThisNode; ++sampleId) {
-          long dataIndex = (*_sampleIndices)[sampleId+_startIndex];
-          dataBuffer[sampleId] = (*_trainData)(dataIndex, currentSplit._featureIndexToSplit);
+        if (isConstant) {
+          _moveToConstantFeatures(featIdJ, totalNumberOfConstantFeatures);
+          continue;
         }
 
-        Utilities::sortTwoArray(std::begin(dataBuffer), std::end(dataBuffer),
-                                std::begin(*_sampleIndices)+_startIndex);
+        --featIdI;
+        std::swap(_featureIndices[featIdI], _featureIndices[featIdJ]);
+
+        if (featureSplit._impurityImprovement > bestSplit->_impurityImprovement)
+          *bestSplit = featureSplit;
+      }
+    }
+
+    void
+    _parallelSplitNode(const double impurity, long* totalNumberOfConstantFeatures,
+                       _SplitRecord* bestSplit)
+    {
+      const long numberOfCandidateFeatures = _numberOfFeatures-*totalNumberOfConstantFeatures;
+      vector<char>& isConstant = _constantFeatureFlags;
+      isConstant.assign(_numberOfFeatures, 0);
+      _parallelFor(_numberOfThreads, numberOfCandidateFeatures,
+                   [this, &isConstant, totalNumberOfConstantFeatures]
+                   (const long taskId, const long threadId) {
+                     long featureIndex = _featureIndices[*totalNumberOfConstantFeatures+taskId];
+                     isConstant[featureIndex] = static_cast<DerivedSplitter*>(this)->
+                       _isConstantFeature(featureIndex, &_scratches[threadId]);
+                   });
+
+      vector<long>& visitedFeatures = _visitedFeatures;
+      visitedFeatures.clear();
+      long featIdI = _numberOfFeatures;
+      long numberOfVisitedFeatures = 0;
+      while (featIdI > *totalNumberOfConstantFeatures &&
+             numberOfVisitedFeatures < _numberOfFeaturesToSplit) {
+        ++numberOfVisitedFeatures;
+        long featIdJ = _randomIndex(_randomEngine, featIdI-*totalNumberOfConstantFeatures) +
+          *totalNumberOfConstantFeatures;
 
-        if (dataBuffer[numberOfSamplesInThisNode - 1] <= dataBuffer[0] + _featureThreshold) {
-          _featureIndices[featIdJ] = _featureIndices[totalNumberOfConstantFeatures];
-          _featureIndices[totalNumberOfConstantFeatures] = currentSplit._featureIndexToSplit;
-          ++totalNumberOfConstantFeatures;
+        if (isConstant[_featureIndices[featIdJ]]) {
+          _moveToConstantFeatures(featIdJ, totalNumberOfConstantFeatures);
           continue;
         }
 
         --featIdI;
         std::swap(_featureIndices[featIdI], _featureIndices[featIdJ]);
+        visitedFeatures.push_back(_featureIndices[featIdI]);
+      }
 
-        _criterion->reset();
-        for (long sampleId=_startIndex; sampleId<_endIndex;) {
-          if (sampleId+1<_endIndex)
-            while (dataBuffer[sampleId + 1-_startIndex] <=
-                   dataBuffer[sampleId-_startIndex] + _featureThreshold) {
-              ++sampleId;
-              if (sampleId==_endIndex-1) break;
-            }
-          ++sampleId;
-          if (sampleId >= _endIndex) break;
+      for (auto& threadCriterion : _threadCriteria)
+        threadCriterion = *_criterion;
+
+      vector<_SplitRecord>& featureSplits = _visitedFeatureSplits;
+      featureSplits.assign(visitedFeatures.size(), _SplitRecord());
+      _parallelFor(_numberOfThreads, static_cast<long>(visitedFeatures.size()),
+                   [this, impurity, &visitedFeatures, &featureSplits]
+                   (const long taskId, const long threadId) {
+                     static_cast<DerivedSplitter*>(this)->
+                       _findBestSplitOfFeature(visitedFeatures[taskId], impurity,
+                                               &_threadCriteria[threadId],
+                                               &_scratches[threadId], &featureSplits[taskId]);
+                   });
+
+      for (const auto& featureSplit : featureSplits)
+        if (featureSplit._impurityImprovement > bestSplit->_impurityImprovement)
+          *bestSplit = featureSplit;
+    }
 
-          currentSplit._splitSampleIndex = sampleId;
+    void
+    _moveToConstantFeatures(const long featId, long* totalNumberOfConstantFeatures)
+    {
+      long featureIndex = _featureIndices[featId];
+      _featureIndices[featId] = _featureIndices[*totalNumberOfConstantFeatures];
+      _featureIndices[*totalNumberOfConstantFeatures] = featureIndex;
+      ++*totalNumberOfConstantFeatures;
+    }
 
-          if (((currentSplit._splitSampleIndex - _startIndex) < _minSamplesInALeaf) ||
-              ((_endIndex - currentSplit._splitSampleIndex) < _minSamplesInALeaf))
-            continue;
+    void
+    _findBestSplitInSortedData(const long featureIndex, const double impurity,
+                               _Criterion* criterion, const double* sortedData,
+                               _SplitRecord* featureSplit) const
+    {
+      _SplitRecord currentSplit;
+      currentSplit._featureIndexToSplit = featureIndex;
 
-          _criterion->update(currentSplit._splitSampleIndex);
-          double left = 0;
-          double right = 0;
+      for (long sampleId=_startIndex; sampleId<_endIndex;) {
+        if (sampleId+1<_endIndex)
+          while (sortedData[sampleId + 1-_startIndex] <=
+                 sortedData[sampleId-_startIndex] + _featureThreshold) {
+            ++sampleId;
+            if (sampleId==_endIndex-1) break;
+          }
+        ++sampleId;
+        if (sampleId >= _endIndex) break;
 
-          _criterion->calculateChildrenImpurity(&left, &right);
-          currentSplit._impurityImprovement = _criterion->impurityImprove(impurity);
+        currentSplit._splitSampleIndex = sampleId;
 
-          if (currentSplit._impurityImprovement > bestSplit._impurityImprovement) {
-            _criterion->calculateChildrenImpurity(&currentSplit._impurityLeft,
-                                                  &currentSplit._impurityRight);
-            currentSplit._threshold = (dataBuffer[sampleId - 1-_startIndex] +
-                                       dataBuffer[sampleId-_startIndex]) / 2.0;
-            bestSplit = currentSplit;
-          }
-        }
-      }
+        if (((currentSplit._splitSampleIndex - _startIndex) < _minSamplesInALeaf) ||
+            ((_endIndex - currentSplit._splitSampleIndex) < _minSamplesInALeaf))
+          continue;
 
-      if (bestSplit._splitSampleIndex < _endIndex) {
-        long partitionEnd = _endIndex;
-        long sampleId = _startIndex;
-        long featId = bestSplit._featureIndexToSplit;
-        while (sampleId < partitionEnd){
-          long dataId = (*_sampleIndices)[sampleId];
-          if ((*_trainData)(dataId, featId) <= bestSplit._threshold) {
-            ++sampleId;
-            continue;
-          }
-          --partitionEnd;
-          std::swap((*_sampleIndices)[partitionEnd], (*_sampleIndices)[sampleId]);
+        criterion->update(currentSplit._splitSampleIndex);
+        currentSplit._impurityImprovement = criterion->impurityImprove(impurity);
+
+        if (currentSplit._impurityImprovement > featureSplit->_impurityImprovement) {
+          criterion->calculateChildrenImpurity(&currentSplit._impurityLeft,
+                                               &currentSplit._impurityRight);
+          currentSplit._threshold = (sortedData[sampleId - 1-_startIndex] +
+                                     sortedData[sampleId-_startIndex]) / 2.0;
+          *featureSplit = currentSplit;
         }
       }
-
-      *numberOfConstantFeatures = totalNumberOfConstantFeatures;
-      return bestSplit;
     }
 
-    double
-    calculateNodeImpurity() {
-      return _criterion->calculateNodeImpurity();
+    void
+    _partitionByThreshold(const _SplitRecord& bestSplit)
+    {
+      long partitionEnd = _endIndex;
+      long sampleId = _startIndex;
+      const double* featureColumn = _featureStore->column(bestSplit._featureIndexToSplit);
+      while (sampleId < partitionEnd){
+        long dataId = (*_sampleIndices)[sampleId];
+        if (featureColumn[dataId] < bestSplit._threshold) {
+          ++sampleId;
+          continue;
+        }
+        --partitionEnd;
+        std::swap((*_sampleIndices)[partitionEnd], (*_sampleIndices)[sampleId]);
+      }
     }
 
-  private:
-    const MatrixXd* _trainData;
+    const _FeatureStore* _featureStore;
     _Criterion* _criterion;
     long _minSamplesInALeaf;
     long _numberOfFeaturesToSplit;
@@ -136,138 +249,559 @@ namespace Lib15x
     vector<long> _featureIndices;
     long _startIndex;
     long _endIndex;
+    long _numberOfThreads;
+    vector<_Scratch> _scratches;
+    vector<_Criterion> _threadCriteria;
+    vector<char> _constantFeatureFlags;
+    vector<long> _visitedFeatures;
+    vector<_SplitRecord> _visitedFeatureSplits;
     double _featureThreshold=1e-7;
+    long _minWorkInAParallelSplit=50000;
+    std::mt19937* _randomEngine=nullptr;
   };
 
   template<class _Criterion>
-  class _PresortBestSplitter {
+  class _BestSplitter : public _BaseSplitter<_BestSplitter<_Criterion>, _Criterion> {
   public:
-    _PresortBestSplitter(const MatrixXd* trainData, _Criterion* criterion,
-                         const long minSamplesInALeaf, const long numberOfFeaturesToSplit,
-                         vector<long>* sampleIndices) :
-      _trainData{trainData}, _criterion{criterion}, _minSamplesInALeaf{minSamplesInALeaf},
-      _numberOfFeaturesToSplit{numberOfFeaturesToSplit},
-      _numberOfFeatures{_trainData->cols()}, _sampleIndices{sampleIndices},
-      _featureIndices(_numberOfFeatures), _startIndex{-1}, _endIndex{-1}
+    using BaseSplitter = _BaseSplitter<_BestSplitter<_Criterion>, _Criterion>;
+    using Scratch = typename BaseSplitter::_Scratch;
+
+    _BestSplitter(const _FeatureStore* featureStore, _Criterion* criterion,
+                  const long minSamplesInALeaf, const long numberOfFeaturesToSplit,
+                  vector<long>* sampleIndices, const long numberOfThreads=1) :
+      BaseSplitter{featureStore, criterion, minSamplesInALeaf, numberOfFeaturesToSplit,
+        sampleIndices, numberOfThreads}
     {
-      std::iota(std::begin(_featureIndices), std::end(_featureIndices),0);
+      _resetData();
     }
 
-    void
-    resetToThisNode(long startIndex, long endIndex)
+    _BestSplitter(const _BestSplitter& splitter, _Criterion* criterion) :
+      _BestSplitter{splitter}
     {
-      _startIndex = startIndex;
-      _endIndex = endIndex;
-      _criterion->init(_sampleIndices, _startIndex, _endIndex);
+      BaseSplitter::_criterion = criterion;
     }
 
-    _SplitRecord
-    splitNode(const double impurity,  long* numberOfConstantFeatures)
+    void
+    _resetData()
     {
-      _SplitRecord bestSplit, currentSplit;
-      bestSplit._splitSampleIndex=_endIndex;
-      long featIdI = _numberOfFeatures;
-      long totalNumberOfConstantFeatures = *numberOfConstantFeatures;
-      long numberOfSamplesInThisNode = _endIndex-_startIndex;
-      long numberOfVisitedFeatures = 0;
+      const long numberOfSamples = BaseSplitter::_sampleIndices->size();
+      const bool weighted = BaseSplitter::_criterion->isWeighted();
+      for (auto& scratch : BaseSplitter::_scratches) {
+        scratch._dataBuffer.resize(numberOfSamples);
+        scratch._labelBuffer.resize(numberOfSamples);
+        if (weighted) {
+          scratch._weightBuffer.resize(numberOfSamples);
+          scratch._indexBuffer.resize(numberOfSamples);
+        }
+      }
+    }
 
-      while (featIdI > totalNumberOfConstantFeatures &&
-             numberOfVisitedFeatures < _numberOfFeaturesToSplit) {
-        ++numberOfVisitedFeatures;
-        long featIdJ =
-          rand() % (featIdI-totalNumberOfConstantFeatures) + totalNumberOfConstantFeatures;
+    bool
+    _isConstantFeature(const long featureIndex, Scratch* scratch) const
+    {
+      ignoreUnusedVariable(scratch);
+      const double* featureColumn = BaseSplitter::_featureStore->column(featureIndex);
+      double minValue = std::numeric_limits<double>::max();
+      double maxValue = -std::numeric_limits<double>::max();
+      for (long sampleId = BaseSplitter::_startIndex; sampleId < BaseSplitter::_endIndex;
+           ++sampleId) {
+        double value = featureColumn[(*BaseSplitter::_sampleIndices)[sampleId]];
+        minValue = std::min(minValue, value);
+        maxValue = std::max(maxValue, value);
+      }
+      return maxValue <= minValue + BaseSplitter::_featureThreshold;
+    }
 
-        currentSplit._featureIndexToSplit = _featureIndices[featIdJ];
+    bool
+    _findBestSplitOfFeature(const long featureIndex, const double impurity,
+                            _Criterion* criterion, Scratch* scratch,
+                            _SplitRecord* featureSplit) const
+    {
+      const long startIndex = BaseSplitter::_startIndex;
+      const long endIndex = BaseSplitter::_endIndex;
+      const long numberOfSamplesInThisNode = endIndex-startIndex;
+      const double* featureColumn = BaseSplitter::_featureStore->column(featureIndex);
+      const VectorXd& labelData = *criterion->labelData();
+      double* dataBuffer = scratch->_dataBuffer.data();
+      double* labelBuffer = scratch->_labelBuffer.data();
+      double* weightBuffer = nullptr;
+
+      if (!criterion->isWeighted()) {
+        for (long sampleId = 0; sampleId < numberOfSamplesInThisNode; ++sampleId) {
+          long dataIndex = (*BaseSplitter::_sampleIndices)[sampleId+startIndex];
+          dataBuffer[sampleId] = featureColumn[dataIndex];
+          labelBuffer[sampleId] = labelData(dataIndex);
+        }
 
-        vector<double> dataBuffer(numberOfSamplesInThisNode);
+        Utilities::sortKeyValue(dataBuffer, labelBuffer, numberOfSamplesInThisNode,
+                                &scratch->_labelSortBuffer);
+      }
+      else {
+        long* indexBuffer = scratch->_indexBuffer.data();
+        weightBuffer = scratch->_weightBuffer.data();
+        for (long sampleId = 0; sampleId < numberOfSamplesInThisNode; ++sampleId) {
+          long dataIndex = (*BaseSplitter::_sampleIndices)[sampleId+startIndex];
+          dataBuffer[sampleId] = featureColumn[dataIndex];
+          indexBuffer[sampleId] = dataIndex;
+        }
 
+        Utilities::sortKeyValue(dataBuffer, indexBuffer, numberOfSamplesInThisNode,
+                                &scratch->_sortBuffer);
         for (long sampleId = 0; sampleId < numberOfSamplesInThisNode; ++sampleId) {
-          long dataIndex=(*_sampleIndices)[sampleId+_startIndex];
-          dataBuffer[sampleId] = (*_trainData)(dataIndex, currentSplit._featureIndexToSplit);
+          labelBuffer[sampleId] = labelData(indexBuffer[sampleId]);
+          weightBuffer[sampleId] = criterion->sampleWeight(indexBuffer[sampleId]);
         }
+      }
 
-        Utilities::sortTwoArray(std::begin(dataBuffer), std::end(dataBuffer),
-                                std::begin(*_sampleIndices)+_startIndex);
+      if (dataBuffer[numberOfSamplesInThisNode - 1] <=
+          dataBuffer[0] + BaseSplitter::_featureThreshold)
+        return true;
 
-        if (dataBuffer[numberOfSamplesInThisNode - 1] <= dataBuffer[0] + _featureThreshold) {
-          _featureIndices[featIdJ] = _featureIndices[totalNumberOfConstantFeatures];
-          _featureIndices[totalNumberOfConstantFeatures] = currentSplit._featureIndexToSplit;
-          ++totalNumberOfConstantFeatures;
-          continue;
-        }
+      criterion->resetToSortedLabels(labelBuffer, weightBuffer);
+      BaseSplitter::_findBestSplitInSortedData(featureIndex, impurity, criterion,
+                                               dataBuffer, featureSplit);
+      return false;
+    }
 
-        --featIdI;
-        std::swap(_featureIndices[featIdI], _featureIndices[featIdJ]);
+    void
+    _partitionSamples(const _SplitRecord& bestSplit)
+    {
+      BaseSplitter::_partitionByThreshold(bestSplit);
+    }
+  };
 
-        _criterion->reset();
-        for (long sampleId=_startIndex; sampleId<_endIndex;) {
-          if (sampleId+1<_endIndex)
-            while (dataBuffer[sampleId + 1-_startIndex] <=
-                   dataBuffer[sampleId-_startIndex] + _featureThreshold) {
-              ++sampleId;
-              if (sampleId==_endIndex-1) break;
-            }
-          ++sampleId;
-          if (sampleId >= _endIndex) break;
+  template<class _Criterion>
+  class _PresortBestSplitter :
+    public _BaseSplitter<_PresortBestSplitter<_Criterion>, _Criterion> {
+  public:
+    using BaseSplitter = _BaseSplitter<_PresortBestSplitter<_Criterion>, _Criterion>;
+    using Scratch = typename BaseSplitter::_Scratch;
+
+    struct _PresortedFeature {
+      vector<long> _indices;
+      vector<double> _values;
+      vector<double> _labels;
+      vector<double> _weights;
+    };
+
+    _PresortBestSplitter(const _FeatureStore* featureStore, _Criterion* criterion,
+                         const long minSamplesInALeaf, const long numberOfFeaturesToSplit,
+                         vector<long>* sampleIndices, const long numberOfThreads=1) :
+      BaseSplitter{featureStore, criterion, minSamplesInALeaf, numberOfFeaturesToSplit,
+        sampleIndices, numberOfThreads},
+      _presortedFeatures{std::make_shared<vector<_PresortedFeature> >()}
+    {
+      _resetData();
+    }
 
-          currentSplit._splitSampleIndex = sampleId;
+    _PresortBestSplitter(const _PresortBestSplitter& splitter, _Criterion* criterion) :
+      _PresortBestSplitter{splitter}
+    {
+      BaseSplitter::_criterion = criterion;
+    }
 
-          if (((currentSplit._splitSampleIndex - _startIndex) < _minSamplesInALeaf) ||
-              ((_endIndex - currentSplit._splitSampleIndex) < _minSamplesInALeaf))
-            continue;
+    void
+    _resetData()
+    {
+      const _FeatureStore* featureStore = BaseSplitter::_featureStore;
+      const vector<long>* sampleIndices = BaseSplitter::_sampleIndices;
+      const VectorXd& labelData = *BaseSplitter::_criterion->labelData();
+      const _Criterion* criterion = BaseSplitter::_criterion;
+      const bool weighted = criterion->isWeighted();
+      const long numberOfSamples = sampleIndices->size();
+      const long numberOfFeatures = featureStore->cols();
+      for (auto& scratch : BaseSplitter::_scratches) {
+        scratch._dataBuffer.resize(numberOfSamples);
+        scratch._labelBuffer.resize(numberOfSamples);
+        scratch._indexBuffer.resize(numberOfSamples);
+        if (weighted) scratch._weightBuffer.resize(numberOfSamples);
+      }
+      _goesLeft.assign(featureStore->rows(), 0);
+      if (!_presortedFeatures.unique())
+        _presortedFeatures = std::make_shared<vector<_PresortedFeature> >();
+      _presortedFeatures->resize(numberOfFeatures);
+
+      _parallelFor(BaseSplitter::_numberOfThreads, numberOfFeatures,
+                   [this, featureStore, sampleIndices, &labelData, criterion, weighted,
+                    numberOfSamples]
+                   (const long featId, const long threadId) {
+                     Scratch& scratch = BaseSplitter::_scratches[threadId];
+                     _PresortedFeature& presortedFeature = (*_presortedFeatures)[featId];
+                     vector<long>& sortedIndices = presortedFeature._indices;
+                     vector<double>& sortedValues = presortedFeature._values;
+                     vector<double>& sortedLabels = presortedFeature._labels;
+                     vector<double>& sortedWeights = presortedFeature._weights;
+                     const double* featureColumn = featureStore->column(featId);
+                     sortedIndices = *sampleIndices;
+                     sortedValues.resize(numberOfSamples);
+                     sortedLabels.resize(numberOfSamples);
+                     for (long sampleId = 0; sampleId < numberOfSamples; ++sampleId)
+                       sortedValues[sampleId] = featureColumn[sortedIndices[sampleId]];
+
+                     Utilities::sortKeyValue(sortedValues.data(), sortedIndices.data(),
+                                             numberOfSamples, &scratch._sortBuffer);
+                     for (long sampleId = 0; sampleId < numberOfSamples; ++sampleId)
+                       sortedLabels[sampleId] = labelData(sortedIndices[sampleId]);
+
+                     sortedWeights.resize(weighted ? numberOfSamples : 0);
+                     for (long sampleId = 0; sampleId < static_cast<long>(sortedWeights.size());
+                          ++sampleId)
+                       sortedWeights[sampleId] = criterion->sampleWeight(sortedIndices[sampleId]);
+                   });
+    }
 
-          _criterion->update(currentSplit._splitSampleIndex);
-          double left = 0;
-          double right = 0;
+    bool
+    _isConstantFeature(const long featureIndex, Scratch* scratch) const
+    {
+      ignoreUnusedVariable(scratch);
+      const vector<double>& sortedValues = (*_presortedFeatures)[featureIndex]._values;
+      return sortedValues[BaseSplitter::_endIndex-1] <=
+        sortedValues[BaseSplitter::_startIndex] + BaseSplitter::_featureThreshold;
+    }
 
-          _criterion->calculateChildrenImpurity(&left, &right);
-          currentSplit._impurityImprovement = _criterion->impurityImprove(impurity);
+    bool
+    _findBestSplitOfFeature(const long featureIndex, const double impurity,
+                            _Criterion* criterion, Scratch* scratch,
+                            _SplitRecord* featureSplit) const
+    {
+      ignoreUnusedVariable(scratch);
+      const long startIndex = BaseSplitter::_startIndex;
+      const _PresortedFeature& presortedFeature = (*_presortedFeatures)[featureIndex];
+      const double* sortedValues = presortedFeature._values.data()+startIndex;
+
+      if (sortedValues[BaseSplitter::_endIndex-1-startIndex] <=
+          sortedValues[0] + BaseSplitter::_featureThreshold)
+        return true;
+
+      criterion->resetToSortedLabels(presortedFeature._labels.data()+startIndex,
+                                     presortedFeature._weights.empty() ? nullptr :
+                                     presortedFeature._weights.data()+startIndex);
+      BaseSplitter::_findBestSplitInSortedData(featureIndex, impurity, criterion,
+                                               sortedValues, featureSplit);
+      return false;
+    }
 
-          if (currentSplit._impurityImprovement > bestSplit._impurityImprovement) {
-            _criterion->calculateChildrenImpurity(&currentSplit._impurityLeft,
-                                                  &currentSplit._impurityRight);
-            currentSplit._threshold = (dataBuffer[sampleId - 1-_startIndex] +
-                                       dataBuffer[sampleId-_startIndex]) / 2.0;
-            bestSplit = currentSplit;
+    void
+    _partitionSamples(const _SplitRecord& bestSplit)
+    {
+      const long startIndex = BaseSplitter::_startIndex;
+      const long endIndex = BaseSplitter::_endIndex;
+      vector<long>& sampleIndices = *BaseSplitter::_sampleIndices;
+      const vector<long>& bestSortedIndices =
+        (*_presortedFeatures)[bestSplit._featureIndexToSplit]._indices;
+      std::copy(std::begin(bestSortedIndices)+startIndex, std::begin(bestSortedIndices)+endIndex,
+                std::begin(sampleIndices)+startIndex);
+
+      for (long sampleId = startIndex; sampleId < bestSplit._splitSampleIndex; ++sampleId)
+        _goesLeft[sampleIndices[sampleId]] = 1;
+
+      auto partitionFeature = [this, &bestSplit, startIndex, endIndex]
+        (const long featId, const long threadId) {
+        if (featId == bestSplit._featureIndexToSplit) return;
+
+        _PresortedFeature& presortedFeature = (*_presortedFeatures)[featId];
+        long* sortedIndices = presortedFeature._indices.data();
+        double* sortedValues = presortedFeature._values.data();
+        double* sortedLabels = presortedFeature._labels.data();
+        double* sortedWeights = presortedFeature._weights.data();
+        const bool weighted = !presortedFeature._weights.empty();
+        Scratch& scratch = BaseSplitter::_scratches[threadId];
+        long* indexBuffer = scratch._indexBuffer.data();
+        double* valueBuffer = scratch._dataBuffer.data();
+        double* labelBuffer = scratch._labelBuffer.data();
+        double* weightBuffer = scratch._weightBuffer.data();
+        long leftEnd = startIndex;
+        long numberOfSamplesOnRight = 0;
+        for (long sampleId = startIndex; sampleId < endIndex; ++sampleId) {
+          long dataId = sortedIndices[sampleId];
+          if (_goesLeft[dataId]) {
+            sortedIndices[leftEnd] = dataId;
+            sortedValues[leftEnd] = sortedValues[sampleId];
+            sortedLabels[leftEnd] = sortedLabels[sampleId];
+            if (weighted) sortedWeights[leftEnd] = sortedWeights[sampleId];
+            ++leftEnd;
+          }
+          else {
+            indexBuffer[numberOfSamplesOnRight] = dataId;
+            valueBuffer[numberOfSamplesOnRight] = sortedValues[sampleId];
+            labelBuffer[numberOfSamplesOnRight] = sortedLabels[sampleId];
+            if (weighted) weightBuffer[numberOfSamplesOnRight] = sortedWeights[sampleId];
+            ++numberOfSamplesOnRight;
           }
         }
+        assert(leftEnd == bestSplit._splitSampleIndex);
+        std::copy(indexBuffer, indexBuffer+numberOfSamplesOnRight, sortedIndices+leftEnd);
+        std::copy(valueBuffer, valueBuffer+numberOfSamplesOnRight, sortedValues+leftEnd);
+        std::copy(labelBuffer, labelBuffer+numberOfSamplesOnRight, sortedLabels+leftEnd);
+        if (weighted)
+          std::copy(weightBuffer, weightBuffer+numberOfSamplesOnRight, sortedWeights+leftEnd);
+      };
+
+      if (BaseSplitter::_numberOfThreads > 1 &&
+          (endIndex-startIndex)*BaseSplitter::_numberOfFeatures >=
+          BaseSplitter::_minWorkInAParallelSplit)
+        _parallelFor(BaseSplitter::_numberOfThreads, BaseSplitter::_numberOfFeatures,
+                     partitionFeature);
+      else
+        for (long featId = 0; featId < BaseSplitter::_numberOfFeatures; ++featId)
+          partitionFeature(featId, 0);
+
+      for (long sampleId = startIndex; sampleId < bestSplit._splitSampleIndex; ++sampleId)
+        _goesLeft[sampleIndices[sampleId]] = 0;
+    }
+
+  private:
+    std::shared_ptr<vector<_PresortedFeature> > _presortedFeatures;
+    vector<char> _goesLeft;
+  };
+
+  // Extremely randomized splits: each candidate feature gets one threshold drawn uniformly
+  // between its min and max in the node, scored with the two-bin criterion pass, so a node
+  // costs a few linear scans per feature instead of a sort.
+  template<class _Criterion>
+  class _RandomSplitter : public _BaseSplitter<_RandomSplitter<_Criterion>, _Criterion> {
+  public:
+    using BaseSplitter = _BaseSplitter<_RandomSplitter<_Criterion>, _Criterion>;
+    using Scratch = typename BaseSplitter::_Scratch;
+
+    _RandomSplitter(const _FeatureStore* featureStore, _Criterion* criterion,
+                    const long minSamplesInALeaf, const long numberOfFeaturesToSplit,
+                    vector<long>* sampleIndices, const long numberOfThreads=1) :
+      BaseSplitter{featureStore, criterion, minSamplesInALeaf, numberOfFeaturesToSplit,
+        sampleIndices, numberOfThreads} { }
+
+    _RandomSplitter(const _RandomSplitter& splitter, _Criterion* criterion) :
+      _RandomSplitter{splitter}
+    {
+      BaseSplitter::_criterion = criterion;
+    }
+
+    // The threshold positions are drawn before the features are scanned, so the parallel
+    // split sees the same random numbers as the serial one.
+    _SplitRecord
+    splitNode(const double impurity, long* numberOfConstantFeatures)
+    {
+      _thresholdPositions.resize(BaseSplitter::_numberOfFeatures);
+      for (auto& position : _thresholdPositions)
+        position = _randomUnit(BaseSplitter::_randomEngine);
+      return BaseSplitter::splitNode(impurity, numberOfConstantFeatures);
+    }
+
+    void
+    _resetData() { }
+
+    bool
+    _isConstantFeature(const long featureIndex, Scratch* scratch) const
+    {
+      ignoreUnusedVariable(scratch);
+      double minValue = 0;
+      double maxValue = 0;
+      _rangeOfFeature(featureIndex, &minValue, &maxValue);
+      return maxValue <= minValue + BaseSplitter::_featureThreshold;
+    }
+
+    bool
+    _findBestSplitOfFeature(const long featureIndex, const double impurity,
+                            _Criterion* criterion, Scratch* scratch,
+                            _SplitRecord* featureSplit) const
+    {
+      ignoreUnusedVariable(scratch);
+      double minValue = 0;
+      double maxValue = 0;
+      _rangeOfFeature(featureIndex, &minValue, &maxValue);
+      if (maxValue <= minValue + BaseSplitter::_featureThreshold) return true;
+
+      // rows equal to the threshold go right as in prediction, so it has to lie above the
+      // minimum; drawn positions can round onto the data values of large features
+      double threshold = minValue + (maxValue-minValue)*_thresholdPositions[featureIndex];
+      if (!(threshold > minValue))
+        threshold = minValue + (maxValue-minValue)/2.0;
+      if (!(threshold > minValue && threshold <= maxValue))
+        threshold = maxValue;
+
+      const double* featureColumn = BaseSplitter::_featureStore->column(featureIndex);
+      criterion->resetBins(2);
+      for (long sampleId = BaseSplitter::_startIndex; sampleId < BaseSplitter::_endIndex;
+           ++sampleId) {
+        long dataId = (*BaseSplitter::_sampleIndices)[sampleId];
+        criterion->accumulateBin(featureColumn[dataId] < threshold ? 0 : 1, dataId);
       }
+      criterion->reset();
+      criterion->updateByBin(0);
+
+      if ((criterion->numberOfSamplesOnLeft() < BaseSplitter::_minSamplesInALeaf) ||
+          (criterion->numberOfSamplesOnRight() < BaseSplitter::_minSamplesInALeaf))
+        return false;
+
+      _SplitRecord currentSplit;
+      currentSplit._featureIndexToSplit = featureIndex;
+      currentSplit._impurityImprovement = criterion->impurityImprove(impurity);
+      if (currentSplit._impurityImprovement > featureSplit->_impurityImprovement) {
+        criterion->calculateChildrenImpurity(&currentSplit._impurityLeft,
+                                             &currentSplit._impurityRight);
+        currentSplit._splitSampleIndex =
+          BaseSplitter::_startIndex + criterion->numberOfSamplesOnLeft();
+        currentSplit._threshold = threshold;
+        *featureSplit = currentSplit;
+      }
+      return false;
+    }
 
-      if (bestSplit._splitSampleIndex < _endIndex) {
-        long partitionEnd = _endIndex;
-        long sampleId = _startIndex;
-        long featId = bestSplit._featureIndexToSplit;
-        while (sampleId < partitionEnd){
-          long dataId = (*_sampleIndices)[sampleId];
-          if ((*_trainData)(dataId, featId) <= bestSplit._threshold) {
-            ++sampleId;
-            continue;
-          }
-          --partitionEnd;
-          std::swap((*_sampleIndices)[partitionEnd], (*_sampleIndices)[sampleId]);
-        }
+    void
+    _partitionSamples(const _SplitRecord& bestSplit)
+    {
+      BaseSplitter::_partitionByThreshold(bestSplit);
+    }
+
+  private:
+    void
+    _rangeOfFeature(const long featureIndex, double* minValue, double* maxValue) const
+    {
+      const double* featureColumn = BaseSplitter::_featureStore->column(featureIndex);
+      *minValue = std::numeric_limits<double>::max();
+      *maxValue = -std::numeric_limits<double>::max();
+      for (long sampleId = BaseSplitter::_startIndex; sampleId < BaseSplitter::_endIndex;
+           ++sampleId) {
+        double value = featureColumn[(*BaseSplitter::_sampleIndices)[sampleId]];
+        *minValue = std::min(*minValue, value);
+        *maxValue = std::max(*maxValue, value);
       }
+    }
 
-      *numberOfConstantFeatures = totalNumberOfConstantFeatures;
-      return bestSplit;
+    vector<double> _thresholdPositions;
+  };
+
+  // Splits only at bin thresholds. NumberOfSketchCandidates > 0 takes the thresholds from
+  // quantile sketches with epsilon 1/NumberOfSketchCandidates instead of sorting the columns.
+  template<class _Criterion, typename BinType, long NumberOfSketchCandidates=0>
+  class _BasicHistogramSplitter :
+    public _BaseSplitter<_BasicHistogramSplitter<_Criterion, BinType, NumberOfSketchCandidates>,
+                         _Criterion> {
+  public:
+    using BaseSplitter =
+      _BaseSplitter<_BasicHistogramSplitter<_Criterion, BinType, NumberOfSketchCandidates>,
+                    _Criterion>;
+    using Scratch = typename BaseSplitter::_Scratch;
+    using BinnedDataset = _BinnedDataset<BinType>;
+
+    _BasicHistogramSplitter(const _FeatureStore* featureStore, _Criterion* criterion,
+                            const long minSamplesInALeaf, const long numberOfFeaturesToSplit,
+                            vector<long>* sampleIndices, const long numberOfThreads=1) :
+      BaseSplitter{featureStore, criterion, minSamplesInALeaf, numberOfFeaturesToSplit,
+        sampleIndices, numberOfThreads},
+      _binnedData{&featureStore->binnedData<BinType>(_sketchEpsilon())} { }
+
+    _BasicHistogramSplitter(const _BasicHistogramSplitter& splitter, _Criterion* criterion) :
+      _BasicHistogramSplitter{splitter}
+    {
+      BaseSplitter::_criterion = criterion;
     }
 
-    double
-    calculateNodeImpurity() {
-      return _criterion->calculateNodeImpurity();
+    void
+    _resetData()
+    {
+      _binnedData = &BaseSplitter::_featureStore->template binnedData<BinType>(_sketchEpsilon());
+    }
+
+    bool
+    _isConstantFeature(const long featureIndex, Scratch* scratch) const
+    {
+      ignoreUnusedVariable(scratch);
+      const BinType* binColumn = _binnedData->column(featureIndex);
+      const BinType firstBin = binColumn[(*BaseSplitter::_sampleIndices)[BaseSplitter::_startIndex]];
+      for (long sampleId = BaseSplitter::_startIndex; sampleId < BaseSplitter::_endIndex;
+           ++sampleId)
+        if (binColumn[(*BaseSplitter::_sampleIndices)[sampleId]] != firstBin) return false;
+      return true;
+    }
+
+    bool
+    _findBestSplitOfFeature(const long featureIndex, const double impurity,
+                            _Criterion* criterion, Scratch* scratch,
+                            _SplitRecord* featureSplit) const
+    {
+      ignoreUnusedVariable(scratch);
+      const long startIndex = BaseSplitter::_startIndex;
+      const BinType* binColumn = _binnedData->column(featureIndex);
+
+      criterion->resetBins(_binnedData->numberOfBins(featureIndex));
+      long minBin = std::numeric_limits<long>::max();
+      long maxBin = -1;
+      for (long sampleId = startIndex; sampleId < BaseSplitter::_endIndex; ++sampleId) {
+        long dataId = (*BaseSplitter::_sampleIndices)[sampleId];
+        long binIndex = binColumn[dataId];
+        criterion->accumulateBin(binIndex, dataId);
+        minBin = std::min(minBin, binIndex);
+        maxBin = std::max(maxBin, binIndex);
+      }
+
+      if (maxBin <= minBin) return true;
+
+      _SplitRecord currentSplit;
+      currentSplit._featureIndexToSplit = featureIndex;
+      criterion->reset();
+      for (long binIndex = minBin; binIndex < maxBin; ++binIndex) {
+        if (criterion->binSampleCount(binIndex) == 0) continue;
+        criterion->updateByBin(binIndex);
+
+        if ((criterion->numberOfSamplesOnLeft() < BaseSplitter::_minSamplesInALeaf) ||
+            (criterion->numberOfSamplesOnRight() < BaseSplitter::_minSamplesInALeaf))
+          continue;
+
+        currentSplit._impurityImprovement = criterion->impurityImprove(impurity);
+
+        if (currentSplit._impurityImprovement > featureSplit->_impurityImprovement) {
+          criterion->calculateChildrenImpurity(&currentSplit._impurityLeft,
+                                               &currentSplit._impurityRight);
+          currentSplit._splitSampleIndex = startIndex + criterion->numberOfSamplesOnLeft();
+          currentSplit._threshold = _binnedData->threshold(featureIndex, binIndex);
+          *featureSplit = currentSplit;
+        }
+      }
+      return false;
+    }
+
+    void
+    _partitionSamples(const _SplitRecord& bestSplit)
+    {
+      const long splitBin = _binnedData->findBin(bestSplit._featureIndexToSplit,
+                                                 bestSplit._threshold);
+      const BinType* binColumn = _binnedData->column(bestSplit._featureIndexToSplit);
+      vector<long>& sampleIndices = *BaseSplitter::_sampleIndices;
+      long partitionEnd = BaseSplitter::_endIndex;
+      long sampleId = BaseSplitter::_startIndex;
+      while (sampleId < partitionEnd){
+        long dataId = sampleIndices[sampleId];
+        if (binColumn[dataId] <= splitBin) {
+          ++sampleId;
+          continue;
+        }
+        --partitionEnd;
+        std::swap(sampleIndices[partitionEnd], sampleIndices[sampleId]);
+      }
+      assert(partitionEnd == bestSplit._splitSampleIndex);
     }
 
   private:
-    const MatrixXd* _trainData;
-    _Criterion* _criterion;
-    long _minSamplesInALeaf;
-    long _numberOfFeaturesToSplit;
-    long _numberOfFeatures;
-    vector<long>* _sampleIndices;
-    vector<long> _featureIndices;
-    long _startIndex;
-    long _endIndex;
-    double _featureThreshold=1e-7;
+    static constexpr double
+    _sketchEpsilon()
+    {
+      return NumberOfSketchCandidates > 0 ? 1.0/NumberOfSketchCandidates : 0.0;
+    }
+
+    const BinnedDataset* _binnedData;
   };
+
+  template<class _Criterion>
+  using _HistogramSplitter = _BasicHistogramSplitter<_Criterion, uint8_t>;
+
+  template<class _Criterion>
+  using _WideHistogramSplitter = _BasicHistogramSplitter<_Criterion, uint16_t>;
+
+  template<class _Criterion>
+  using _SketchSplitter = _BasicHistogramSplitter<_Criterion, uint8_t, 255>;
+
+  template<class _Criterion>
+  using _WideSketchSplitter = _BasicHistogramSplitter<_Criterion, uint16_t, 4095>;
 }
 #endif //_SPLITTER
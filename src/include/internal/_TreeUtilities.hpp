@@ -1,6 +1,7 @@
 #ifndef _TREE_UTILITIES
 #define _TREE_UTILITIES
 #include "../core/Definitions.hpp"
+#include <random>
 
 namespace Lib15x
 {
@@ -57,6 +58,20 @@ namespace Lib15x
       _impurityRight(std::numeric_limits<double>::max()) { }
   };
 
+  // The random draws of training come from randomEngine when the tree has a stream of its own,
+  // e.g. in a parallel forest, and from rand() otherwise.
+  inline long
+  _randomIndex(std::mt19937* randomEngine, const long numberOfIndices)
+  {
+    if (!randomEngine) return rand() % numberOfIndices;
+    return static_cast<long>((*randomEngine)() % static_cast<unsigned long>(numberOfIndices));
+  }
 
+  inline double
+  _randomUnit(std::mt19937* randomEngine)
+  {
+    if (!randomEngine) return rand()/(RAND_MAX+1.0);
+    return static_cast<double>((*randomEngine)())/(std::mt19937::max()+1.0);
+  }
 }
 #endif // _TREE_UTILITIES
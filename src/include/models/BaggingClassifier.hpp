@@ -5,6 +5,8 @@
 #include "../core/Utilities.hpp"
 #include "./TreeClassifier.hpp"
 #include "../internal/_BaseClassifier.hpp"
+#include "../internal/_EnsemblePrediction.hpp"
+#include "../internal/_EnsemblePruning.hpp"
 
 namespace Lib15x
 {
@@ -63,15 +65,22 @@ namespace Lib15x
           }
         }
 
+        _earlyExitRule.reset(vector<double>(_models.size(), 1.0));
         BaseClassifier::_modelTrained=true;
       }
 
       double predictOne(const VectorXd& instance) const
       {
-        vector<long> predictedLabelsCount(BaseClassifier::_numberOfClasses, 0);
-        for (const auto& model : _models) {
-          double predictedLabel = model.predictOne(instance);
+        const long numberOfClasses = BaseClassifier::_numberOfClasses;
+        vector<double> predictedLabelsCount(numberOfClasses, 0.0);
+        const long numberOfModels = _models.size();
+        for (long modelId = 0; modelId < numberOfModels; ++modelId) {
+          double predictedLabel = _models[modelId].predictOne(instance);
           ++predictedLabelsCount[static_cast<long>(predictedLabel)];
+          if (_earlyExit &&
+              _earlyExitRule.isSettled(predictedLabelsCount.data(), numberOfClasses, modelId+1,
+                                       _earlyExitRisk, static_cast<double>(modelId+1)))
+            break;
         }
 
         auto maxLabelPos=std::max_element(std::begin(predictedLabelsCount),
@@ -86,8 +95,135 @@ namespace Lib15x
           model.clear();
       }
 
+      // Stops asking the base models once the remaining votes cannot change the label, which
+      // gives the same labels as asking all of them.
+      bool&
+      setEarlyExit()
+      {
+        return _earlyExit;
+      }
+
+      // With early exit, also stops once the remaining votes change the label with a probability
+      // below about this risk; 0 stops only when the label is sure.
+      double&
+      setEarlyExitRisk()
+      {
+        return _earlyExitRisk;
+      }
+
+      // Puts the base models that agree most often with the ensemble on data first, so early
+      // exit settles sooner. Labels without early exit do not change.
+      void
+      orderModelsByAgreement(const MatrixXd& data)
+      {
+        assert(BaseClassifier::_modelTrained);
+        const long numberOfModels = _models.size();
+        MatrixXd modelLabels(data.rows(), numberOfModels);
+        for (long modelId = 0; modelId < numberOfModels; ++modelId)
+          modelLabels.col(modelId) = _models[modelId].predict(data)._labelData;
+
+        vector<long> agreements(numberOfModels, 0);
+        vector<long> labelsCount(BaseClassifier::_numberOfClasses);
+        for (long dataId = 0; dataId < data.rows(); ++dataId) {
+          std::fill(std::begin(labelsCount), std::end(labelsCount), 0);
+          for (long modelId = 0; modelId < numberOfModels; ++modelId)
+            ++labelsCount[static_cast<long>(modelLabels(dataId, modelId))];
+          const double label = static_cast<double>(
+            std::max_element(std::begin(labelsCount), std::end(labelsCount)) -
+            std::begin(labelsCount));
+          for (long modelId = 0; modelId < numberOfModels; ++modelId)
+            agreements[modelId] += modelLabels(dataId, modelId) == label;
+        }
+
+        vector<long> modelOrder(numberOfModels);
+        std::iota(std::begin(modelOrder), std::end(modelOrder), 0);
+        std::stable_sort(std::begin(modelOrder), std::end(modelOrder),
+                         [&agreements](const long modelA, const long modelB) {
+                           return agreements[modelA] > agreements[modelB];
+                         });
+        vector<BaseModel> orderedModels;
+        orderedModels.reserve(numberOfModels);
+        for (const long modelId : modelOrder)
+          orderedModels.push_back(std::move(_models[modelId]));
+        _models.swap(orderedModels);
+      }
+
+      // Keeps the base models that greedy forward selection on held-out data picks, in the order
+      // picked, up to the step with the lowest loss. The base models have no known size, so
+      // only the number of them can be budgeted and the steps report no nodes or bytes.
+      vector<PruningStep>
+      prune(const MatrixXd& validationData, const Labels& validationLabels,
+            const PruningBudget& budget)
+      {
+        assert(BaseClassifier::_modelTrained);
+        const VectorXd& labelData = validationLabels._labelData;
+        if (validationLabels._labelType != ProblemType::Classification ||
+            validationData.cols() != BaseClassifier::_numberOfFeatures ||
+            validationData.rows() != labelData.size()) {
+          throwException("Error happen when pruning %s: "
+                         "expecting Classification labels for (%ld) features, "
+                         "provided (%ld) rows of (%ld) features and (%ld) labels.\n",
+                         ModelName, BaseClassifier::_numberOfFeatures, validationData.rows(),
+                         validationData.cols(), labelData.size());
+        }
+        if (budget._maxNumberOfNodes >= 0 || budget._maxNumberOfBytes >= 0) {
+          throwException("Error happen when pruning %s: "
+                         "only the number of base models can be budgeted", ModelName);
+        }
+
+        const long numberOfClasses = BaseClassifier::_numberOfClasses;
+        const long numberOfModels = _models.size();
+        const long numberOfRows = validationData.rows();
+        vector<vector<long> > modelLabels(numberOfModels, vector<long>(numberOfRows));
+        for (long modelId = 0; modelId < numberOfModels; ++modelId) {
+          const VectorXd predictedLabelData = _models[modelId].predict(validationData)._labelData;
+          for (long rowId = 0; rowId < numberOfRows; ++rowId)
+            modelLabels[modelId][rowId] = static_cast<long>(predictedLabelData(rowId));
+        }
+        vector<long> labelsCount(numberOfRows*numberOfClasses, 0);
+        vector<long> rowLabelsCount(numberOfClasses);
+        auto lossWith = [&](const long modelId) {
+          double loss = 0.0;
+          for (long rowId = 0; rowId < numberOfRows; ++rowId) {
+            if (labelData(rowId) < 0) continue;
+            std::copy(&labelsCount[rowId*numberOfClasses],
+                      &labelsCount[rowId*numberOfClasses]+numberOfClasses,
+                      std::begin(rowLabelsCount));
+            ++rowLabelsCount[modelLabels[modelId][rowId]];
+            const long label = std::max_element(std::begin(rowLabelsCount),
+                                                std::end(rowLabelsCount)) -
+              std::begin(rowLabelsCount);
+            loss += static_cast<double>(static_cast<double>(label) != labelData(rowId));
+          }
+          return loss;
+        };
+        auto add = [&](const long modelId) {
+          for (long rowId = 0; rowId < numberOfRows; ++rowId)
+            ++labelsCount[rowId*numberOfClasses+modelLabels[modelId][rowId]];
+        };
+        const vector<PruningStep> steps =
+          _selectTreesGreedily(vector<_TreeCost>(numberOfModels, _TreeCost{0, 0, 0.0}), budget,
+                               lossWith, add);
+
+        const long numberOfKeptModels = _bestNumberOfSteps(steps);
+        if (numberOfKeptModels == 0) {
+          throwException("Error happen when pruning %s: no base model fits the budget",
+                         ModelName);
+        }
+        vector<BaseModel> keptModels;
+        keptModels.reserve(numberOfKeptModels);
+        for (long stepId = 0; stepId < numberOfKeptModels; ++stepId)
+          keptModels.push_back(std::move(_models[steps[stepId]._treeId]));
+        _models.swap(keptModels);
+        _earlyExitRule.reset(vector<double>(_models.size(), 1.0));
+        return steps;
+      }
+
     private:
       vector<BaseModel> _models;
+      bool _earlyExit = false;
+      double _earlyExitRisk = 0.0;
+      _EarlyExitRule _earlyExitRule;
     };
   }
 }
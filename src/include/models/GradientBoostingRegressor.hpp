@@ -7,6 +7,10 @@
 #include "../internal/_BaseRegressor.hpp"
 #include "../internal/_RegressionTree.hpp"
 #include "../internal/_RegressionCriterion.hpp"
+#include "../internal/_EnsemblePrediction.hpp"
+#include "../internal/_EnsemblePruning.hpp"
+#include "../internal/_QuickScorer.hpp"
+#include "../internal/_CodeGenerator.hpp"
 
 namespace Lib15x
 {
@@ -59,17 +63,24 @@ namespace Lib15x
         const VectorXd& labelData = trainLabels._labelData;
         assert(weights.size()==trainLabels.size());
 
-        Criterion criterion{&labelData};
+        VectorXd residuals(labelData.size());
+        Criterion criterion{&residuals, _criterionWeightsOf(weights)};
 
-        _RegressionCriterion _criterion(&labelData);
-
-        if (_maxNumberOfLeafNodes < 0) {
+        if (_maxNumberOfLeafNodes < 0 && _useLevelWiseBuilder) {
+          _LevelWiseBuilder<Criterion> builder(_minSamplesInALeaf, _minSamplesInANode, _maxDepth,
+                                               _numberOfFeaturesToSplit, &criterion,
+                                               _numberOfSplitThreads);
+          _buildTrees(&builder, trainData, labelData, weights, &residuals);
+        }
+        else if (_maxNumberOfLeafNodes < 0) {
           _DepthFirstBuilder<Criterion, _PresortBestSplitter> builder(_minSamplesInALeaf,
                                                                       _minSamplesInANode,
                                                                       _maxDepth,
                                                                       _numberOfFeaturesToSplit,
-                                                                      &criterion);
-          _buildTrees(&builder, trainData, labelData, weights);
+                                                                      &criterion, 1,
+                                                                      std::numeric_limits<long>::max(),
+                                                                      _numberOfSplitThreads);
+          _buildTrees(&builder, trainData, labelData, weights, &residuals);
         }
         else {
           _BestFirstBuilder<Criterion, _PresortBestSplitter> builder(_minSamplesInALeaf,
@@ -77,10 +88,12 @@ namespace Lib15x
                                                                      _maxDepth,
                                                                      _maxNumberOfLeafNodes,
                                                                      _numberOfFeaturesToSplit,
-                                                                     &criterion);
-          _buildTrees(&builder, trainData, labelData, weights);
+                                                                     &criterion,
+                                                                     _numberOfSplitThreads);
+          _buildTrees(&builder, trainData, labelData, weights, &residuals);
         }
 
+        _prepareScoring();
         BaseRegressor::_modelTrained = true;
       }
 
@@ -88,15 +101,145 @@ namespace Lib15x
       predictOne(const VectorXd& instance) const
       {
         assert(BaseRegressor::_modelTrained);
-        double result=0;
+        double result = _initialPrediction;
         for (auto& tree : _trees)
           result += tree.predictOne(instance);
         return result;
       }
 
+      void
+      _predictBatch(const MatrixXd& testData, const vector<long>& testIndices,
+                    VectorXd* predictedLabelData) const
+      {
+        assert(BaseRegressor::_modelTrained);
+        if (_quickScorer.numberOfTrees() > 0) {
+          const long numberOfTrees = _trees.size();
+          _quickScorer.predictRows(testData, testIndices,
+                                   [this, &testIndices, predictedLabelData, numberOfTrees]
+                                   (const long rowPosition, const int32_t* leafIndices) {
+                                     double result = _initialPrediction;
+                                     for (long treeId = 0; treeId < numberOfTrees; ++treeId)
+                                       result += _trees[treeId].leafValue(leafIndices[treeId]);
+                                     (*predictedLabelData)(testIndices[rowPosition]) = result;
+                                   });
+          return;
+        }
+
+        vector<double> blockResults(_predictionBlockSize(testData.cols()), _initialPrediction);
+        _predictInBlocks(_trees.data(), _trees.size(), testData, testIndices,
+                         [this, &blockResults](const long treeId, const long blockStart,
+                                               const long numberOfRowsInBlock,
+                                               const int32_t* leafIndices) {
+                           ignoreUnusedVariable(blockStart);
+                           const _RegressionTree& tree = _trees[treeId];
+                           for (long rowId = 0; rowId < numberOfRowsInBlock; ++rowId)
+                             blockResults[rowId] += tree.leafValue(leafIndices[rowId]);
+                         },
+                         [this, &blockResults, &testIndices, predictedLabelData]
+                         (const long blockStart, const long numberOfRowsInBlock) {
+                           for (long rowId = 0; rowId < numberOfRowsInBlock; ++rowId) {
+                             (*predictedLabelData)(testIndices[blockStart+rowId]) =
+                               blockResults[rowId];
+                             blockResults[rowId] = _initialPrediction;
+                           }
+                         });
+      }
+
+      // Writes a standalone C++ file defining extern "C" double functionName(const double*),
+      // which returns the same label as predictOne for a row of numberOfFeatures values.
+      void
+      generateCode(std::ostream& out, const std::string& functionName,
+                   const long maxBranchDepth=64) const
+      {
+        assert(BaseRegressor::_modelTrained);
+        _writeTreesCode(out, ModelName, _trees.data(), _trees.size(), maxBranchDepth);
+        _writeRegressorCode(out, functionName, _trees.size(), _initialPrediction);
+      }
+
       void
       _clearModel() {
         _trees.clear();
+        _quickScorer.reset();
+        _initialPrediction = 0.0;
+        _trainPredictions.resize(0);
+      }
+
+      // Lays out the nodes of every tree so the branch the rows of sampleData take more often
+      // follows its parent in memory. Labels do not change.
+      void
+      reorderNodesByPaths(const MatrixXd& sampleData)
+      {
+        assert(BaseRegressor::_modelTrained);
+        _reorderNodesByPaths(_trees.data(), _trees.size(), sampleData);
+        _prepareScoring();
+      }
+
+      // Keeps the trees that greedy forward selection on held-out data picks within the budget,
+      // in the order picked, up to the step with the lowest loss. Returns every step, which
+      // weighs the loss of smaller ensembles against their size and path length. Warm start
+      // needs a new train afterwards.
+      vector<PruningStep>
+      prune(const MatrixXd& validationData, const Labels& validationLabels,
+            const PruningBudget& budget) {
+        assert(BaseRegressor::_modelTrained);
+        const VectorXd& labelData = validationLabels._labelData;
+        if (validationLabels._labelType != ProblemType::Regression ||
+            validationData.cols() != BaseRegressor::_numberOfFeatures ||
+            validationData.rows() != labelData.size()) {
+          throwException("Error happen when pruning %s: "
+                         "expecting Regression labels for (%ld) features, "
+                         "provided (%ld) rows of (%ld) features and (%ld) labels.\n",
+                         ModelName, BaseRegressor::_numberOfFeatures, validationData.rows(),
+                         validationData.cols(), labelData.size());
+        }
+
+        const long numberOfRows = validationData.rows();
+        vector<vector<int32_t> > leafIndices;
+        vector<_TreeCost> costs;
+        _leavesAndCostsOf(_trees.data(), _trees.size(), validationData, &leafIndices, &costs);
+        VectorXd predictions = VectorXd::Constant(numberOfRows, _initialPrediction);
+        auto lossWith = [&](const long treeId) {
+          double loss = 0.0;
+          for (long rowId = 0; rowId < numberOfRows; ++rowId) {
+            const double difference = predictions(rowId) +
+              _trees[treeId].leafValue(leafIndices[treeId][rowId]) - labelData(rowId);
+            loss += difference*difference;
+          }
+          return loss;
+        };
+        auto add = [&](const long treeId) {
+          for (long rowId = 0; rowId < numberOfRows; ++rowId)
+            predictions(rowId) += _trees[treeId].leafValue(leafIndices[treeId][rowId]);
+        };
+        const vector<PruningStep> steps = _selectTreesGreedily(costs, budget, lossWith, add);
+
+        const long numberOfKeptTrees = _bestNumberOfSteps(steps);
+        if (numberOfKeptTrees == 0) {
+          throwException("Error happen when pruning %s: no tree fits the budget", ModelName);
+        }
+        vector<_RegressionTree> keptTrees;
+        keptTrees.reserve(numberOfKeptTrees);
+        for (long stepId = 0; stepId < numberOfKeptTrees; ++stepId)
+          keptTrees.push_back(std::move(_trees[steps[stepId]._treeId]));
+        _trees.swap(keptTrees);
+        _trainPredictions.resize(0);
+        _prepareScoring();
+        return steps;
+      }
+
+      // Appends untrained trees; the next train() builds them, and with setWarmStart() only them.
+      void
+      addTrees(const long numberOfTrees) {
+        for (long treeCount = 0; treeCount < numberOfTrees; ++treeCount)
+          _trees.emplace_back(BaseRegressor::_numberOfFeatures);
+        BaseRegressor::_modelTrained = false;
+      }
+
+      // train() keeps the trees it already built and boosts the new ones from the cached
+      // predictions of the previous train(), which must have seen the same data.
+      bool&
+      setWarmStart() {
+        return _warmStart;
       }
 
       double&
@@ -104,47 +247,81 @@ namespace Lib15x
         return _learningRate;
       }
 
+      long&
+      setNumberOfSplitThreads() {
+        return _numberOfSplitThreads;
+      }
+
+      // Scores with _QuickScorer instead of walking the trees; every tree must have at most
+      // 64 leaves, e.g. maxNumberOfLeafNodes <= 64.
+      bool&
+      setUseQuickScorer() {
+        return _useQuickScorer;
+      }
+
+      // Grows each tree level by level over binned features with _LevelWiseBuilder instead of
+      // depth first over presorted columns; unused when maxNumberOfLeafNodes is set.
+      bool&
+      setUseLevelWiseBuilder() {
+        return _useLevelWiseBuilder;
+      }
+
     private:
+      void
+      _prepareScoring() {
+        if (_useQuickScorer)
+          _quickScorer.build(_trees.data(), _trees.size(), BaseRegressor::_numberOfFeatures);
+        else
+          _quickScorer.reset();
+      }
+
+      // Each tree fits the residuals of the predictions so far and is shrunk by the learning
+      // rate, so the model is the initial mean plus the sum of the trees.
       template<class BuilderType>
       void _buildTrees (BuilderType* builder, const MatrixXd& trainData,
-                        const VectorXd& labelData, const VectorXd& weights) {
-        long numberOfData = labelData.size();
-        VectorXd yPre = VectorXd(numberOfData); yPre.fill(0);
-        double mean = 0;
-        for (long dataId=0; dataId<numberOfData; ++dataId)
-          mean += weights(dataId)*trainData(dataId);
-        mean /= weights.sum();
-        yPre.fill(mean);
-
-        vector<long> trainIndices;
-        for (long dataId=0; dataId<labelData.size(); ++dataId){
-          long dataRepeat=static_cast<long>(weights(dataId));
-          if (static_cast<double>(dataRepeat) != weights(dataId)) {
-            throwException("Error happened when training %s model: "
-                           "cannot handle general sample weights=%f",
-                           ModelName, weights(dataId));
-          }
-          for (long rep=0; rep<dataRepeat; ++rep)
-            trainIndices.push_back(dataId);
+                        const VectorXd& labelData, const VectorXd& weights,
+                        VectorXd* residuals) {
+        const long numberOfData = labelData.size();
+        const long numberOfTrees = _trees.size();
+        long firstTreeId = 0;
+        if (_warmStart)
+          while (firstTreeId < numberOfTrees && _trees[firstTreeId]._isFinalized)
+            ++firstTreeId;
+        if (firstTreeId > 0 && _trainPredictions.size() != numberOfData) {
+          throwException("Error happened when warm starting %s: "
+                         "trained on (%ld) rows before, given (%ld) rows",
+                         ModelName, static_cast<long>(_trainPredictions.size()), numberOfData);
+        }
+        if (firstTreeId == 0) {
+          _initialPrediction = labelData.dot(weights)/weights.sum();
+          _trainPredictions.setConstant(numberOfData, _initialPrediction);
         }
 
-        long numberOfTrees =  _trees.size();
-        for (long treeId=0; treeId<numberOfTrees; ++treeId) {
-          VectorXd residual = yPre;
+        vector<long> trainIndices = _trainIndicesOfWeights(weights, ModelName);
+        vector<long> rowOffsets(numberOfData);
+        for (long dataId = 0; dataId < numberOfData; ++dataId)
+          rowOffsets[dataId] = dataId*trainData.cols();
+        vector<int32_t> leafIndices(numberOfData);
+
+        const _FeatureStore featureStore(trainData);
+        for (long treeId = firstTreeId; treeId < numberOfTrees; ++treeId) {
+          *residuals = labelData - _trainPredictions;
+          _RegressionTree& tree = _trees[treeId];
+          tree.reset();
           try {
-            builder->build(trainData, &_trees[treeId], &trainIndices);
+            builder->build(featureStore, &tree, &trainIndices);
+            tree.finalize();
           }
           catch (...) {
             printf("exception caught when training %s: ", ModelName);
             throw;
           }
+          tree.scaleLeafValues(_learningRate);
 
-          for (long dataId=0; dataId<numberOfData; ++dataId) {
-            Map<const VectorXd> instance(&trainData(dataId, 0),
-                                         BaseRegressor::_numberOfFeatures);
-            double predictedValue = _trees[treeId].predictOne(instance);
-            yPre(dataId) += _learningRate*predictedValue;
-          }
+          tree.leafIndicesOf(trainData.data(), rowOffsets.data(), numberOfData,
+                             leafIndices.data());
+          for (long dataId = 0; dataId < numberOfData; ++dataId)
+            _trainPredictions(dataId) += tree.leafValue(leafIndices[dataId]);
         }
       }
 
@@ -156,6 +333,13 @@ namespace Lib15x
         long _numberOfFeaturesToSplit;
         vector<_RegressionTree> _trees;
         double _learningRate = 1.0;
+        long _numberOfSplitThreads = 1;
+        bool _useQuickScorer = false;
+        bool _useLevelWiseBuilder = false;
+        _QuickScorer _quickScorer;
+        bool _warmStart = false;
+        double _initialPrediction = 0.0;
+        VectorXd _trainPredictions;
       };
     }
   }
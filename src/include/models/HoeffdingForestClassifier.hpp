@@ -0,0 +1,280 @@
+#ifndef MODEL_HOEFFDING_FOREST_CLASSIFIER
+#define MODEL_HOEFFDING_FOREST_CLASSIFIER
+
+#include "../core/Definitions.hpp"
+#include "../core/Utilities.hpp"
+#include "../internal/_BaseClassifier.hpp"
+#include "../internal/_ClassificationTree.hpp"
+#include "../internal/_ClassificationCriterion.hpp"
+#include "../internal/_HoeffdingTree.hpp"
+#include "../internal/_EnsemblePrediction.hpp"
+#include "../internal/_CodeGenerator.hpp"
+#include "../internal/_Parallel.hpp"
+
+namespace Lib15x
+{
+  namespace Models
+  {
+    // A forest for streams: partialFit updates it with every mini-batch instead of retraining.
+    // Each tree sees every sample Poisson(1) times (online bagging, Oza and Russell) and grows
+    // with _HoeffdingTree. After a batch the trees are compiled to the same flat trees as
+    // RandomForestClassifier, so prediction costs the same; each tree votes with the class
+    // frequencies of its leaf.
+    template<double (*ImpurityRule)(const vector<double>&) = gini>
+    class HoeffdingForestClassifier :
+      public _BaseClassifier<HoeffdingForestClassifier<ImpurityRule> > {
+    public:
+      using BaseClassifier = _BaseClassifier<HoeffdingForestClassifier>;
+      using BaseClassifier::train;
+      static constexpr const char* ModelName = "HoeffdingForestClassifier";
+      static constexpr double (*LossFunction)(const Labels&, const Labels&) =
+        BaseClassifier::LossFunction;
+
+      HoeffdingForestClassifier(const long numberOfFeatures,
+                                const long numberOfClasses,
+                                const long numberOfTrees,
+                                const long maxDepth,
+                                const long numberOfFeaturesToSplit,
+                                const long maxNumberOfLeafNodes) :
+        BaseClassifier{numberOfFeatures, numberOfClasses}, _numberOfTrees{numberOfTrees}
+      {
+        if (numberOfTrees <= 0 || maxDepth <= 0 || numberOfFeaturesToSplit <= 0 ||
+            maxNumberOfLeafNodes == 0 || maxNumberOfLeafNodes < -1) {
+          throwException("Error happen when constructing %s, "
+                         "user input regularization parameter cannot be smaller than 1: "
+                         "numberOfTrees = : (%ld); "
+                         "maxDepth = : (%ld); "
+                         "numberOfFeaturesToSplit = : (%ld); "
+                         "maxNumberOfLeafNodes = : (%ld); ",
+                         ModelName, numberOfTrees, maxDepth, numberOfFeaturesToSplit,
+                         maxNumberOfLeafNodes);
+        }
+        _options._maxDepth = maxDepth;
+        _options._numberOfFeaturesToSplit = numberOfFeaturesToSplit;
+        _options._maxNumberOfLeafNodes = maxNumberOfLeafNodes;
+      }
+
+      // Trees of at most 1024 leaves, splitting on sqrt(numberOfFeatures) random features.
+      HoeffdingForestClassifier(const long numberOfFeatures,
+                                const long numberOfClasses,
+                                const long numberOfTrees) :
+        HoeffdingForestClassifier{numberOfFeatures, numberOfClasses, numberOfTrees,
+          std::numeric_limits<long>::max(),
+          std::max(1L, static_cast<long>(sqrt(static_cast<double>(numberOfFeatures)))), 1024} {}
+
+      // Starts a new stream with this data.
+      void
+      train(const MatrixXd& trainData, const Labels& trainLabels, const VectorXd& weights)
+      {
+        BaseClassifier::_modelTrained = false;
+        partialFit(trainData, trainLabels, weights);
+      }
+
+      // Updates the trees with a mini-batch, which need not hold every class.
+      void
+      partialFit(const MatrixXd& trainData, const Labels& trainLabels)
+      {
+        VectorXd weights(trainData.rows()); weights.fill(1.0);
+        partialFit(trainData, trainLabels, weights);
+      }
+
+      void
+      partialFit(const MatrixXd& trainData, const Labels& trainLabels, const VectorXd& weights)
+      {
+        const VectorXd& labelData = trainLabels._labelData;
+        const long numberOfClasses = BaseClassifier::_numberOfClasses;
+        if (trainLabels._labelType != ProblemType::Classification ||
+            trainData.cols() != BaseClassifier::_numberOfFeatures ||
+            trainData.rows() != labelData.size() || weights.size() != labelData.size()) {
+          throwException("Error happen when updating %s model: "
+                         "expecting Classification labels for (%ld) features, "
+                         "provided (%ld) rows of (%ld) features, "
+                         "(%ld) labels and (%ld) weights.\n",
+                         ModelName, BaseClassifier::_numberOfFeatures,
+                         trainData.rows(), trainData.cols(),
+                         labelData.size(), weights.size());
+        }
+        for (long dataId = 0; dataId < labelData.size(); ++dataId)
+          if (!(labelData(dataId) >= 0 &&
+                labelData(dataId) < static_cast<double>(numberOfClasses))) {
+            throwException("Error happen when updating %s model: "
+                           "the (%ld)th label is (%f), expecting labels from (0) to (%ld)!",
+                           ModelName, dataId, labelData(dataId), numberOfClasses-1);
+          }
+
+        if (!BaseClassifier::_modelTrained)
+          _resetTrees();
+
+        _parallelFor(_numberOfThreads, _numberOfTrees,
+                     [&](const long treeId, const long threadId) {
+                       ignoreUnusedVariable(threadId);
+                       std::mt19937& randomEngine = _randomEngines[treeId];
+                       _HoeffdingTree<ImpurityRule>& tree = _trees[treeId];
+                       std::poisson_distribution<long> numberOfDraws{1.0};
+                       for (long dataId = 0; dataId < trainData.rows(); ++dataId) {
+                         const long draws = numberOfDraws(randomEngine);
+                         if (draws == 0 || !(weights(dataId) > 0)) continue;
+                         tree.update(&trainData(dataId, 0),
+                                     static_cast<long>(labelData(dataId)),
+                                     static_cast<double>(draws)*weights(dataId));
+                       }
+                       tree.compile(&_compiledTrees[treeId]);
+                     });
+
+        BaseClassifier::_modelTrained = true;
+      }
+
+      double
+      predictOne(const VectorXd& instance) const
+      {
+        assert(BaseClassifier::_modelTrained);
+        vector<double> predictedLabelsCount(BaseClassifier::_numberOfClasses, 0.0);
+        for (const auto& tree : _compiledTrees) {
+          const double* labelsCount= tree.predictOne(instance);
+          std::transform(std::begin(predictedLabelsCount), std::end(predictedLabelsCount),
+                         labelsCount, std::begin(predictedLabelsCount),
+                         std::plus<double>());
+        }
+
+        auto maxLabelPos=std::max_element(std::begin(predictedLabelsCount),
+                                          std::end(predictedLabelsCount));
+
+        return static_cast<double>(maxLabelPos-std::begin(predictedLabelsCount));
+      }
+
+      void
+      _predictBatch(const MatrixXd& testData, const vector<long>& testIndices,
+                    VectorXd* predictedLabelData) const
+      {
+        assert(BaseClassifier::_modelTrained);
+        const long numberOfClasses = BaseClassifier::_numberOfClasses;
+        vector<double> blockLabelsCount(_predictionBlockSize(testData.cols())*numberOfClasses,
+                                        0.0);
+        _predictInBlocks(_compiledTrees.data(), _compiledTrees.size(), testData, testIndices,
+                         [this, &blockLabelsCount, numberOfClasses]
+                         (const long treeId, const long blockStart,
+                          const long numberOfRowsInBlock, const int32_t* leafIndices) {
+                           ignoreUnusedVariable(blockStart);
+                           const _ClassificationTree& tree = _compiledTrees[treeId];
+                           for (long rowId = 0; rowId < numberOfRowsInBlock; ++rowId) {
+                             const double* labelsCount = tree.leafValue(leafIndices[rowId]);
+                             double* rowLabelsCount = &blockLabelsCount[rowId*numberOfClasses];
+                             for (long classId = 0; classId < numberOfClasses; ++classId)
+                               rowLabelsCount[classId] += labelsCount[classId];
+                           }
+                         },
+                         [&blockLabelsCount, &testIndices, predictedLabelData, numberOfClasses]
+                         (const long blockStart, const long numberOfRowsInBlock) {
+                           for (long rowId = 0; rowId < numberOfRowsInBlock; ++rowId) {
+                             double* rowLabelsCount = &blockLabelsCount[rowId*numberOfClasses];
+                             auto maxLabelPos = std::max_element(rowLabelsCount,
+                                                                 rowLabelsCount+numberOfClasses);
+                             (*predictedLabelData)(testIndices[blockStart+rowId]) =
+                               static_cast<double>(maxLabelPos-rowLabelsCount);
+                             std::fill(rowLabelsCount, rowLabelsCount+numberOfClasses, 0.0);
+                           }
+                         });
+      }
+
+      // Writes a standalone C++ file defining extern "C" double functionName(const double*),
+      // which returns the same label as predictOne for a row of numberOfFeatures values.
+      void
+      generateCode(std::ostream& out, const std::string& functionName,
+                   const long maxBranchDepth=64) const
+      {
+        assert(BaseClassifier::_modelTrained);
+        _writeTreesCode(out, ModelName, _compiledTrees.data(), _compiledTrees.size(),
+                        maxBranchDepth);
+        _writeClassifierCode(out, functionName, _compiledTrees.size(),
+                             BaseClassifier::_numberOfClasses);
+      }
+
+      void
+      _clearModel() {
+        _trees.clear();
+        _compiledTrees.clear();
+        _randomEngines.clear();
+      }
+
+      const _HoeffdingTree<ImpurityRule>&
+      tree(const long treeId) const {
+        return _trees[treeId];
+      }
+
+      // The options below are taken when a stream starts, i.e. at train or at the first
+      // partialFit after construction or clear.
+      long&
+      setNumberOfCandidates() {
+        return _options._numberOfCandidates;
+      }
+
+      double&
+      setGracePeriod() {
+        return _options._gracePeriod;
+      }
+
+      double&
+      setSplitConfidence() {
+        return _options._splitConfidence;
+      }
+
+      double&
+      setTieThreshold() {
+        return _options._tieThreshold;
+      }
+
+      // Trees are updated concurrently on this many threads.
+      long&
+      setNumberOfThreads() {
+        return _numberOfThreads;
+      }
+
+      // Seeds the random streams of the trees, so a seed gives the same forest whatever the
+      // number of threads and the split of the stream into batches; a negative seed draws one
+      // from rand() at every new stream.
+      long&
+      setRandomSeed() {
+        return _randomSeed;
+      }
+
+    private:
+      void
+      _resetTrees() {
+        if (_options._numberOfCandidates < 2 || !(_options._gracePeriod > 0) ||
+            !(_options._splitConfidence > 0 && _options._splitConfidence < 1)) {
+          throwException("Error happen when starting %s: "
+                         "numberOfCandidates = : (%ld) must be at least 2, "
+                         "gracePeriod = : (%f) must be positive, "
+                         "splitConfidence = : (%f) must be in (0, 1).",
+                         ModelName, _options._numberOfCandidates, _options._gracePeriod,
+                         _options._splitConfidence);
+        }
+        const uint32_t forestSeed =
+          static_cast<uint32_t>(_randomSeed >= 0 ? _randomSeed : rand());
+        _clearModel();
+        _randomEngines.reserve(_numberOfTrees);
+        _trees.reserve(_numberOfTrees);
+        for (long treeId = 0; treeId < _numberOfTrees; ++treeId) {
+          std::seed_seq seeds{forestSeed, static_cast<uint32_t>(treeId)};
+          _randomEngines.emplace_back(seeds);
+          _trees.emplace_back(BaseClassifier::_numberOfFeatures,
+                              BaseClassifier::_numberOfClasses, _options,
+                              &_randomEngines[treeId]);
+          _compiledTrees.emplace_back(BaseClassifier::_numberOfFeatures,
+                                      BaseClassifier::_numberOfClasses);
+        }
+      }
+
+      long _numberOfTrees;
+      _HoeffdingOptions _options;
+      vector<_HoeffdingTree<ImpurityRule> > _trees;
+      vector<_ClassificationTree> _compiledTrees;
+      // one per tree, so the trees do not depend on each other or on the threads
+      vector<std::mt19937> _randomEngines;
+      long _numberOfThreads = 1;
+      long _randomSeed = -1;
+    };
+  }
+}
+
+#endif //MODEL_HOEFFDING_FOREST_CLASSIFIER
@@ -7,13 +7,19 @@
 #include "../internal/_Builder.hpp"
 #include "../internal/_ClassificationTree.hpp"
 #include "../internal/_ClassificationCriterion.hpp"
+#include "../internal/_EnsemblePrediction.hpp"
+#include "../internal/_EnsemblePruning.hpp"
+#include "../internal/_QuickScorer.hpp"
+#include "../internal/_CodeGenerator.hpp"
 
 namespace Lib15x
 {
   namespace Models
   {
-    template<double (*ImpurityRule)(const vector<long>&) = gini>
-    class RandomForestClassifier : public _BaseClassifier<RandomForestClassifier<ImpurityRule> > {
+    template<double (*ImpurityRule)(const vector<double>&) = gini,
+             template<class Criterion> class _Splitter = _PresortBestSplitter>
+    class RandomForestClassifier :
+      public _BaseClassifier<RandomForestClassifier<ImpurityRule, _Splitter> > {
     public:
       using BaseClassifier = _BaseClassifier<RandomForestClassifier>;
       using BaseClassifier::train;
@@ -22,6 +28,7 @@ namespace Lib15x
         BaseClassifier::LossFunction;
 
       using Criterion = _ClassificationCriterion<ImpurityRule>;
+      using BinaryCriterion = _ClassificationCriterion<ImpurityRule, 2>;
 
       RandomForestClassifier(const long numberOfFeatures,
                              const long numberOfClasses,
@@ -79,25 +86,15 @@ namespace Lib15x
         const VectorXd& labelData = trainLabels._labelData;
         assert(weights.size()==trainLabels.size());
 
-        Criterion criterion{&labelData, BaseClassifier::_numberOfClasses};
+        if (BaseClassifier::_numberOfClasses == 2)
+          _trainTrees<BinaryCriterion>(trainData, labelData, weights);
+        else
+          _trainTrees<Criterion>(trainData, labelData, weights);
 
-        if (_maxNumberOfLeafNodes < 0) {
-          _DepthFirstBuilder<Criterion, _PresortBestSplitter> builder(_minSamplesInALeaf,
-                                                                      _minSamplesInANode,
-                                                                      _maxDepth,
-                                                                      _numberOfFeaturesToSplit,
-                                                                      &criterion);
-          _buildTrees(&builder, trainData, labelData, weights);
-        }
-        else {
-          _BestFirstBuilder<Criterion, _PresortBestSplitter> builder(_minSamplesInALeaf,
-                                                                     _minSamplesInANode,
-                                                                     _maxDepth,
-                                                                     _maxNumberOfLeafNodes,
-                                                                     _numberOfFeaturesToSplit,
-                                                                     &criterion);
-          _buildTrees(&builder, trainData, labelData, weights);
-        }
+        _prepareScoring();
+
+        if (_computeOutOfBag)
+          _outOfBagLoss = LossFunction(outOfBagLabels(), trainLabels);
 
         BaseClassifier::_modelTrained = true;
       }
@@ -106,12 +103,23 @@ namespace Lib15x
       predictOne(const VectorXd& instance) const
       {
         assert(BaseClassifier::_modelTrained);
-        vector<long> predictedLabelsCount(BaseClassifier::_numberOfClasses, 0);
-        for (const auto& tree : _trees) {
-          const vector<long>& labelsCount= tree.predictOne(instance);
+        const long numberOfClasses = BaseClassifier::_numberOfClasses;
+        vector<double> predictedLabelsCount(numberOfClasses, 0.0);
+        const long numberOfTrees = _trees.size();
+        double squaredVoteWeights = 0.0;
+        for (long treeId = 0; treeId < numberOfTrees; ++treeId) {
+          const double* labelsCount= _trees[treeId].predictOne(instance);
           std::transform(std::begin(predictedLabelsCount), std::end(predictedLabelsCount),
-                         std::begin(labelsCount), std::begin(predictedLabelsCount),
-                         std::plus<long>());
+                         labelsCount, std::begin(predictedLabelsCount),
+                         std::plus<double>());
+          if (!_earlyExit) continue;
+          if (_earlyExitRisk > 0.0) {
+            const double voteWeight = *std::max_element(labelsCount, labelsCount+numberOfClasses);
+            squaredVoteWeights += voteWeight*voteWeight;
+          }
+          if (_earlyExitRule.isSettled(predictedLabelsCount.data(), numberOfClasses, treeId+1,
+                                       _earlyExitRisk, squaredVoteWeights))
+            break;
         }
 
         auto maxLabelPos=std::max_element(std::begin(predictedLabelsCount),
@@ -120,42 +128,503 @@ namespace Lib15x
         return static_cast<double>(maxLabelPos-std::begin(predictedLabelsCount));
       }
 
+      void
+      _predictBatch(const MatrixXd& testData, const vector<long>& testIndices,
+                    VectorXd* predictedLabelData) const
+      {
+        assert(BaseClassifier::_modelTrained);
+        const long numberOfClasses = BaseClassifier::_numberOfClasses;
+        if (_quickScorer.numberOfTrees() > 0) {
+          const long numberOfTrees = _trees.size();
+          vector<double> labelsCountOfRow(numberOfClasses);
+          auto scoreRow = [this, &labelsCountOfRow, &testIndices, predictedLabelData,
+                           numberOfTrees, numberOfClasses]
+            (const long rowPosition, const int32_t* leafIndices) {
+            std::fill(std::begin(labelsCountOfRow), std::end(labelsCountOfRow), 0.0);
+            for (long treeId = 0; treeId < numberOfTrees; ++treeId) {
+              const double* labelsCount = _trees[treeId].leafValue(leafIndices[treeId]);
+              for (long classId = 0; classId < numberOfClasses; ++classId)
+                labelsCountOfRow[classId] += labelsCount[classId];
+            }
+            auto maxLabelPos = std::max_element(std::begin(labelsCountOfRow),
+                                                std::end(labelsCountOfRow));
+            (*predictedLabelData)(testIndices[rowPosition]) =
+              static_cast<double>(maxLabelPos-std::begin(labelsCountOfRow));
+          };
+          _quickScorer.predictRows(testData, testIndices, scoreRow);
+          return;
+        }
+
+        vector<double> blockLabelsCount(_predictionBlockSize(testData.cols())*numberOfClasses,
+                                        0.0);
+        auto finishBlock = [&blockLabelsCount, &testIndices, predictedLabelData, numberOfClasses]
+          (const long blockStart, const long numberOfRowsInBlock) {
+          for (long rowId = 0; rowId < numberOfRowsInBlock; ++rowId) {
+            double* rowLabelsCount = &blockLabelsCount[rowId*numberOfClasses];
+            auto maxLabelPos = std::max_element(rowLabelsCount, rowLabelsCount+numberOfClasses);
+            (*predictedLabelData)(testIndices[blockStart+rowId]) =
+              static_cast<double>(maxLabelPos-rowLabelsCount);
+            std::fill(rowLabelsCount, rowLabelsCount+numberOfClasses, 0.0);
+          }
+        };
+        if (_earlyExit) {
+          vector<double> blockSquaredVoteWeights(_predictionBlockSize(testData.cols()), 0.0);
+          _predictInBlocksUntilSettled(
+            _trees.data(), _trees.size(), testData, testIndices,
+            [this, &blockLabelsCount, &blockSquaredVoteWeights, numberOfClasses]
+            (const long treeId, const long* openRows, const long numberOfOpenRows,
+             const int32_t* leafIndices) {
+              const _ClassificationTree& tree = _trees[treeId];
+              for (long openId = 0; openId < numberOfOpenRows; ++openId) {
+                const double* labelsCount = tree.leafValue(leafIndices[openId]);
+                double* rowLabelsCount = &blockLabelsCount[openRows[openId]*numberOfClasses];
+                double voteWeight = 0.0;
+                for (long classId = 0; classId < numberOfClasses; ++classId) {
+                  rowLabelsCount[classId] += labelsCount[classId];
+                  voteWeight = std::max(voteWeight, labelsCount[classId]);
+                }
+                blockSquaredVoteWeights[openRows[openId]] += voteWeight*voteWeight;
+              }
+            },
+            [this, &blockLabelsCount, &blockSquaredVoteWeights, numberOfClasses]
+            (const long rowId, const long numberOfTreesDone) {
+              return _earlyExitRule.isSettled(&blockLabelsCount[rowId*numberOfClasses],
+                                              numberOfClasses, numberOfTreesDone,
+                                              _earlyExitRisk, blockSquaredVoteWeights[rowId]);
+            },
+            [&finishBlock, &blockSquaredVoteWeights]
+            (const long blockStart, const long numberOfRowsInBlock) {
+              finishBlock(blockStart, numberOfRowsInBlock);
+              std::fill(std::begin(blockSquaredVoteWeights), std::end(blockSquaredVoteWeights),
+                        0.0);
+            });
+          return;
+        }
+
+        _predictInBlocks(_trees.data(), _trees.size(), testData, testIndices,
+                         [this, &blockLabelsCount, numberOfClasses]
+                         (const long treeId, const long blockStart,
+                          const long numberOfRowsInBlock, const int32_t* leafIndices) {
+                           ignoreUnusedVariable(blockStart);
+                           const _ClassificationTree& tree = _trees[treeId];
+                           for (long rowId = 0; rowId < numberOfRowsInBlock; ++rowId) {
+                             const double* labelsCount = tree.leafValue(leafIndices[rowId]);
+                             double* rowLabelsCount = &blockLabelsCount[rowId*numberOfClasses];
+                             for (long classId = 0; classId < numberOfClasses; ++classId)
+                               rowLabelsCount[classId] += labelsCount[classId];
+                           }
+                         },
+                         finishBlock);
+      }
+
+      // Writes a standalone C++ file defining extern "C" double functionName(const double*),
+      // which returns the same label as predictOne for a row of numberOfFeatures values.
+      void
+      generateCode(std::ostream& out, const std::string& functionName,
+                   const long maxBranchDepth=64) const
+      {
+        assert(BaseClassifier::_modelTrained);
+        _writeTreesCode(out, ModelName, _trees.data(), _trees.size(), maxBranchDepth);
+        _writeClassifierCode(out, functionName, _trees.size(), BaseClassifier::_numberOfClasses);
+      }
+
       void
       _clearModel() {
         _trees.clear();
+        _quickScorer.reset();
+        _outOfBagVotes.resize(0, 0);
       }
 
-    private:
-      template<class BuilderType>
-      void _buildTrees (BuilderType* builder, const MatrixXd& trainData,
-                        const VectorXd& labelData, const VectorXd& weights) {
-        vector<long> trainIndices;
-        for (long dataId=0; dataId<labelData.size(); ++dataId){
-          long dataRepeat=static_cast<long>(weights(dataId));
-          if (static_cast<double>(dataRepeat) != weights(dataId)) {
-            throwException("Error happened when training %s model: "
-                           "cannot handle general sample weights=%f",
-                           ModelName, weights(dataId));
-          }
-          for (long rep=0; rep<dataRepeat; ++rep)
-            trainIndices.push_back(dataId);
+      // Scores with _QuickScorer instead of walking the trees; every tree must have at most
+      // 64 leaves, e.g. maxNumberOfLeafNodes <= 64.
+      bool&
+      setUseQuickScorer() {
+        return _useQuickScorer;
+      }
+
+      // Stops adding up the trees of a row once the remaining ones cannot change its label,
+      // which gives the same labels as summing all trees. Not used with setUseQuickScorer().
+      bool&
+      setEarlyExit() {
+        return _earlyExit;
+      }
+
+      // With early exit, also stops once the remaining trees change the label with a probability
+      // below about this risk, judged from the votes so far; 0 stops only when the label is sure.
+      double&
+      setEarlyExitRisk() {
+        return _earlyExitRisk;
+      }
+
+      // Puts the trees that agree most often with the forest on data first, so early exit
+      // settles sooner. Labels without early exit do not change.
+      void
+      orderTreesByAgreement(const MatrixXd& data) {
+        assert(BaseClassifier::_modelTrained);
+        const long numberOfClasses = BaseClassifier::_numberOfClasses;
+        const long numberOfTrees = _trees.size();
+        vector<long> testIndices(data.rows());
+        std::iota(std::begin(testIndices), std::end(testIndices), 0);
+        const long blockSize = _predictionBlockSize(data.cols());
+        vector<double> blockLabelsCount(blockSize*numberOfClasses, 0.0);
+        vector<long> blockTreeLabels(numberOfTrees*blockSize);
+        vector<long> agreements(numberOfTrees, 0);
+        _predictInBlocks(_trees.data(), numberOfTrees, data, testIndices,
+                         [&](const long treeId, const long blockStart,
+                             const long numberOfRowsInBlock, const int32_t* leafIndices) {
+                           ignoreUnusedVariable(blockStart);
+                           for (long rowId = 0; rowId < numberOfRowsInBlock; ++rowId) {
+                             const double* labelsCount =
+                               _trees[treeId].leafValue(leafIndices[rowId]);
+                             double* rowLabelsCount = &blockLabelsCount[rowId*numberOfClasses];
+                             for (long classId = 0; classId < numberOfClasses; ++classId)
+                               rowLabelsCount[classId] += labelsCount[classId];
+                             blockTreeLabels[treeId*blockSize+rowId] =
+                               std::max_element(labelsCount, labelsCount+numberOfClasses) -
+                               labelsCount;
+                           }
+                         },
+                         [&](const long blockStart, const long numberOfRowsInBlock) {
+                           ignoreUnusedVariable(blockStart);
+                           for (long rowId = 0; rowId < numberOfRowsInBlock; ++rowId) {
+                             double* rowLabelsCount = &blockLabelsCount[rowId*numberOfClasses];
+                             const long label =
+                               std::max_element(rowLabelsCount, rowLabelsCount+numberOfClasses) -
+                               rowLabelsCount;
+                             for (long treeId = 0; treeId < numberOfTrees; ++treeId)
+                               agreements[treeId] += blockTreeLabels[treeId*blockSize+rowId] ==
+                                 label;
+                             std::fill(rowLabelsCount, rowLabelsCount+numberOfClasses, 0.0);
+                           }
+                         });
+
+        vector<long> treeOrder(numberOfTrees);
+        std::iota(std::begin(treeOrder), std::end(treeOrder), 0);
+        std::stable_sort(std::begin(treeOrder), std::end(treeOrder),
+                         [&agreements](const long treeA, const long treeB) {
+                           return agreements[treeA] > agreements[treeB];
+                         });
+        vector<_ClassificationTree> orderedTrees;
+        orderedTrees.reserve(numberOfTrees);
+        for (const long treeId : treeOrder)
+          orderedTrees.push_back(std::move(_trees[treeId]));
+        _trees.swap(orderedTrees);
+        _prepareScoring();
+      }
+
+      // Lays out the nodes of every tree so the branch the rows of sampleData take more often
+      // follows its parent in memory. Labels do not change.
+      void
+      reorderNodesByPaths(const MatrixXd& sampleData)
+      {
+        assert(BaseClassifier::_modelTrained);
+        _reorderNodesByPaths(_trees.data(), _trees.size(), sampleData);
+        _prepareScoring();
+      }
+
+      // Keeps the trees that greedy forward selection on held-out data picks within the budget,
+      // in the order picked, up to the step with the lowest loss. Returns every step, which
+      // weighs the loss of smaller forests against their size and path length. The out-of-bag
+      // votes are dropped, so reading them throws until the forest is trained again.
+      vector<PruningStep>
+      prune(const MatrixXd& validationData, const Labels& validationLabels,
+            const PruningBudget& budget) {
+        assert(BaseClassifier::_modelTrained);
+        const VectorXd& labelData = validationLabels._labelData;
+        if (validationLabels._labelType != ProblemType::Classification ||
+            validationData.cols() != BaseClassifier::_numberOfFeatures ||
+            validationData.rows() != labelData.size()) {
+          throwException("Error happen when pruning %s: "
+                         "expecting Classification labels for (%ld) features, "
+                         "provided (%ld) rows of (%ld) features and (%ld) labels.\n",
+                         ModelName, BaseClassifier::_numberOfFeatures, validationData.rows(),
+                         validationData.cols(), labelData.size());
         }
 
-        const long numberOfData = trainIndices.size();
-        for (auto& tree : _trees) {
-          vector<long> sampleIndicesForThisModel;
-          sampleIndicesForThisModel.reserve(numberOfData);
-          for (long dataId = 0; dataId<numberOfData; ++dataId){
-            long randomIndex=rand() % numberOfData;
-            sampleIndicesForThisModel.push_back(trainIndices[randomIndex]);
+        const long numberOfClasses = BaseClassifier::_numberOfClasses;
+        const long numberOfRows = validationData.rows();
+        vector<vector<int32_t> > leafIndices;
+        vector<_TreeCost> costs;
+        _leavesAndCostsOf(_trees.data(), _trees.size(), validationData, &leafIndices, &costs);
+        vector<double> labelsCount(numberOfRows*numberOfClasses, 0.0);
+        vector<double> rowLabelsCount(numberOfClasses);
+        auto lossWith = [&](const long treeId) {
+          double loss = 0.0;
+          for (long rowId = 0; rowId < numberOfRows; ++rowId) {
+            if (labelData(rowId) < 0) continue;
+            const double* leafLabelsCount = _trees[treeId].leafValue(leafIndices[treeId][rowId]);
+            for (long classId = 0; classId < numberOfClasses; ++classId)
+              rowLabelsCount[classId] = labelsCount[rowId*numberOfClasses+classId] +
+                leafLabelsCount[classId];
+            const long label = std::max_element(std::begin(rowLabelsCount),
+                                                std::end(rowLabelsCount)) -
+              std::begin(rowLabelsCount);
+            loss += static_cast<double>(static_cast<double>(label) != labelData(rowId));
           }
-          try {
-            builder->build(trainData, &tree, &sampleIndicesForThisModel);
+          return loss;
+        };
+        auto add = [&](const long treeId) {
+          for (long rowId = 0; rowId < numberOfRows; ++rowId) {
+            const double* leafLabelsCount = _trees[treeId].leafValue(leafIndices[treeId][rowId]);
+            for (long classId = 0; classId < numberOfClasses; ++classId)
+              labelsCount[rowId*numberOfClasses+classId] += leafLabelsCount[classId];
           }
-          catch(...) {
-            printf("exception caught when training %s: ", ModelName);
-            throw;
+        };
+        const vector<PruningStep> steps = _selectTreesGreedily(costs, budget, lossWith, add);
+
+        const long numberOfKeptTrees = _bestNumberOfSteps(steps);
+        if (numberOfKeptTrees == 0) {
+          throwException("Error happen when pruning %s: no tree fits the budget", ModelName);
+        }
+        vector<_ClassificationTree> keptTrees;
+        keptTrees.reserve(numberOfKeptTrees);
+        for (long stepId = 0; stepId < numberOfKeptTrees; ++stepId)
+          keptTrees.push_back(std::move(_trees[steps[stepId]._treeId]));
+        _trees.swap(keptTrees);
+        _outOfBagVotes.resize(0, 0);
+        _prepareScoring();
+        return steps;
+      }
+
+      // Appends untrained trees; the next train() builds them, and with setWarmStart() only them.
+      void
+      addTrees(const long numberOfTrees) {
+        for (long treeCount = 0; treeCount < numberOfTrees; ++treeCount)
+          _trees.emplace_back(BaseClassifier::_numberOfFeatures, BaseClassifier::_numberOfClasses);
+        BaseClassifier::_modelTrained = false;
+      }
+
+      // train() keeps the trees it already built and only builds the new ones, which get the
+      // same random streams as when the whole forest is trained at once. After prune() they
+      // get streams no tree of the forest had before. The out-of-bag votes of the kept trees
+      // are kept too, so the data must be the same as before.
+      bool&
+      setWarmStart() {
+        return _warmStart;
+      }
+
+      // Counts, while training, the votes of every tree for the training rows left out of its
+      // bootstrap; an estimate of the test loss without retraining.
+      bool&
+      setComputeOutOfBag() {
+        return _computeOutOfBag;
+      }
+
+      // Row i holds the out-of-bag votes per class for training row i.
+      const MatrixXd&
+      outOfBagVotes() const {
+        assert(_computeOutOfBag && BaseClassifier::_modelTrained);
+        _checkOutOfBagVotes();
+        return _outOfBagVotes;
+      }
+
+      // The majority out-of-bag vote of every training row; -1 for rows that were in the
+      // bootstrap of every tree.
+      Labels
+      outOfBagLabels() const {
+        assert(_computeOutOfBag);
+        _checkOutOfBagVotes();
+        Labels labels{ProblemType::Classification};
+        labels._labelData.resize(_outOfBagVotes.rows());
+        for (long dataId = 0; dataId < _outOfBagVotes.rows(); ++dataId) {
+          long label = -1;
+          _outOfBagVotes.row(dataId).maxCoeff(&label);
+          labels._labelData(dataId) =
+            _outOfBagVotes(dataId, label) > 0 ? static_cast<double>(label) : -1.0;
+        }
+        return labels;
+      }
+
+      // LossFunction of outOfBagLabels() over the rows with out-of-bag votes.
+      double
+      outOfBagLoss() const {
+        assert(_computeOutOfBag && BaseClassifier::_modelTrained);
+        _checkOutOfBagVotes();
+        return _outOfBagLoss;
+      }
+
+      // Trees are trained concurrently on this many threads.
+      long&
+      setNumberOfThreads() {
+        return _numberOfThreads;
+      }
+
+      // Seeds the random streams of the trees, so a seed gives the same forest whatever the
+      // number of threads; a negative seed draws one from rand() at every train.
+      long&
+      setRandomSeed() {
+        return _randomSeed;
+      }
+
+    private:
+      void
+      _prepareScoring() {
+        if (_useQuickScorer)
+          _quickScorer.build(_trees.data(), _trees.size(), BaseClassifier::_numberOfFeatures);
+        else
+          _quickScorer.reset();
+
+        vector<double> maxVoteWeights;
+        for (const auto& tree : _trees)
+          maxVoteWeights.push_back(*std::max_element(std::begin(tree._flatLeafValues),
+                                                     std::end(tree._flatLeafValues)));
+        _earlyExitRule.reset(maxVoteWeights);
+      }
+
+      template<class _Criterion>
+      void
+      _trainTrees(const MatrixXd& trainData, const VectorXd& labelData, const VectorXd& weights)
+      {
+        _Criterion criterion{&labelData, BaseClassifier::_numberOfClasses,
+            _criterionWeightsOf(weights)};
+        const long numberOfWorkers =
+          std::max(1L, std::min(_numberOfThreads, static_cast<long>(_trees.size())));
+        vector<_Criterion> criteria(numberOfWorkers, criterion);
+
+        if (_maxNumberOfLeafNodes < 0) {
+          using Builder = _DepthFirstBuilder<_Criterion, _Splitter>;
+          vector<std::unique_ptr<Builder> > builders;
+          for (auto& threadCriterion : criteria)
+            builders.push_back(std::make_unique<Builder>(_minSamplesInALeaf, _minSamplesInANode,
+                                                         _maxDepth, _numberOfFeaturesToSplit,
+                                                         &threadCriterion));
+          _buildTrees(builders, &criteria, trainData, weights);
+        }
+        else {
+          using Builder = _BestFirstBuilder<_Criterion, _Splitter>;
+          vector<std::unique_ptr<Builder> > builders;
+          for (auto& threadCriterion : criteria)
+            builders.push_back(std::make_unique<Builder>(_minSamplesInALeaf, _minSamplesInANode,
+                                                         _maxDepth, _maxNumberOfLeafNodes,
+                                                         _numberOfFeaturesToSplit,
+                                                         &threadCriterion));
+          _buildTrees(builders, &criteria, trainData, weights);
+        }
+      }
+
+      // Every tree draws its bootstrap and splits from its own engine seeded by the forest seed
+      // and the tree index, so the forest does not depend on which thread trains which tree.
+      // The bootstrap is kept as a count per row; the tree is built on the distinct drawn rows
+      // with the counts as weights.
+      template<class BuilderType, class _Criterion>
+      void _buildTrees (const vector<std::unique_ptr<BuilderType> >& builders,
+                        vector<_Criterion>* criteria, const MatrixXd& trainData,
+                        const VectorXd& weights) {
+        const vector<long> trainIndices = _trainIndicesOfWeights(weights, ModelName);
+        const _FeatureStore featureStore(trainData);
+        const long numberOfData = trainIndices.size();
+        vector<vector<uint8_t> > sampleCountsOfThreads(builders.size(),
+                                                       vector<uint8_t>(trainData.rows()));
+        vector<vector<long> > sampleIndicesOfThreads(builders.size());
+        vector<_OutOfBagScratch> outOfBagScratches(_computeOutOfBag ? builders.size() : 0);
+        for (auto& scratch : outOfBagScratches)
+          scratch._votes.setZero(trainData.rows(), BaseClassifier::_numberOfClasses);
+
+        const long numberOfTrees = _trees.size();
+        long firstTreeId = 0;
+        if (_warmStart)
+          while (firstTreeId < numberOfTrees && _trees[firstTreeId]._isFinalized)
+            ++firstTreeId;
+        if (firstTreeId > 0 && _computeOutOfBag && _outOfBagVotes.rows() != trainData.rows()) {
+          throwException("Error happened when warm starting %s: "
+                         "no out-of-bag votes of the trained trees for (%ld) rows",
+                         ModelName, static_cast<long>(trainData.rows()));
+        }
+        if (firstTreeId == 0) {
+          _forestSeed = static_cast<uint32_t>(_randomSeed >= 0 ? _randomSeed : rand());
+          _numberOfSeededTrees = 0;
+        }
+        const uint32_t forestSeed = _forestSeed;
+        // equal to firstTreeId unless prune() dropped trees, whose streams are not reused
+        const long firstSeedId = _numberOfSeededTrees;
+        _numberOfSeededTrees += numberOfTrees-firstTreeId;
+
+        _parallelFor(static_cast<long>(builders.size()), numberOfTrees-firstTreeId,
+                     [&](const long taskId, const long threadId) {
+                       const long treeId = firstTreeId+taskId;
+                       std::seed_seq seeds{forestSeed, static_cast<uint32_t>(firstSeedId+taskId)};
+                       std::mt19937 randomEngine{seeds};
+                       // the tree is built on the distinct drawn rows weighted by their counts,
+                       // so its minimum samples per leaf and node count rows, not draws
+                       vector<uint8_t>& sampleCounts = sampleCountsOfThreads[threadId];
+                       std::fill(std::begin(sampleCounts), std::end(sampleCounts), 0);
+                       for (long drawId = 0; drawId < numberOfData; ++drawId) {
+                         long randomIndex = _randomIndex(&randomEngine, numberOfData);
+                         uint8_t& count = sampleCounts[trainIndices[randomIndex]];
+                         if (count < std::numeric_limits<uint8_t>::max()) ++count;
+                       }
+                       vector<long>& sampleIndicesForThisModel = sampleIndicesOfThreads[threadId];
+                       sampleIndicesForThisModel.clear();
+                       for (long dataId : trainIndices)
+                         if (sampleCounts[dataId] > 0)
+                           sampleIndicesForThisModel.push_back(dataId);
+
+                       (*criteria)[threadId].setSampleCounts(sampleCounts.data());
+                       BuilderType& builder = *builders[threadId];
+                       builder.setRandomEngine(&randomEngine);
+                       _ClassificationTree& tree = _trees[treeId];
+                       tree.reset();
+                       try {
+                         builder.build(featureStore, &tree, &sampleIndicesForThisModel);
+                         tree.finalize();
+                       }
+                       catch(...) {
+                         printf("exception caught when training %s: ", ModelName);
+                         throw;
+                       }
+                       if (_computeOutOfBag)
+                         _voteOutOfBag(tree, trainData, trainIndices, sampleCounts,
+                                       &outOfBagScratches[threadId]);
+                     });
+
+        // the votes are whole numbers, so the sum does not depend on the thread of each tree
+        if (_computeOutOfBag) {
+          if (firstTreeId == 0)
+            _outOfBagVotes.setZero(trainData.rows(), BaseClassifier::_numberOfClasses);
+          for (const auto& scratch : outOfBagScratches)
+            _outOfBagVotes += scratch._votes;
+        }
+      }
+
+      void
+      _checkOutOfBagVotes() const {
+        if (_outOfBagVotes.rows() == 0) {
+          throwException("Error happened when reading the out-of-bag votes of %s: "
+                         "they are dropped by prune() until the forest is trained again.\n",
+                         ModelName);
+        }
+      }
+
+      struct _OutOfBagScratch {
+        vector<long> _rows;
+        vector<long> _rowOffsets;
+        vector<int32_t> _leafIndices;
+        MatrixXd _votes;
+      };
+
+      void
+      _voteOutOfBag(const _ClassificationTree& tree, const MatrixXd& trainData,
+                    const vector<long>& trainIndices, const vector<uint8_t>& sampleCounts,
+                    _OutOfBagScratch* scratch) const
+      {
+        scratch->_rows.clear();
+        scratch->_rowOffsets.clear();
+        for (long dataId : trainIndices)
+          if (sampleCounts[dataId] == 0) {
+            scratch->_rows.push_back(dataId);
+            scratch->_rowOffsets.push_back(dataId*trainData.cols());
           }
+
+        const long numberOfRows = scratch->_rows.size();
+        scratch->_leafIndices.resize(numberOfRows);
+        tree.leafIndicesOf(trainData.data(), scratch->_rowOffsets.data(), numberOfRows,
+                           scratch->_leafIndices.data());
+        for (long rowId = 0; rowId < numberOfRows; ++rowId) {
+          const double* labelsCount = tree.leafValue(scratch->_leafIndices[rowId]);
+          const long label = std::max_element(labelsCount,
+                                              labelsCount+BaseClassifier::_numberOfClasses) -
+            labelsCount;
+          scratch->_votes(scratch->_rows[rowId], label) += 1.0;
         }
       }
 
@@ -166,7 +635,25 @@ namespace Lib15x
       long _numberOfFeaturesToSplit;
       long _maxNumberOfLeafNodes;
       vector<_ClassificationTree> _trees;
+      long _numberOfThreads = 1;
+      long _randomSeed = -1;
+      bool _warmStart = false;
+      uint32_t _forestSeed = 0;
+      long _numberOfSeededTrees = 0;
+      bool _computeOutOfBag = false;
+      MatrixXd _outOfBagVotes;
+      double _outOfBagLoss = 0.0;
+      bool _useQuickScorer = false;
+      _QuickScorer _quickScorer;
+      bool _earlyExit = false;
+      double _earlyExitRisk = 0.0;
+      _EarlyExitRule _earlyExitRule;
     };
+
+    // ExtraTrees: the forest with one random threshold per candidate feature instead of the
+    // best one.
+    template<double (*ImpurityRule)(const vector<double>&) = gini>
+    using ExtraTreesClassifier = RandomForestClassifier<ImpurityRule, _RandomSplitter>;
   }
 }
 
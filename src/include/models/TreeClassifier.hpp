@@ -7,21 +7,25 @@
 #include "../internal/_Builder.hpp"
 #include "../internal/_ClassificationTree.hpp"
 #include "../internal/_ClassificationCriterion.hpp"
+#include "../internal/_EnsemblePrediction.hpp"
+#include "../internal/_CodeGenerator.hpp"
 
 namespace Lib15x
 {
   namespace Models
   {
-    template<double (*ImpurityRule)(const vector<long>&) = gini>
-    class TreeClassifier : public _BaseClassifier<TreeClassifier<ImpurityRule> > {
+    template<double (*ImpurityRule)(const vector<double>&) = gini,
+             template<class Criterion> class _Splitter = _BestSplitter>
+    class TreeClassifier : public _BaseClassifier<TreeClassifier<ImpurityRule, _Splitter> > {
     public:
-      using BaseClassifier = _BaseClassifier<TreeClassifier<ImpurityRule> >;
+      using BaseClassifier = _BaseClassifier<TreeClassifier<ImpurityRule, _Splitter> >;
       using BaseClassifier::train;
       static constexpr const char* ModelName = "TreeClassifier";
       static constexpr double (*LossFunction)(const Labels&, const Labels&) =
         BaseClassifier::LossFunction;
 
       using Criterion = _ClassificationCriterion<ImpurityRule>;
+      using BinaryCriterion = _ClassificationCriterion<ImpurityRule, 2>;
 
       TreeClassifier(const long numberOfFeatures, const long numberOfClasses,
                      const long minSamplesInALeaf=1, const long minSamplesInANode=1,
@@ -53,27 +57,116 @@ namespace Lib15x
         const VectorXd& labelData=trainLabels._labelData;
         assert(weights.size()==trainLabels.size());
 
-        vector<long> trainIndices;
-        for (long dataId=0; dataId<labelData.size(); ++dataId){
-          long dataRepeat=static_cast<long>(weights(dataId));
-          if (static_cast<double>(dataRepeat) != weights(dataId)) {
-            throwException("Error happened in TreeRegressor model: cannot handle general "
-                           "sample weights=%f", weights(dataId));
-          }
-          for (long rep=0; rep<dataRepeat; ++rep)
-            trainIndices.push_back(dataId);
-        }
+        vector<long> trainIndices = _trainIndicesOfWeights(weights, ModelName);
+
+        if (BaseClassifier::_numberOfClasses == 2)
+          _buildTree<BinaryCriterion>(trainData, labelData, weights, &trainIndices);
+        else
+          _buildTree<Criterion>(trainData, labelData, weights, &trainIndices);
+
+        BaseClassifier::_modelTrained = true;
+      }
+
+      double
+      predictOne(const VectorXd& instance) const
+      {
+        assert(BaseClassifier::_modelTrained);
+        const double* labelsCount= _tree.predictOne(instance);
+        auto it=std::max_element(labelsCount, labelsCount+BaseClassifier::_numberOfClasses);
+        long label =(it-labelsCount);
+
+        return static_cast<double>(label);
+      }
+
+      void
+      _predictBatch(const MatrixXd& testData, const vector<long>& testIndices,
+                    VectorXd* predictedLabelData) const
+      {
+        assert(BaseClassifier::_modelTrained);
+        const long numberOfClasses = BaseClassifier::_numberOfClasses;
+        _predictInBlocks(&_tree, 1, testData, testIndices,
+                         [this, &testIndices, predictedLabelData, numberOfClasses]
+                         (const long treeId, const long blockStart,
+                          const long numberOfRowsInBlock, const int32_t* leafIndices) {
+                           ignoreUnusedVariable(treeId);
+                           for (long rowId = 0; rowId < numberOfRowsInBlock; ++rowId) {
+                             const double* labelsCount = _tree.leafValue(leafIndices[rowId]);
+                             auto it = std::max_element(labelsCount,
+                                                        labelsCount+numberOfClasses);
+                             (*predictedLabelData)(testIndices[blockStart+rowId]) =
+                               static_cast<double>(it-labelsCount);
+                           }
+                         },
+                         [](const long blockStart, const long numberOfRowsInBlock) {
+                           ignoreUnusedVariables(blockStart, numberOfRowsInBlock);
+                         });
+      }
+
+      // Writes a standalone C++ file defining extern "C" double functionName(const double*),
+      // which returns the same label as predictOne for a row of numberOfFeatures values.
+      void
+      generateCode(std::ostream& out, const std::string& functionName,
+                   const long maxBranchDepth=64) const
+      {
+        assert(BaseClassifier::_modelTrained);
+        _writeTreesCode(out, ModelName, &_tree, 1, maxBranchDepth);
+        _writeClassifierCode(out, functionName, 1, BaseClassifier::_numberOfClasses);
+      }
+
+      // Lays out the nodes so the branch the rows of sampleData take more often follows its
+      // parent in memory. Labels do not change.
+      void
+      reorderNodesByPaths(const MatrixXd& sampleData)
+      {
+        assert(BaseClassifier::_modelTrained);
+        _reorderNodesByPaths(&_tree, 1, sampleData);
+      }
+
+      void
+      _clearModel()
+      {
+        _tree.reset();
+      }
 
-        Criterion criterion{&labelData, BaseClassifier::_numberOfClasses};
+      long&
+      setNumberOfThreads()
+      {
+        return _numberOfThreads;
+      }
 
+      long&
+      setNumberOfSplitThreads()
+      {
+        return _numberOfSplitThreads;
+      }
+
+      // Subtrees with fewer samples than this are built by the thread that split their parent.
+      long&
+      setMinSamplesInAParallelTask()
+      {
+        return _minSamplesInAParallelTask;
+      }
+
+    private:
+      template<class _Criterion>
+      void
+      _buildTree(const MatrixXd& trainData, const VectorXd& labelData, const VectorXd& weights,
+                 vector<long>* trainIndices)
+      {
+        _Criterion criterion{&labelData, BaseClassifier::_numberOfClasses,
+            _criterionWeightsOf(weights)};
+
+        _tree.reset();
         if (_maxNumberOfLeafNodes < 0) {
-          _DepthFirstBuilder<Criterion, _BestSplitter> builder(_minSamplesInALeaf,
+          _DepthFirstBuilder<_Criterion, _Splitter> builder(_minSamplesInALeaf,
                                                                _minSamplesInANode,
                                                                _maxDepth,
                                                                BaseClassifier::_numberOfFeatures,
-                                                               &criterion);
+                                                               &criterion, _numberOfThreads,
+                                                               _minSamplesInAParallelTask,
+                                                               _numberOfSplitThreads);
           try {
-            builder.build(trainData, &_tree, &trainIndices);
+            builder.build(trainData, &_tree, trainIndices);
           }
           catch (...) {
             cout<<"exception caught when training tree classifier: "<<endl;
@@ -81,49 +174,37 @@ namespace Lib15x
           }
         }
         else {
-          _BestFirstBuilder<Criterion, _BestSplitter> builder(_minSamplesInALeaf,
+          _BestFirstBuilder<_Criterion, _Splitter> builder(_minSamplesInALeaf,
                                                               _minSamplesInANode,
                                                               _maxDepth,
                                                               _maxNumberOfLeafNodes,
                                                               BaseClassifier::_numberOfFeatures,
-                                                              &criterion);
+                                                              &criterion,
+                                                              _numberOfSplitThreads);
           try {
-            builder.build(trainData, &_tree, &trainIndices);
+            builder.build(trainData, &_tree, trainIndices);
           }
           catch (...) {
             cout<<"exception caught when training tree classifier: "<<endl;
             throw;
           }
         }
-
-        BaseClassifier::_modelTrained = true;
+        _tree.finalize();
       }
 
-      double
-      predictOne(const VectorXd& instance) const
-      {
-        assert(BaseClassifier::_modelTrained);
-        vector<long> labelsCount= _tree.predictOne(instance);
-        assert(static_cast<long>(labelsCount.size())==BaseClassifier::_numberOfClasses);
-        auto it=std::max_element(std::begin(labelsCount), std::end(labelsCount));
-        long label =(it-std::begin(labelsCount));
-
-        return static_cast<double>(label);
-      }
-
-      void
-      _clearModel()
-      {
-        _tree.reset();
-      }
-
-    private:
       long _minSamplesInALeaf;
       long _minSamplesInANode;
       long _maxDepth;
       long _maxNumberOfLeafNodes;
+      long _numberOfThreads=1;
+      long _minSamplesInAParallelTask=10000;
+      long _numberOfSplitThreads=1;
       _ClassificationTree _tree;
     };
+
+    // A single extremely randomized tree, e.g. as the base model of BaggingClassifier.
+    template<double (*ImpurityRule)(const vector<double>&) = gini>
+    using ExtraTreeClassifier = TreeClassifier<ImpurityRule, _RandomSplitter>;
   }
 }
 
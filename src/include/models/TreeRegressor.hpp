@@ -7,14 +7,17 @@
 #include "../internal/_Builder.hpp"
 #include "../internal/_RegressionTree.hpp"
 #include "../internal/_RegressionCriterion.hpp"
+#include "../internal/_EnsemblePrediction.hpp"
+#include "../internal/_CodeGenerator.hpp"
 
 namespace Lib15x
 {
   namespace Models
   {
-    class TreeRegressor : public _BaseRegressor<TreeRegressor> {
+    template<template<class Criterion> class _Splitter = _BestSplitter>
+    class TreeRegressor : public _BaseRegressor<TreeRegressor<_Splitter> > {
     public:
-      using BaseRegressor = _BaseRegressor<TreeRegressor>;
+      using BaseRegressor = _BaseRegressor<TreeRegressor<_Splitter> >;
       using BaseRegressor::train;
       static constexpr const char* ModelName = "TreeRegressor";
       static constexpr double (*LossFunction)(const Labels&, const Labels&) =
@@ -52,25 +55,19 @@ namespace Lib15x
         const VectorXd& labelData=trainLabels._labelData;
         assert(weights.size()==labelData.size());
 
-        vector<long> trainIndices;
-        for (long dataId=0; dataId<labelData.size(); ++dataId){
-          long dataRepeat=static_cast<long>(weights(dataId));
-          if (static_cast<double>(dataRepeat) != weights(dataId)) {
-            throwException("Error happened in TreeRegressor model: cannot handle general "
-                           "sample weights=%f", weights(dataId));
-          }
-          for (long rep=0; rep<dataRepeat; ++rep)
-            trainIndices.push_back(dataId);
-        }
+        vector<long> trainIndices = _trainIndicesOfWeights(weights, ModelName);
 
-        Criterion criterion{&labelData};
+        Criterion criterion{&labelData, _criterionWeightsOf(weights)};
 
+        _tree.reset();
         if (_maxNumberOfLeafNodes < 0) {
-          _DepthFirstBuilder<Criterion, _BestSplitter> builder(_minSamplesInALeaf,
+          _DepthFirstBuilder<Criterion, _Splitter> builder(_minSamplesInALeaf,
                                                                _minSamplesInANode,
                                                                _maxDepth,
                                                                BaseRegressor::_numberOfFeatures,
-                                                               &criterion);
+                                                               &criterion, _numberOfThreads,
+                                                               _minSamplesInAParallelTask,
+                                                               _numberOfSplitThreads);
           try {
             builder.build(trainData, &_tree, &trainIndices);
           }
@@ -80,12 +77,13 @@ namespace Lib15x
           }
         }
         else {
-          _BestFirstBuilder<Criterion, _BestSplitter> builder(_minSamplesInALeaf,
+          _BestFirstBuilder<Criterion, _Splitter> builder(_minSamplesInALeaf,
                                                               _minSamplesInANode,
                                                               _maxDepth,
                                                               _maxNumberOfLeafNodes,
                                                               BaseRegressor::_numberOfFeatures,
-                                                              &criterion);
+                                                              &criterion,
+                                                              _numberOfSplitThreads);
           try {
             builder.build(trainData, &_tree, &trainIndices);
           }
@@ -94,6 +92,7 @@ namespace Lib15x
             throw;
           }
         }
+        _tree.finalize();
 
         BaseRegressor::_modelTrained = true;
       }
@@ -106,19 +105,82 @@ namespace Lib15x
         return label;
       }
 
+      void
+      _predictBatch(const MatrixXd& testData, const vector<long>& testIndices,
+                    VectorXd* predictedLabelData) const
+      {
+        assert(BaseRegressor::_modelTrained);
+        _predictInBlocks(&_tree, 1, testData, testIndices,
+                         [this, &testIndices, predictedLabelData]
+                         (const long treeId, const long blockStart,
+                          const long numberOfRowsInBlock, const int32_t* leafIndices) {
+                           ignoreUnusedVariable(treeId);
+                           for (long rowId = 0; rowId < numberOfRowsInBlock; ++rowId)
+                             (*predictedLabelData)(testIndices[blockStart+rowId]) =
+                               _tree.leafValue(leafIndices[rowId]);
+                         },
+                         [](const long blockStart, const long numberOfRowsInBlock) {
+                           ignoreUnusedVariables(blockStart, numberOfRowsInBlock);
+                         });
+      }
+
+      // Writes a standalone C++ file defining extern "C" double functionName(const double*),
+      // which returns the same label as predictOne for a row of numberOfFeatures values.
+      void
+      generateCode(std::ostream& out, const std::string& functionName,
+                   const long maxBranchDepth=64) const
+      {
+        assert(BaseRegressor::_modelTrained);
+        _writeTreesCode(out, ModelName, &_tree, 1, maxBranchDepth);
+        _writeRegressorCode(out, functionName, 1);
+      }
+
+      // Lays out the nodes so the branch the rows of sampleData take more often follows its
+      // parent in memory. Labels do not change.
+      void
+      reorderNodesByPaths(const MatrixXd& sampleData)
+      {
+        assert(BaseRegressor::_modelTrained);
+        _reorderNodesByPaths(&_tree, 1, sampleData);
+      }
+
       void
       _clearModel()
       {
         _tree.reset();
       }
 
+      long&
+      setNumberOfThreads()
+      {
+        return _numberOfThreads;
+      }
+
+      long&
+      setNumberOfSplitThreads()
+      {
+        return _numberOfSplitThreads;
+      }
+
+      // Subtrees with fewer samples than this are built by the thread that split their parent.
+      long&
+      setMinSamplesInAParallelTask()
+      {
+        return _minSamplesInAParallelTask;
+      }
+
     private:
       long _minSamplesInALeaf;
       long _minSamplesInANode;
       long _maxDepth;
       long _maxNumberOfLeafNodes;
+      long _numberOfThreads=1;
+      long _minSamplesInAParallelTask=10000;
+      long _numberOfSplitThreads=1;
       _RegressionTree _tree;
     };
+
+    using ExtraTreeRegressor = TreeRegressor<_RandomSplitter>;
   }
 }
 
@@ -1,5 +1,6 @@
 #include "./BaggingClassifier.hpp"
 #include "./GradientBoostingRegressor.hpp"
+#include "./HoeffdingForestClassifier.hpp"
 #include "./LibSVM.hpp"
 #include "./LinearLogisticRegression.hpp"
 #include "./LinearRidgeRegression.hpp"
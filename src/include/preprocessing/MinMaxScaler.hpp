@@ -28,11 +28,13 @@ namespace Lib15x
       void fit(const MatrixXd& data)
       {
         _numberOfFeatures = data.cols();
-        _colMax.resize(_numberOfFeatures);
-        _colMin.resize(_numberOfFeatures);
+        _colMax=data.row(0).transpose();
+        _colMin=data.row(0).transpose();
+        for (long dataIndex=1; dataIndex<data.rows(); ++dataIndex){
+          _colMax=_colMax.cwiseMax(data.row(dataIndex).transpose());
+          _colMin=_colMin.cwiseMin(data.row(dataIndex).transpose());
+        }
         for (long featIndex=0; featIndex<_numberOfFeatures; ++featIndex){
-          _colMax(featIndex)=data.col(featIndex).maxCoeff();
-          _colMin(featIndex)=data.col(featIndex).minCoeff();
           if (_colMax(featIndex)==_colMin(featIndex))
             printf("Warning from MinMax scaler: "
                    "I found the data for feature No.(%ld) are the same.", featIndex);
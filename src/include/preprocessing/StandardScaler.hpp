@@ -35,14 +35,16 @@ namespace Lib15x
                          numberOfData);
         }
 
-        _colMean.resize(_numberOfFeatures);
-        _colStd.resize(_numberOfFeatures);
+        _colMean=VectorXd::Zero(_numberOfFeatures);
+        _colStd=VectorXd::Zero(_numberOfFeatures);
+        for (long dataIndex=0; dataIndex<numberOfData; ++dataIndex)
+          _colMean+=data.row(dataIndex).transpose();
+        _colMean/=static_cast<double>(numberOfData);
+        for (long dataIndex=0; dataIndex<numberOfData; ++dataIndex)
+          _colStd+=(data.row(dataIndex).transpose()-_colMean).array().square().matrix();
+
         for (long featIndex=0; featIndex<_numberOfFeatures; ++featIndex){
-          double mean=data.col(featIndex).mean();
-          _colMean(featIndex)=mean;
-          double var=0;
-          for (long dataIndex=0; dataIndex<numberOfData; ++dataIndex)
-            var+=(data(dataIndex,featIndex)-mean)*(data(dataIndex,featIndex)-mean);
+          double var=_colStd(featIndex);
           if (var==0.0)
             printf("Warning from MinMax scaler: "
                    "I found the data for feature No.(%ld) are the same.", featIndex);
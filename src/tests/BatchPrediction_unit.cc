@@ -0,0 +1,63 @@
+#include <core/Definitions.hpp>
+#include <core/Utilities.hpp>
+#include <models/TreeClassifier.hpp>
+#include <models/TreeRegressor.hpp>
+#include <models/RandomForestClassifier.hpp>
+#include <models/GradientBoostingRegressor.hpp>
+#include <gtest/gtest.h>
+
+using namespace Lib15x;
+
+template<class LearningModel>
+void checkBatchPrediction(LearningModel* learningModel, const ProblemType problemType)
+{
+  const long numberOfFeatures=learningModel->getNumberOfFeatures();
+  const long numberOfData=3000;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  Labels labels{problemType};
+  labels._labelData.resize(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    labels._labelData(dataId)=(trainData(dataId, 0)+trainData(dataId, 1)*trainData(dataId, 2) > 0)+
+      (problemType == ProblemType::Classification ? 0.0 : 0.1*trainData(dataId, 3));
+  // trained twice so the second build starts from finalized trees
+  learningModel->train(trainData, labels);
+  learningModel->train(trainData, labels);
+
+  MatrixXd testData=MatrixXd::Random(2*numberOfData+3, numberOfFeatures);
+  testData(0, 0)=std::numeric_limits<double>::quiet_NaN();
+  Labels predictedLabels=learningModel->predict(testData);
+  for (long dataId=0; dataId<testData.rows(); ++dataId){
+    Map<const VectorXd> instance(&testData(dataId, 0), numberOfFeatures);
+    EXPECT_EQ(learningModel->predictOne(instance), predictedLabels._labelData(dataId));
+  }
+
+  vector<long> testIndices;
+  for (long dataId=testData.rows()-1; dataId>=0; dataId-=3)
+    testIndices.push_back(dataId);
+  Labels partialLabels=learningModel->predict(testData, testIndices);
+  for (auto dataId : testIndices)
+    EXPECT_EQ(predictedLabels._labelData(dataId), partialLabels._labelData(dataId));
+}
+
+TEST(BatchPrediction, Trees_test)
+{
+  const long numberOfFeatures=5;
+  Models::TreeClassifier<> treeClassifier{numberOfFeatures, 2};
+  checkBatchPrediction(&treeClassifier, ProblemType::Classification);
+
+  Models::TreeRegressor<> treeRegressor{numberOfFeatures, 3};
+  checkBatchPrediction(&treeRegressor, ProblemType::Regression);
+}
+
+TEST(BatchPrediction, Ensembles_test)
+{
+  const long numberOfFeatures=5;
+  Models::RandomForestClassifier<> randomForest{numberOfFeatures, 2, 20};
+  checkBatchPrediction(&randomForest, ProblemType::Classification);
+  randomForest.setEarlyExit()=true;
+  randomForest.setEarlyExitRisk()=0.01;
+  checkBatchPrediction(&randomForest, ProblemType::Classification);
+
+  Models::GradientBoostingRegressor gradientBoosting{numberOfFeatures, 10, 3, 1, 6};
+  checkBatchPrediction(&gradientBoosting, ProblemType::Regression);
+}
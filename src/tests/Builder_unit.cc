@@ -0,0 +1,551 @@
+#include <core/Definitions.hpp>
+#include <core/Utilities.hpp>
+#include <internal/_Builder.hpp>
+#include <internal/_ClassificationTree.hpp>
+#include <internal/_ClassificationCriterion.hpp>
+#include <internal/_RegressionTree.hpp>
+#include <internal/_RegressionCriterion.hpp>
+#include <models/RandomForestClassifier.hpp>
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace Lib15x;
+
+TEST(Builder, ParallelDepthFirstBuilder_test)
+{
+  using Criterion=_ClassificationCriterion<gini>;
+
+  const long numberOfFeatures=3;
+  const long numberOfData=2000;
+  const long numberOfClasses=4;
+  const long numberOfThreads=4;
+  const long minSamplesInAParallelTask=20;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  VectorXd labelData(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    labelData(dataId)=rand() % numberOfClasses;
+
+  vector<long> sampleIndices(numberOfData);
+  std::iota(std::begin(sampleIndices), std::end(sampleIndices), 0);
+
+  Criterion criterion{&labelData, numberOfClasses};
+  _ClassificationTree tree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _PresortBestSplitter>
+    builder(1, 1, std::numeric_limits<long>::max(), numberOfFeatures, &criterion,
+            numberOfThreads, minSamplesInAParallelTask);
+  builder.build(trainData, &tree, &sampleIndices);
+
+  EXPECT_EQ(tree._nodeCount, static_cast<long>(tree._nodes.size()));
+  EXPECT_EQ(tree._nodeCount, 2*static_cast<long>(tree._leafNodeToLabel.size())-1);
+  tree.finalize();
+  for (long dataId=0; dataId<numberOfData; ++dataId){
+    Map<const VectorXd> instance(&trainData(dataId, 0), numberOfFeatures);
+    const double* labelsCount=tree.predictOne(instance);
+    EXPECT_EQ(labelsCount[static_cast<long>(labelData(dataId))],
+              std::accumulate(labelsCount, labelsCount+numberOfClasses, 0.0));
+  }
+}
+
+std::string
+codeOfParallelBuild(const MatrixXd& trainData, const VectorXd& labelData,
+                    const long numberOfThreads)
+{
+  const long numberOfFeatures=trainData.cols();
+  vector<long> sampleIndices(trainData.rows());
+  std::iota(std::begin(sampleIndices), std::end(sampleIndices), 0);
+
+  _RegressionCriterion criterion{&labelData};
+  _RegressionTree tree{numberOfFeatures};
+  _DepthFirstBuilder<_RegressionCriterion, _BestSplitter>
+    builder(20, 40, std::numeric_limits<long>::max(), numberOfFeatures, &criterion,
+            numberOfThreads, 50);
+  builder.build(trainData, &tree, &sampleIndices);
+  tree.finalize();
+  std::ostringstream code;
+  _writeTreesCode(code, "TreeRegressor", &tree, 1, 64);
+  return code.str();
+}
+
+TEST(Builder, ParallelMatchesSerialBuild_test)
+{
+  const long numberOfFeatures=8;
+  const long numberOfData=4000;
+  // the discrete features turn constant below the nodes split on them; continuous labels
+  // keep the best split of a node unique whatever order the features are tried in
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  VectorXd labelData(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId){
+    for (long featureId=0; featureId<6; ++featureId)
+      trainData(dataId, featureId)=static_cast<double>(rand() % (2+featureId%2));
+    labelData(dataId)=trainData(dataId, 0)+trainData(dataId, 1)*trainData(dataId, 3)+
+      trainData(dataId, 2)*trainData(dataId, 6)+0.5*trainData(dataId, 4)*trainData(dataId, 5)+
+      0.3*trainData(dataId, 7);
+  }
+
+  const std::string serialCode=codeOfParallelBuild(trainData, labelData, 1);
+  for (long repeat=0; repeat<10; ++repeat)
+    EXPECT_EQ(serialCode, codeOfParallelBuild(trainData, labelData, 4));
+}
+
+TEST(Builder, LevelWiseBuilder_test)
+{
+  using Criterion=_ClassificationCriterion<gini>;
+
+  const long numberOfFeatures=4;
+  const long numberOfData=1000;
+  const long numberOfClasses=3;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  VectorXd labelData(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    labelData(dataId)=rand() % numberOfClasses;
+
+  vector<long> sampleIndices;
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    sampleIndices.push_back(rand() % numberOfData);
+  vector<long> levelWiseSampleIndices=sampleIndices;
+  vector<long> parallelSampleIndices=sampleIndices;
+  vector<long> batchedSampleIndices=sampleIndices;
+
+  Criterion criterion{&labelData, numberOfClasses};
+  _ClassificationTree tree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _HistogramSplitter>
+    builder(20, 1, 5, numberOfFeatures, &criterion);
+  srand(15);
+  builder.build(trainData, &tree, &sampleIndices);
+
+  _ClassificationTree levelWiseTree{numberOfFeatures, numberOfClasses};
+  _LevelWiseBuilder<Criterion> levelWiseBuilder(20, 1, 5, numberOfFeatures, &criterion);
+  srand(15);
+  levelWiseBuilder.build(trainData, &levelWiseTree, &levelWiseSampleIndices);
+
+  _ClassificationTree parallelTree{numberOfFeatures, numberOfClasses};
+  _LevelWiseBuilder<Criterion> parallelBuilder(20, 1, 5, numberOfFeatures, &criterion, 3);
+  srand(15);
+  parallelBuilder.build(trainData, &parallelTree, &parallelSampleIndices);
+
+  // deeper levels are split three nodes at a time
+  _ClassificationTree batchedTree{numberOfFeatures, numberOfClasses};
+  _LevelWiseBuilder<Criterion> batchedBuilder(20, 1, 5, numberOfFeatures, &criterion, 2);
+  batchedBuilder.setMaxNodesInABatch()=3;
+  srand(15);
+  batchedBuilder.build(trainData, &batchedTree, &batchedSampleIndices);
+
+  EXPECT_EQ(tree._nodeCount, levelWiseTree._nodeCount);
+  EXPECT_EQ(tree._maxDepthOfThisTree, levelWiseTree._maxDepthOfThisTree);
+  EXPECT_EQ(levelWiseSampleIndices, parallelSampleIndices);
+  ASSERT_EQ(levelWiseTree._nodeCount, parallelTree._nodeCount);
+  for (long nodeId=0; nodeId<levelWiseTree._nodeCount; ++nodeId){
+    EXPECT_EQ(levelWiseTree._nodes[nodeId]._featureIndex, parallelTree._nodes[nodeId]._featureIndex);
+    EXPECT_EQ(levelWiseTree._nodes[nodeId]._threshold, parallelTree._nodes[nodeId]._threshold);
+  }
+  EXPECT_EQ(levelWiseSampleIndices, batchedSampleIndices);
+  ASSERT_EQ(levelWiseTree._nodeCount, batchedTree._nodeCount);
+  for (long nodeId=0; nodeId<levelWiseTree._nodeCount; ++nodeId){
+    EXPECT_EQ(levelWiseTree._nodes[nodeId]._featureIndex, batchedTree._nodes[nodeId]._featureIndex);
+    EXPECT_EQ(levelWiseTree._nodes[nodeId]._threshold, batchedTree._nodes[nodeId]._threshold);
+  }
+  tree.finalize();
+  levelWiseTree.finalize();
+  for (long dataId=0; dataId<numberOfData; ++dataId){
+    Map<const VectorXd> instance(&trainData(dataId, 0), numberOfFeatures);
+    const double* labelsCount=tree.predictOne(instance);
+    const double* levelWiseLabelsCount=levelWiseTree.predictOne(instance);
+    EXPECT_EQ(vector<double>(labelsCount, labelsCount+numberOfClasses),
+              vector<double>(levelWiseLabelsCount, levelWiseLabelsCount+numberOfClasses));
+  }
+}
+
+TEST(Builder, ReusedBuilder_test)
+{
+  using Criterion=_ClassificationCriterion<gini>;
+
+  const long numberOfFeatures=4;
+  const long numberOfData=500;
+  const long numberOfClasses=3;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  MatrixXd otherTrainData=MatrixXd::Random(2*numberOfData, numberOfFeatures);
+  VectorXd labelData(2*numberOfData);
+  for (long dataId=0; dataId<2*numberOfData; ++dataId)
+    labelData(dataId)=rand() % numberOfClasses;
+
+  vector<long> sampleIndices(numberOfData);
+  std::iota(std::begin(sampleIndices), std::end(sampleIndices), 0);
+  vector<long> otherSampleIndices;
+  for (long dataId=0; dataId<2*numberOfData; ++dataId)
+    otherSampleIndices.push_back(rand() % (2*numberOfData));
+  vector<long> freshSampleIndices=otherSampleIndices;
+
+  Criterion criterion{&labelData, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _PresortBestSplitter>
+    builder(1, 1, std::numeric_limits<long>::max(), 2, &criterion);
+  _ClassificationTree tree{numberOfFeatures, numberOfClasses};
+  builder.build(trainData, &tree, &sampleIndices);
+  tree.reset();
+  srand(15);
+  builder.build(otherTrainData, &tree, &otherSampleIndices);
+
+  _DepthFirstBuilder<Criterion, _PresortBestSplitter>
+    freshBuilder(1, 1, std::numeric_limits<long>::max(), 2, &criterion);
+  _ClassificationTree freshTree{numberOfFeatures, numberOfClasses};
+  srand(15);
+  freshBuilder.build(otherTrainData, &freshTree, &freshSampleIndices);
+
+  ASSERT_EQ(freshTree._nodeCount, tree._nodeCount);
+  EXPECT_EQ(freshTree._nodeCount, static_cast<long>(tree._nodes.size()));
+  for (long nodeId=0; nodeId<tree._nodeCount; ++nodeId){
+    EXPECT_EQ(freshTree._nodes[nodeId]._featureIndex, tree._nodes[nodeId]._featureIndex);
+    EXPECT_EQ(freshTree._nodes[nodeId]._threshold, tree._nodes[nodeId]._threshold);
+  }
+  EXPECT_EQ(freshTree._leafNodeToLabel, tree._leafNodeToLabel);
+}
+
+TEST(Builder, FeatureStore_test)
+{
+  const long numberOfFeatures=3;
+  const long numberOfData=50;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+
+  _FeatureStore featureStore(trainData);
+  ASSERT_EQ(featureStore.rows(), numberOfData);
+  ASSERT_EQ(featureStore.cols(), numberOfFeatures);
+  for (long featId=0; featId<numberOfFeatures; ++featId)
+    for (long dataId=0; dataId<numberOfData; ++dataId)
+      EXPECT_EQ(featureStore.column(featId)[dataId], trainData(dataId, featId));
+
+  const auto& binnedData=featureStore.binnedData<uint8_t>();
+  EXPECT_EQ(&binnedData, &featureStore.binnedData<uint8_t>());
+  EXPECT_EQ(binnedData.numberOfBins(0), numberOfData);
+}
+
+template<double (*ImpurityRule)(const vector<double>&)>
+void checkFixedClassCountCriterion()
+{
+  using Criterion=_ClassificationCriterion<ImpurityRule>;
+  using BinaryCriterion=_ClassificationCriterion<ImpurityRule, 2>;
+
+  const long numberOfFeatures=4;
+  const long numberOfData=3000;
+  const long numberOfClasses=2;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  VectorXd labelData(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    labelData(dataId)=(trainData(dataId, 0)+0.5*trainData(dataId, 1)+0.2*(rand()%5) > 0.4);
+
+  vector<long> sampleIndices(numberOfData);
+  std::iota(std::begin(sampleIndices), std::end(sampleIndices), 0);
+  vector<long> binarySampleIndices=sampleIndices;
+
+  Criterion criterion{&labelData, numberOfClasses};
+  _ClassificationTree tree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _BestSplitter>
+    builder(1, 1, std::numeric_limits<long>::max(), numberOfFeatures, &criterion);
+  srand(7);
+  builder.build(trainData, &tree, &sampleIndices);
+
+  BinaryCriterion binaryCriterion{&labelData, numberOfClasses};
+  _ClassificationTree binaryTree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<BinaryCriterion, _BestSplitter>
+    binaryBuilder(1, 1, std::numeric_limits<long>::max(), numberOfFeatures, &binaryCriterion);
+  srand(7);
+  binaryBuilder.build(trainData, &binaryTree, &binarySampleIndices);
+
+  ASSERT_EQ(tree._nodeCount, binaryTree._nodeCount);
+  for (long nodeId=0; nodeId<tree._nodeCount; ++nodeId){
+    EXPECT_EQ(tree._nodes[nodeId]._featureIndex, binaryTree._nodes[nodeId]._featureIndex);
+    EXPECT_EQ(tree._nodes[nodeId]._threshold, binaryTree._nodes[nodeId]._threshold);
+  }
+  EXPECT_EQ(tree._leafNodeToLabel, binaryTree._leafNodeToLabel);
+
+  EXPECT_THROW((BinaryCriterion{&labelData, 3}), std::exception);
+}
+
+TEST(Builder, FixedClassCountCriterion_test)
+{
+  checkFixedClassCountCriterion<gini>();
+  checkFixedClassCountCriterion<entropy>();
+}
+
+template<template<class> class _Splitter>
+void checkWeightedCriterion()
+{
+  using Criterion=_ClassificationCriterion<gini>;
+  using RegressionCriterion=_RegressionCriterion;
+
+  const long numberOfFeatures=4;
+  const long numberOfData=2000;
+  const long numberOfClasses=3;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  VectorXd labelData(numberOfData);
+  VectorXd weights(numberOfData);
+  vector<long> repeatedIndices;
+  vector<long> weightedIndices;
+  for (long dataId=0; dataId<numberOfData; ++dataId){
+    labelData(dataId)=rand() % numberOfClasses;
+    long repeat=rand() % 4;
+    weights(dataId)=0.5*static_cast<double>(repeat);
+    for (long rep=0; rep<repeat; ++rep)
+      repeatedIndices.push_back(dataId);
+    if (repeat > 0)
+      weightedIndices.push_back(dataId);
+  }
+
+  Criterion criterion{&labelData, numberOfClasses};
+  _ClassificationTree tree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _Splitter>
+    builder(1, 1, std::numeric_limits<long>::max(), numberOfFeatures, &criterion);
+  srand(9);
+  builder.build(trainData, &tree, &repeatedIndices);
+
+  Criterion weightedCriterion{&labelData, numberOfClasses, &weights};
+  _ClassificationTree weightedTree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _Splitter>
+    weightedBuilder(1, 1, std::numeric_limits<long>::max(), numberOfFeatures, &weightedCriterion);
+  srand(9);
+  weightedBuilder.build(trainData, &weightedTree, &weightedIndices);
+
+  ASSERT_EQ(tree._nodeCount, weightedTree._nodeCount);
+  for (long nodeId=0; nodeId<tree._nodeCount; ++nodeId){
+    EXPECT_EQ(tree._nodes[nodeId]._featureIndex, weightedTree._nodes[nodeId]._featureIndex);
+    EXPECT_EQ(tree._nodes[nodeId]._threshold, weightedTree._nodes[nodeId]._threshold);
+  }
+  ASSERT_EQ(tree._leafNodeToLabel.size(), weightedTree._leafNodeToLabel.size());
+  for (size_t leafId=0; leafId<tree._leafNodeToLabel.size(); ++leafId)
+    for (long classId=0; classId<numberOfClasses; ++classId)
+      EXPECT_EQ(0.5*tree._leafNodeToLabel[leafId].second[classId],
+                weightedTree._leafNodeToLabel[leafId].second[classId]);
+
+  VectorXd regressionLabels=VectorXd::Random(numberOfData);
+  VectorXd doubledWeights=VectorXd::Constant(numberOfData, 2.0);
+  vector<long> sampleIndices(numberOfData);
+  std::iota(std::begin(sampleIndices), std::end(sampleIndices), 0);
+  vector<long> doubledSampleIndices=sampleIndices;
+
+  RegressionCriterion regressionCriterion{&regressionLabels};
+  _RegressionTree regressionTree{numberOfFeatures};
+  _DepthFirstBuilder<RegressionCriterion, _Splitter>
+    regressionBuilder(5, 1, 8, numberOfFeatures, &regressionCriterion);
+  srand(9);
+  regressionBuilder.build(trainData, &regressionTree, &sampleIndices);
+
+  RegressionCriterion doubledCriterion{&regressionLabels, &doubledWeights};
+  _RegressionTree doubledTree{numberOfFeatures};
+  _DepthFirstBuilder<RegressionCriterion, _Splitter>
+    doubledBuilder(5, 1, 8, numberOfFeatures, &doubledCriterion);
+  srand(9);
+  doubledBuilder.build(trainData, &doubledTree, &doubledSampleIndices);
+
+  ASSERT_EQ(regressionTree._nodeCount, doubledTree._nodeCount);
+  for (long nodeId=0; nodeId<regressionTree._nodeCount; ++nodeId)
+    EXPECT_EQ(regressionTree._nodes[nodeId]._threshold, doubledTree._nodes[nodeId]._threshold);
+  EXPECT_EQ(regressionTree._leafNodeToLabel, doubledTree._leafNodeToLabel);
+}
+
+TEST(Builder, WeightedCriterion_test)
+{
+  checkWeightedCriterion<_BestSplitter>();
+  checkWeightedCriterion<_PresortBestSplitter>();
+  checkWeightedCriterion<_HistogramSplitter>();
+}
+
+template<template<class> class _Splitter>
+void checkSampleCounts()
+{
+  using Criterion=_ClassificationCriterion<gini>;
+
+  // a forest bootstrap, once as drawn indices and once as counts of the distinct rows; with
+  // one sample per leaf and node the minima do not tell draws from distinct rows apart
+  const long numberOfFeatures=4;
+  const long numberOfData=2000;
+  const long numberOfClasses=3;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  VectorXd labelData(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    labelData(dataId)=rand() % numberOfClasses;
+  vector<long> drawnIndices;
+  vector<uint8_t> sampleCounts(numberOfData, 0);
+  for (long drawId=0; drawId<numberOfData; ++drawId){
+    const long dataId=rand() % numberOfData;
+    drawnIndices.push_back(dataId);
+    ++sampleCounts[dataId];
+  }
+  std::sort(std::begin(drawnIndices), std::end(drawnIndices));
+  vector<long> countedIndices;
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    if (sampleCounts[dataId] > 0)
+      countedIndices.push_back(dataId);
+
+  Criterion criterion{&labelData, numberOfClasses};
+  _ClassificationTree tree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _Splitter>
+    builder(1, 1, std::numeric_limits<long>::max(), numberOfFeatures, &criterion);
+  srand(9);
+  builder.build(trainData, &tree, &drawnIndices);
+
+  Criterion countedCriterion{&labelData, numberOfClasses};
+  countedCriterion.setSampleCounts(sampleCounts.data());
+  _ClassificationTree countedTree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _Splitter>
+    countedBuilder(1, 1, std::numeric_limits<long>::max(), numberOfFeatures, &countedCriterion);
+  srand(9);
+  countedBuilder.build(trainData, &countedTree, &countedIndices);
+
+  ASSERT_EQ(tree._nodeCount, countedTree._nodeCount);
+  for (long nodeId=0; nodeId<tree._nodeCount; ++nodeId){
+    EXPECT_EQ(tree._nodes[nodeId]._featureIndex, countedTree._nodes[nodeId]._featureIndex);
+    EXPECT_EQ(tree._nodes[nodeId]._threshold, countedTree._nodes[nodeId]._threshold);
+  }
+  EXPECT_EQ(tree._leafNodeToLabel, countedTree._leafNodeToLabel);
+}
+
+TEST(Builder, SampleCounts_test)
+{
+  checkSampleCounts<_BestSplitter>();
+  checkSampleCounts<_PresortBestSplitter>();
+  checkSampleCounts<_HistogramSplitter>();
+  checkSampleCounts<_RandomSplitter>();
+}
+
+TEST(Builder, FinalizedTree_test)
+{
+  using Criterion=_ClassificationCriterion<gini>;
+
+  const long numberOfFeatures=5;
+  const long numberOfData=3000;
+  const long numberOfClasses=3;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  VectorXd labelData(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    labelData(dataId)=rand() % numberOfClasses;
+
+  vector<long> sampleIndices(numberOfData);
+  std::iota(std::begin(sampleIndices), std::end(sampleIndices), 0);
+
+  Criterion criterion{&labelData, numberOfClasses};
+  _ClassificationTree tree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _BestSplitter>
+    builder(1, 1, std::numeric_limits<long>::max(), numberOfFeatures, &criterion);
+  builder.build(trainData, &tree, &sampleIndices);
+
+  const auto nodes=tree._nodes;
+  std::map<long, vector<double> > leafValues;
+  for (const auto& leaf : tree._leafNodeToLabel)
+    leafValues[leaf.first]=leaf.second;
+  const long headNodeIndex=tree._headNodeIndex;
+  const size_t buildBytes=nodes.size()*sizeof(nodes[0])+leafValues.size()*
+    (sizeof(std::pair<long, vector<double> >)+numberOfClasses*sizeof(double));
+
+  tree.finalize();
+  EXPECT_TRUE(tree._nodes.empty());
+  EXPECT_TRUE(tree._leafNodeToLabel.empty());
+  const size_t finalizedBytes=tree._flatChildIndices.size()*sizeof(int32_t)+
+    tree._flatFeatureIndices.size()*sizeof(int32_t)+tree._flatThresholds.size()*sizeof(double)+
+    tree._flatLeafValues.size()*sizeof(double);
+  EXPECT_LT(2*finalizedBytes, buildBytes);
+
+  MatrixXd testData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  for (long dataId=0; dataId<numberOfData; ++dataId){
+    Map<const VectorXd> instance(&testData(dataId, 0), numberOfFeatures);
+    long nodeIndex=headNodeIndex;
+    while (!nodes[nodeIndex]._isLeaf)
+      nodeIndex = instance(nodes[nodeIndex]._featureIndex) < nodes[nodeIndex]._threshold ?
+        nodes[nodeIndex]._leftChildIndex : nodes[nodeIndex]._rightChildIndex;
+    const double* labelsCount=tree.predictOne(instance);
+    EXPECT_EQ(leafValues[nodeIndex], vector<double>(labelsCount, labelsCount+numberOfClasses));
+  }
+}
+
+template<class Forest>
+std::string
+codeOfSeededForest(Forest* forest, const MatrixXd& trainData, const Labels& trainLabels,
+                   const long numberOfThreads)
+{
+  forest->setNumberOfThreads()=numberOfThreads;
+  forest->setRandomSeed()=15;
+  forest->train(trainData, trainLabels);
+  std::ostringstream code;
+  forest->generateCode(code, "predict");
+  return code.str();
+}
+
+TEST(Builder, ParallelRandomForest_test)
+{
+  const long numberOfFeatures=6;
+  const long numberOfData=1000;
+  const long numberOfClasses=3;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  Labels trainLabels{ProblemType::Classification};
+  trainLabels._labelData.resize(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    trainLabels._labelData(dataId)=(trainData(dataId, 0)>0)+(trainData(dataId, 1)>0.5);
+
+  // the trees only depend on the seed, not on the thread that trains them
+  Models::RandomForestClassifier<> randomForest{numberOfFeatures, numberOfClasses, 12};
+  const std::string serialCode=codeOfSeededForest(&randomForest, trainData, trainLabels, 1);
+  EXPECT_EQ(serialCode, codeOfSeededForest(&randomForest, trainData, trainLabels, 4));
+  EXPECT_EQ(serialCode, codeOfSeededForest(&randomForest, trainData, trainLabels, 7));
+  EXPECT_LT(Models::RandomForestClassifier<>::LossFunction(randomForest.predict(trainData),
+                                                           trainLabels), 10);
+  randomForest.setRandomSeed()=16;
+  randomForest.train(trainData, trainLabels);
+  std::ostringstream otherSeedCode;
+  randomForest.generateCode(otherSeedCode, "predict");
+  EXPECT_NE(serialCode, otherSeedCode.str());
+
+  Models::RandomForestClassifier<gini, _RandomSplitter>
+    bestFirstExtraTrees{numberOfFeatures, numberOfClasses, 12, 1, 1,
+      std::numeric_limits<long>::max(), 2, 16};
+  EXPECT_EQ(codeOfSeededForest(&bestFirstExtraTrees, trainData, trainLabels, 1),
+            codeOfSeededForest(&bestFirstExtraTrees, trainData, trainLabels, 3));
+}
+
+TEST(Builder, OutOfBagRandomForest_test)
+{
+  const long numberOfFeatures=6;
+  const long numberOfData=2000;
+  const long numberOfClasses=2;
+  const long numberOfTrees=40;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  MatrixXd testData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  Labels trainLabels{ProblemType::Classification};
+  Labels testLabels{ProblemType::Classification};
+  trainLabels._labelData.resize(numberOfData);
+  testLabels._labelData.resize(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId){
+    trainLabels._labelData(dataId)=trainData(dataId, 0)+trainData(dataId, 1)+
+      0.5*trainData(dataId, 2) > 0;
+    testLabels._labelData(dataId)=testData(dataId, 0)+testData(dataId, 1)+
+      0.5*testData(dataId, 2) > 0;
+  }
+
+  Models::RandomForestClassifier<> randomForest{numberOfFeatures, numberOfClasses, numberOfTrees};
+  randomForest.setComputeOutOfBag()=true;
+  randomForest.setRandomSeed()=15;
+  randomForest.train(trainData, trainLabels);
+  const MatrixXd votes=randomForest.outOfBagVotes();
+  ASSERT_EQ(numberOfData, votes.rows());
+  ASSERT_EQ(numberOfClasses, votes.cols());
+  // a row misses a bootstrap of n draws with probability about 1/e
+  EXPECT_NEAR(numberOfTrees*numberOfData*std::exp(-1.0), votes.sum(), 0.02*votes.sum());
+
+  const Labels outOfBagLabels=randomForest.outOfBagLabels();
+  long numberOfVotedRows=0;
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    numberOfVotedRows+=outOfBagLabels._labelData(dataId) >= 0;
+  EXPECT_EQ(numberOfData, numberOfVotedRows);
+  EXPECT_EQ(Models::RandomForestClassifier<>::LossFunction(outOfBagLabels, trainLabels),
+            randomForest.outOfBagLoss());
+  const double testLoss=Models::RandomForestClassifier<>::LossFunction(
+    randomForest.predict(testData), testLabels);
+  EXPECT_NEAR(testLoss/numberOfData, randomForest.outOfBagLoss()/numberOfData, 0.03);
+
+  randomForest.setNumberOfThreads()=3;
+  randomForest.train(trainData, trainLabels);
+  EXPECT_EQ(votes, randomForest.outOfBagVotes());
+
+  // rows without weight are neither trained on nor voted for
+  VectorXd weights=VectorXd::Ones(numberOfData);
+  weights.head(10).setZero();
+  randomForest.train(trainData, trainLabels, weights);
+  EXPECT_EQ(0.0, randomForest.outOfBagVotes().topRows(10).sum());
+  EXPECT_EQ(-1.0, randomForest.outOfBagLabels()._labelData(0));
+}
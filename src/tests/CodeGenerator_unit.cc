@@ -0,0 +1,90 @@
+#include <core/Definitions.hpp>
+#include <core/Utilities.hpp>
+#include <models/TreeClassifier.hpp>
+#include <models/TreeRegressor.hpp>
+#include <models/RandomForestClassifier.hpp>
+#include <models/GradientBoostingRegressor.hpp>
+#include <gtest/gtest.h>
+#include <dlfcn.h>
+#include <fstream>
+
+#ifndef LIB15X_CXX_COMPILER
+#define LIB15X_CXX_COMPILER "c++"
+#endif
+
+using namespace Lib15x;
+
+// Compiles the generated predictor into a shared library, loads it back and checks it against
+// predict() on the in-memory model.
+template<class LearningModel>
+void checkGeneratedCode(LearningModel* learningModel, const ProblemType problemType,
+                        const std::string& name, const long maxBranchDepth)
+{
+  const long numberOfFeatures=learningModel->getNumberOfFeatures();
+  const long numberOfData=2000;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  Labels labels{problemType};
+  labels._labelData.resize(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    labels._labelData(dataId)=(trainData(dataId, 0)+trainData(dataId, 1)*trainData(dataId, 2) > 0)+
+      (problemType == ProblemType::Classification ? (trainData(dataId, 3) > 0.5) :
+       0.1*trainData(dataId, 3));
+  learningModel->train(trainData, labels);
+
+  const std::string sourceFileName=name+".cc";
+  const std::string libraryFileName=name+".so";
+  {
+    std::ofstream sourceFile(sourceFileName);
+    learningModel->generateCode(sourceFile, "predict_"+name, maxBranchDepth);
+  }
+  const std::string command=std::string(LIB15X_CXX_COMPILER)+
+    " -std=c++11 -O1 -shared -fPIC -o "+libraryFileName+" "+sourceFileName;
+  ASSERT_EQ(0, system(command.c_str()));
+
+  void* library=dlopen(("./"+libraryFileName).c_str(), RTLD_NOW);
+  ASSERT_NE(nullptr, library) << dlerror();
+  auto generatedPredict=reinterpret_cast<double (*)(const double*)>(
+    dlsym(library, ("predict_"+name).c_str()));
+  ASSERT_NE(nullptr, generatedPredict);
+
+  MatrixXd testData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  testData.topRows(numberOfData/2)=trainData.topRows(numberOfData/2);
+  testData(0, 0)=std::numeric_limits<double>::quiet_NaN();
+  Labels predictedLabels=learningModel->predict(testData);
+  for (long dataId=0; dataId<testData.rows(); ++dataId)
+    EXPECT_EQ(predictedLabels._labelData(dataId), generatedPredict(&testData(dataId, 0)));
+
+  dlclose(library);
+  remove(sourceFileName.c_str());
+  remove(libraryFileName.c_str());
+}
+
+TEST(CodeGenerator, Trees_test)
+{
+  const long numberOfFeatures=5;
+  Models::TreeClassifier<> treeClassifier{numberOfFeatures, 3};
+  checkGeneratedCode(&treeClassifier, ProblemType::Classification, "tree_classifier", 64);
+
+  Models::TreeRegressor<> treeRegressor{numberOfFeatures, 3};
+  checkGeneratedCode(&treeRegressor, ProblemType::Regression, "tree_regressor", 64);
+}
+
+TEST(CodeGenerator, Ensembles_test)
+{
+  const long numberOfFeatures=5;
+  Models::RandomForestClassifier<> randomForest{numberOfFeatures, 3, 10};
+  checkGeneratedCode(&randomForest, ProblemType::Classification, "random_forest", 64);
+
+  Models::GradientBoostingRegressor gradientBoosting{numberOfFeatures, 10, 3, 1, 6};
+  checkGeneratedCode(&gradientBoosting, ProblemType::Regression, "gradient_boosting", 64);
+}
+
+TEST(CodeGenerator, NodeTables_test)
+{
+  const long numberOfFeatures=5;
+  Models::RandomForestClassifier<> randomForest{numberOfFeatures, 3, 10};
+  checkGeneratedCode(&randomForest, ProblemType::Classification, "random_forest_tables", 4);
+
+  Models::GradientBoostingRegressor gradientBoosting{numberOfFeatures, 10};
+  checkGeneratedCode(&gradientBoosting, ProblemType::Regression, "gradient_boosting_tables", 4);
+}
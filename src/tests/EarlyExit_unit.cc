@@ -0,0 +1,76 @@
+#include <core/Definitions.hpp>
+#include <core/Utilities.hpp>
+#include <models/RandomForestClassifier.hpp>
+#include <models/BaggingClassifier.hpp>
+#include <gtest/gtest.h>
+
+using namespace Lib15x;
+
+namespace
+{
+  // three classes with a noisy boundary, so some rows stay close votes
+  std::pair<MatrixXd, Labels>
+  noisyDataOf(const long numberOfData, const long numberOfFeatures)
+  {
+    MatrixXd data=MatrixXd::Random(numberOfData, numberOfFeatures);
+    Labels labels{ProblemType::Classification};
+    labels._labelData.resize(numberOfData);
+    for (long dataId=0; dataId<numberOfData; ++dataId){
+      const double score=data(dataId, 0)+0.5*data(dataId, 1)*data(dataId, 2)+
+        0.3*data(dataId, 3);
+      labels._labelData(dataId)=(score > -0.3)+(score > 0.4);
+    }
+    return std::make_pair(data, labels);
+  }
+}
+
+TEST(EarlyExit, RandomForest_test)
+{
+  const long numberOfFeatures=5;
+  srand(7);
+  const auto trainPair=noisyDataOf(3000, numberOfFeatures);
+  const MatrixXd testData=noisyDataOf(4000, numberOfFeatures).first;
+
+  Models::RandomForestClassifier<> randomForest{numberOfFeatures, 3, 60, 5, 1,
+      std::numeric_limits<long>::max(), 2};
+  randomForest.setRandomSeed()=15;
+  randomForest.train(trainPair.first, trainPair.second);
+  const Labels fullLabels=randomForest.predict(testData);
+
+  randomForest.setEarlyExit()=true;
+  EXPECT_EQ(fullLabels._labelData, randomForest.predict(testData)._labelData);
+  for (long dataId=0; dataId<testData.rows(); dataId+=7)
+    EXPECT_EQ(fullLabels._labelData(dataId),
+              randomForest.predictOne(testData.row(dataId).transpose()));
+
+  randomForest.orderTreesByAgreement(trainPair.first);
+  EXPECT_EQ(fullLabels._labelData, randomForest.predict(testData)._labelData);
+  randomForest.setEarlyExit()=false;
+  EXPECT_EQ(fullLabels._labelData, randomForest.predict(testData)._labelData);
+
+  // a risk trades a few labels for fewer trees
+  randomForest.setEarlyExit()=true;
+  randomForest.setEarlyExitRisk()=0.05;
+  const Labels riskyLabels=randomForest.predict(testData);
+  EXPECT_LT(Models::RandomForestClassifier<>::LossFunction(riskyLabels, fullLabels),
+            0.02*static_cast<double>(testData.rows()));
+}
+
+TEST(EarlyExit, Bagging_test)
+{
+  const long numberOfFeatures=5;
+  srand(3);
+  const auto trainPair=noisyDataOf(2000, numberOfFeatures);
+  const MatrixXd testData=noisyDataOf(1000, numberOfFeatures).first;
+
+  Models::BaggingClassifier<> bagging{numberOfFeatures, 3, 25, 5};
+  bagging.train(trainPair.first, trainPair.second);
+  const Labels fullLabels=bagging.predict(testData);
+
+  bagging.setEarlyExit()=true;
+  EXPECT_EQ(fullLabels._labelData, bagging.predict(testData)._labelData);
+  bagging.orderModelsByAgreement(trainPair.first);
+  EXPECT_EQ(fullLabels._labelData, bagging.predict(testData)._labelData);
+  bagging.setEarlyExit()=false;
+  EXPECT_EQ(fullLabels._labelData, bagging.predict(testData)._labelData);
+}
@@ -0,0 +1,54 @@
+#include <core/Definitions.hpp>
+#include <core/Utilities.hpp>
+#include <models/GradientBoostingRegressor.hpp>
+#include <gtest/gtest.h>
+
+using namespace Lib15x;
+
+TEST(GradientBoosting, Residuals_test)
+{
+  const long numberOfFeatures=4;
+  const long numberOfData=2000;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  Labels trainLabels{ProblemType::Regression};
+  trainLabels._labelData.resize(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    trainLabels._labelData(dataId)=3.0+std::sin(3.0*trainData(dataId, 0))+
+      trainData(dataId, 1)*trainData(dataId, 2);
+
+  // fully grown, the first tree fits the residuals of the mean
+  Models::GradientBoostingRegressor exactBoosting{numberOfFeatures, 1};
+  exactBoosting.train(trainData, trainLabels);
+  EXPECT_NEAR(0.0, Models::GradientBoostingRegressor::LossFunction(
+                exactBoosting.predict(trainData), trainLabels), 1e-4);
+
+  // shallow trees shrunk by the learning rate keep lowering the training loss
+  double previousLoss=std::numeric_limits<double>::max();
+  for (const long numberOfTrees : {1, 5, 20}) {
+    Models::GradientBoostingRegressor gradientBoosting{numberOfFeatures, numberOfTrees, 1, 1, 3};
+    gradientBoosting.setLearningRate()=0.3;
+    gradientBoosting.train(trainData, trainLabels);
+    const double loss=Models::GradientBoostingRegressor::LossFunction(
+      gradientBoosting.predict(trainData), trainLabels);
+    EXPECT_LT(loss, previousLoss);
+    previousLoss=loss;
+  }
+
+  // level-wise trees over binned features boost about as well as the presorted ones
+  Models::GradientBoostingRegressor levelWiseBoosting{numberOfFeatures, 20, 1, 1, 3};
+  levelWiseBoosting.setLearningRate()=0.3;
+  levelWiseBoosting.setUseLevelWiseBuilder()=true;
+  levelWiseBoosting.setNumberOfSplitThreads()=2;
+  levelWiseBoosting.train(trainData, trainLabels);
+  EXPECT_LT(Models::GradientBoostingRegressor::LossFunction(
+              levelWiseBoosting.predict(trainData), trainLabels), 1.2*previousLoss);
+
+  // the model starts from the weighted label mean
+  VectorXd weights=VectorXd::Ones(numberOfData);
+  weights.head(numberOfData/2).setZero();
+  Models::GradientBoostingRegressor stumpBoosting{numberOfFeatures, 1, 1, 1, 1};
+  stumpBoosting.setLearningRate()=0.0;
+  stumpBoosting.train(trainData, trainLabels, weights);
+  EXPECT_NEAR(trainLabels._labelData.tail(numberOfData/2).mean(),
+              stumpBoosting.predict(trainData)._labelData(0), 1e-12);
+}
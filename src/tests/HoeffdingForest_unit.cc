@@ -0,0 +1,115 @@
+#include <core/Definitions.hpp>
+#include <core/Utilities.hpp>
+#include <models/HoeffdingForestClassifier.hpp>
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace Lib15x;
+
+namespace
+{
+  // three classes split by two axis-aligned boundaries, with 5% of the labels flipped
+  std::pair<MatrixXd, Labels>
+  streamOf(const long numberOfData, const long numberOfFeatures, std::mt19937* generator)
+  {
+    std::uniform_real_distribution<double> valueDistribution{-1.0, 1.0};
+    std::uniform_real_distribution<double> noiseDistribution{0.0, 1.0};
+    MatrixXd data(numberOfData, numberOfFeatures);
+    Labels labels{ProblemType::Classification};
+    labels._labelData.resize(numberOfData);
+    for (long dataId = 0; dataId < numberOfData; ++dataId) {
+      for (long featId = 0; featId < numberOfFeatures; ++featId)
+        data(dataId, featId) = valueDistribution(*generator);
+      labels._labelData(dataId) = (data(dataId, 0) > 0.2) + (data(dataId, 2) > -0.4);
+      if (noiseDistribution(*generator) < 0.05)
+        labels._labelData(dataId) = static_cast<double>(dataId % 3);
+    }
+    return std::make_pair(data, labels);
+  }
+
+  template<class LearningModel>
+  std::string
+  codeOf(const LearningModel& learningModel)
+  {
+    std::ostringstream code;
+    learningModel.generateCode(code, "predict");
+    return code.str();
+  }
+}
+
+TEST(HoeffdingForest, MiniBatches_test)
+{
+  const long numberOfFeatures = 6;
+  const long numberOfClasses = 3;
+  const long numberOfTrees = 10;
+  std::mt19937 generator{15};
+  const auto trainPair = streamOf(40000, numberOfFeatures, &generator);
+  const auto testPair = streamOf(5000, numberOfFeatures, &generator);
+  const MatrixXd& trainData = trainPair.first;
+  const Labels& trainLabels = trainPair.second;
+
+  Models::HoeffdingForestClassifier<> forest{numberOfFeatures, numberOfClasses, numberOfTrees};
+  forest.setRandomSeed() = 15;
+  const long batchSize = 1000;
+  for (long batchStart = 0; batchStart < trainData.rows(); batchStart += batchSize) {
+    Labels batchLabels{ProblemType::Classification};
+    batchLabels._labelData = trainLabels._labelData.segment(batchStart, batchSize);
+    forest.partialFit(MatrixXd(trainData.middleRows(batchStart, batchSize)), batchLabels);
+  }
+
+  const Labels predictedLabels = forest.predict(testPair.first);
+  const double testError = Models::HoeffdingForestClassifier<>::LossFunction(
+    predictedLabels, testPair.second)/static_cast<double>(testPair.first.rows());
+  EXPECT_LT(testError, 0.06);
+  for (long dataId = 0; dataId < 200; ++dataId)
+    EXPECT_EQ(predictedLabels._labelData(dataId),
+              forest.predictOne(testPair.first.row(dataId).transpose()));
+  for (long treeId = 0; treeId < numberOfTrees; ++treeId) {
+    EXPECT_GT(forest.tree(treeId).numberOfLeaves(), 2);
+    EXPECT_LE(forest.tree(treeId).numberOfLeaves(), 1024);
+  }
+
+  // the stream in one batch and on two threads grows the same trees
+  Models::HoeffdingForestClassifier<> wholeForest{numberOfFeatures, numberOfClasses,
+      numberOfTrees};
+  wholeForest.setRandomSeed() = 15;
+  wholeForest.setNumberOfThreads() = 2;
+  wholeForest.train(trainData, trainLabels);
+  EXPECT_EQ(codeOf(forest), codeOf(wholeForest));
+
+  // the stream starts again at train
+  forest.train(trainData, trainLabels);
+  EXPECT_EQ(codeOf(wholeForest), codeOf(forest));
+}
+
+TEST(HoeffdingForest, BoundedTrees_test)
+{
+  const long numberOfFeatures = 6;
+  const long numberOfClasses = 3;
+  std::mt19937 generator{3};
+  const auto trainPair = streamOf(20000, numberOfFeatures, &generator);
+
+  Models::HoeffdingForestClassifier<entropy> forest{numberOfFeatures, numberOfClasses, 4,
+      std::numeric_limits<long>::max(), numberOfFeatures, 6};
+  forest.setGracePeriod() = 50;
+  forest.train(trainPair.first, trainPair.second);
+  for (long treeId = 0; treeId < 4; ++treeId) {
+    EXPECT_EQ(6, forest.tree(treeId).numberOfLeaves());
+    EXPECT_EQ(0, forest.tree(treeId).numberOfCollectingLeaves());
+  }
+  EXPECT_LT(Models::HoeffdingForestClassifier<entropy>::LossFunction(
+              forest.predict(trainPair.first), trainPair.second),
+            0.1*static_cast<double>(trainPair.first.rows()));
+
+  Models::HoeffdingForestClassifier<> stumps{numberOfFeatures, numberOfClasses, 4, 1,
+      numberOfFeatures, -1};
+  stumps.train(trainPair.first, trainPair.second);
+  for (long treeId = 0; treeId < 4; ++treeId)
+    EXPECT_EQ(2, stumps.tree(treeId).numberOfLeaves());
+
+  Labels badLabels = trainPair.second;
+  badLabels._labelData(7) = 3;
+  EXPECT_THROW(stumps.partialFit(trainPair.first, badLabels), std::exception);
+  EXPECT_THROW((Models::HoeffdingForestClassifier<>{numberOfFeatures, numberOfClasses, 0}),
+               std::exception);
+}
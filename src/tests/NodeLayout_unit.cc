@@ -0,0 +1,124 @@
+#include <core/Definitions.hpp>
+#include <core/Utilities.hpp>
+#include <internal/_RegressionTree.hpp>
+#include <models/TreeClassifier.hpp>
+#include <models/TreeRegressor.hpp>
+#include <models/RandomForestClassifier.hpp>
+#include <models/GradientBoostingRegressor.hpp>
+#include <gtest/gtest.h>
+#include <functional>
+
+using namespace Lib15x;
+
+namespace
+{
+  std::pair<MatrixXd, Labels>
+  dataOf(const long numberOfData, const long numberOfFeatures, const ProblemType problemType)
+  {
+    MatrixXd data=MatrixXd::Random(numberOfData, numberOfFeatures);
+    Labels labels{problemType};
+    labels._labelData.resize(numberOfData);
+    for (long dataId=0; dataId<numberOfData; ++dataId){
+      const double score=data(dataId, 0)+0.5*data(dataId, 1)*data(dataId, 2)+
+        0.2*(rand()%10)/10.0;
+      labels._labelData(dataId)=problemType==ProblemType::Classification ?
+        (score > -0.3)+(score > 0.4) : score;
+    }
+    return std::make_pair(data, labels);
+  }
+}
+
+TEST(NodeLayout, HotPathFirst_test)
+{
+  // a complete tree over feature 0 in [0, 256), with most rows near 100
+  const long depth=8;
+  _RegressionTree tree{1};
+  std::function<void(long, bool, long, long)> addSubtree=
+    [&](const long parentNodeIndex, const bool isLeft, const long low, const long high) {
+    if (high-low == 1) {
+      tree.addLeaf(tree.addNode(parentNodeIndex, isLeft, -1, 0.0), static_cast<double>(low));
+      return;
+    }
+    const long middle=(low+high)/2;
+    const long nodeIndex=tree.addNode(parentNodeIndex, isLeft, 0, static_cast<double>(middle));
+    addSubtree(nodeIndex, true, low, middle);
+    addSubtree(nodeIndex, false, middle, high);
+  };
+  addSubtree(-1, true, 0, 1L << depth);
+  tree.finalize();
+
+  const long numberOfData=1000;
+  MatrixXd sampleData(numberOfData, 1);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    sampleData(dataId, 0)=dataId % 10 == 0 ? static_cast<double>(dataId % 256) : 100.5;
+  vector<long> rowOffsets(numberOfData);
+  std::iota(std::begin(rowOffsets), std::end(rowOffsets), 0);
+  vector<double> labels;
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    labels.push_back(tree.predictOne(sampleData.row(dataId).transpose()));
+  EXPECT_GT(tree.leafIndexOf(sampleData.row(1).data()), 2*depth);
+
+  tree.reorderNodes(tree.nodeVisitCountsOf(sampleData.data(), rowOffsets.data(), numberOfData));
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    EXPECT_EQ(labels[dataId], tree.predictOne(sampleData.row(dataId).transpose()));
+  // the hot path takes the pair after the root and then every next pair
+  EXPECT_GE(2*depth, tree.leafIndexOf(sampleData.row(1).data()));
+  const vector<double> visitCounts=tree.nodeVisitCountsOf(sampleData.data(),
+                                                          rowOffsets.data(), numberOfData);
+  long nodeIndex=0;
+  while (tree._flatFeatureIndices[nodeIndex] >= 0) {
+    const long leftChildIndex=tree._flatChildIndices[nodeIndex];
+    const long hotChildIndex=leftChildIndex+
+      (visitCounts[leftChildIndex+1] > visitCounts[leftChildIndex]);
+    if (tree._flatFeatureIndices[hotChildIndex] >= 0) {
+      EXPECT_EQ(leftChildIndex+2, tree._flatChildIndices[hotChildIndex]);
+    }
+    nodeIndex=hotChildIndex;
+  }
+  const vector<long> pathLengths=tree.pathLengthsOfNodes();
+  EXPECT_EQ(depth+1, *std::max_element(std::begin(pathLengths), std::end(pathLengths)));
+}
+
+TEST(NodeLayout, Models_test)
+{
+  const long numberOfFeatures=6;
+  srand(11);
+  const auto classificationPair=dataOf(4000, numberOfFeatures, ProblemType::Classification);
+  const auto regressionPair=dataOf(4000, numberOfFeatures, ProblemType::Regression);
+  const MatrixXd testData=MatrixXd::Random(2000, numberOfFeatures);
+
+  Models::TreeClassifier<> treeClassifier{numberOfFeatures, 3};
+  treeClassifier.train(classificationPair.first, classificationPair.second);
+  const Labels treeClassifierLabels=treeClassifier.predict(testData);
+  treeClassifier.reorderNodesByPaths(classificationPair.first);
+  EXPECT_EQ(treeClassifierLabels._labelData, treeClassifier.predict(testData)._labelData);
+  for (long dataId=0; dataId<testData.rows(); dataId+=13)
+    EXPECT_EQ(treeClassifierLabels._labelData(dataId),
+              treeClassifier.predictOne(testData.row(dataId).transpose()));
+
+  Models::TreeRegressor<> treeRegressor{numberOfFeatures};
+  treeRegressor.train(regressionPair.first, regressionPair.second);
+  const Labels treeRegressorLabels=treeRegressor.predict(testData);
+  treeRegressor.reorderNodesByPaths(regressionPair.first);
+  EXPECT_EQ(treeRegressorLabels._labelData, treeRegressor.predict(testData)._labelData);
+
+  Models::RandomForestClassifier<> randomForest{numberOfFeatures, 3, 20, 1, 1,
+      std::numeric_limits<long>::max(), 2, 64};
+  randomForest.setUseQuickScorer()=true;
+  randomForest.train(classificationPair.first, classificationPair.second);
+  const Labels forestLabels=randomForest.predict(testData);
+  randomForest.reorderNodesByPaths(testData);
+  EXPECT_EQ(forestLabels._labelData, randomForest.predict(testData)._labelData);
+  randomForest.setUseQuickScorer()=false;
+  randomForest.setEarlyExit()=true;
+  randomForest.reorderNodesByPaths(classificationPair.first);
+  EXPECT_EQ(forestLabels._labelData, randomForest.predict(testData)._labelData);
+
+  Models::GradientBoostingRegressor boosting{numberOfFeatures, 20, 1, 1, 6};
+  boosting.setLearningRate()=0.2;
+  boosting.train(regressionPair.first, regressionPair.second);
+  const Labels boostingLabels=boosting.predict(testData);
+  boosting.reorderNodesByPaths(regressionPair.first);
+  EXPECT_EQ(boostingLabels._labelData, boosting.predict(testData)._labelData);
+  EXPECT_EQ(boostingLabels._labelData(5), boosting.predictOne(testData.row(5).transpose()));
+}
@@ -0,0 +1,189 @@
+#include <core/Definitions.hpp>
+#include <core/Utilities.hpp>
+#include <models/RandomForestClassifier.hpp>
+#include <models/GradientBoostingRegressor.hpp>
+#include <models/BaggingClassifier.hpp>
+#include <gtest/gtest.h>
+#include <set>
+#include <sstream>
+
+using namespace Lib15x;
+
+namespace
+{
+  // three classes with a noisy boundary
+  std::pair<MatrixXd, Labels>
+  classificationDataOf(const long numberOfData, const long numberOfFeatures)
+  {
+    MatrixXd data=MatrixXd::Random(numberOfData, numberOfFeatures);
+    Labels labels{ProblemType::Classification};
+    labels._labelData.resize(numberOfData);
+    for (long dataId=0; dataId<numberOfData; ++dataId){
+      const double score=data(dataId, 0)+0.5*data(dataId, 1)*data(dataId, 2)+
+        0.3*data(dataId, 3);
+      labels._labelData(dataId)=(score > -0.3)+(score > 0.4);
+    }
+    return std::make_pair(data, labels);
+  }
+
+  std::pair<MatrixXd, Labels>
+  regressionDataOf(const long numberOfData, const long numberOfFeatures)
+  {
+    MatrixXd data=MatrixXd::Random(numberOfData, numberOfFeatures);
+    Labels labels{ProblemType::Regression};
+    labels._labelData.resize(numberOfData);
+    for (long dataId=0; dataId<numberOfData; ++dataId)
+      labels._labelData(dataId)=std::sin(3*data(dataId, 0))+data(dataId, 1)*data(dataId, 2);
+    return std::make_pair(data, labels);
+  }
+
+  // the body of every function in the generated code, the trees first
+  template<class LearningModel>
+  vector<std::string>
+  functionBodiesOf(const LearningModel& learningModel)
+  {
+    std::ostringstream out;
+    learningModel.generateCode(out, "predict");
+    const std::string code=out.str();
+    vector<std::string> bodies;
+    for (size_t begin=code.find("\n{\n"); begin!=std::string::npos;
+         begin=code.find("\n{\n", begin)){
+      const size_t end=code.find("\n}\n", begin);
+      bodies.push_back(code.substr(begin, end-begin));
+      begin=end;
+    }
+    return bodies;
+  }
+}
+
+TEST(Pruning, RandomForest_test)
+{
+  const long numberOfFeatures=5;
+  srand(7);
+  const auto trainPair=classificationDataOf(3000, numberOfFeatures);
+  const auto validPair=classificationDataOf(1500, numberOfFeatures);
+  const auto testPair=classificationDataOf(3000, numberOfFeatures);
+  using Forest=Models::RandomForestClassifier<>;
+
+  Forest fullForest{numberOfFeatures, 3, 60, 1, 1, std::numeric_limits<long>::max(), 2};
+  fullForest.setRandomSeed()=15;
+  fullForest.train(trainPair.first, trainPair.second);
+  const double fullLoss=Forest::LossFunction(fullForest.predict(testPair.first),
+                                             testPair.second);
+
+  Forest forest=fullForest;
+  PruningBudget budget;
+  budget._maxNumberOfTrees=15;
+  vector<PruningStep> steps=forest.prune(validPair.first, validPair.second, budget);
+  ASSERT_EQ(15u, steps.size());
+  const long numberOfKeptTrees=_bestNumberOfSteps(steps);
+  EXPECT_LE(numberOfKeptTrees, 15);
+  EXPECT_EQ(steps[numberOfKeptTrees-1]._loss,
+            Forest::LossFunction(forest.predict(validPair.first), validPair.second));
+  for (long stepId=1; stepId<static_cast<long>(steps.size()); ++stepId) {
+    EXPECT_EQ(stepId+1, steps[stepId]._numberOfTrees);
+    EXPECT_GT(steps[stepId]._numberOfNodes, steps[stepId-1]._numberOfNodes);
+    EXPECT_GT(steps[stepId]._averagePathLength, steps[stepId-1]._averagePathLength);
+  }
+  EXPECT_LT(Forest::LossFunction(forest.predict(testPair.first), testPair.second),
+            fullLoss+0.02*static_cast<double>(testPair.first.rows()));
+  for (long dataId=0; dataId<testPair.first.rows(); dataId+=11)
+    EXPECT_EQ(forest.predict(testPair.first)._labelData(dataId),
+              forest.predictOne(testPair.first.row(dataId).transpose()));
+
+  // a node budget of a tenth of the forest
+  Forest smallForest=fullForest;
+  PruningBudget nodeBudget;
+  nodeBudget._maxNumberOfNodes=steps.back()._numberOfNodes*60/15/10;
+  steps=smallForest.prune(validPair.first, validPair.second, nodeBudget);
+  EXPECT_LE(steps.back()._numberOfNodes, nodeBudget._maxNumberOfNodes);
+  EXPECT_LT(Forest::LossFunction(smallForest.predict(testPair.first), testPair.second),
+            fullLoss+0.03*static_cast<double>(testPair.first.rows()));
+
+  PruningBudget tinyBudget;
+  tinyBudget._maxNumberOfBytes=1;
+  EXPECT_THROW(smallForest.prune(validPair.first, validPair.second, tinyBudget),
+               std::exception);
+  EXPECT_THROW(smallForest.prune(testPair.first, validPair.second, budget), std::exception);
+}
+
+TEST(Pruning, RandomForestWarmStart_test)
+{
+  const long numberOfFeatures=5;
+  srand(7);
+  const auto trainPair=classificationDataOf(1000, numberOfFeatures);
+  const auto validPair=classificationDataOf(500, numberOfFeatures);
+  using Forest=Models::RandomForestClassifier<>;
+
+  Forest forest{numberOfFeatures, 3, 8, 1, 1, 6, 2};
+  forest.setRandomSeed()=15;
+  forest.setComputeOutOfBag()=true;
+  forest.setWarmStart()=true;
+  forest.train(trainPair.first, trainPair.second);
+  PruningBudget budget;
+  budget._maxNumberOfTrees=4;
+  const long numberOfKeptTrees=
+    _bestNumberOfSteps(forest.prune(validPair.first, validPair.second, budget));
+  EXPECT_THROW(forest.outOfBagVotes(), std::exception);
+  EXPECT_THROW(forest.outOfBagLabels(), std::exception);
+  EXPECT_THROW(forest.outOfBagLoss(), std::exception);
+
+  // the new trees must not repeat the random streams of the kept ones
+  forest.setComputeOutOfBag()=false;
+  forest.addTrees(8);
+  forest.train(trainPair.first, trainPair.second);
+  const vector<std::string> bodies=functionBodiesOf(forest);
+  ASSERT_EQ(static_cast<size_t>(numberOfKeptTrees+8+1), bodies.size());
+  EXPECT_EQ(bodies.size(), std::set<std::string>(std::begin(bodies), std::end(bodies)).size());
+}
+
+TEST(Pruning, GradientBoosting_test)
+{
+  const long numberOfFeatures=4;
+  srand(5);
+  const auto trainPair=regressionDataOf(2000, numberOfFeatures);
+  const auto validPair=regressionDataOf(1000, numberOfFeatures);
+  using Boosting=Models::GradientBoostingRegressor;
+
+  Boosting boosting{numberOfFeatures, 40, 5, 1, 4};
+  boosting.setLearningRate()=0.2;
+  boosting.train(trainPair.first, trainPair.second);
+  const double fullLoss=Boosting::LossFunction(boosting.predict(validPair.first),
+                                               validPair.second);
+
+  PruningBudget budget;
+  budget._maxNumberOfBytes=20*1024;
+  const vector<PruningStep> steps=boosting.prune(validPair.first, validPair.second, budget);
+  const long numberOfKeptTrees=_bestNumberOfSteps(steps);
+  EXPECT_LE(steps.back()._numberOfBytes, budget._maxNumberOfBytes);
+  EXPECT_NEAR(steps[numberOfKeptTrees-1]._loss,
+              Boosting::LossFunction(boosting.predict(validPair.first), validPair.second),
+              1e-6*fullLoss);
+  EXPECT_LE(steps[numberOfKeptTrees-1]._loss, fullLoss*1.5);
+  EXPECT_NEAR(boosting.predict(validPair.first)._labelData(3),
+              boosting.predictOne(validPair.first.row(3).transpose()), 1e-9);
+}
+
+TEST(Pruning, Bagging_test)
+{
+  const long numberOfFeatures=5;
+  srand(3);
+  const auto trainPair=classificationDataOf(2000, numberOfFeatures);
+  const auto validPair=classificationDataOf(1000, numberOfFeatures);
+  using Bagging=Models::BaggingClassifier<>;
+
+  Bagging bagging{numberOfFeatures, 3, 25, 5};
+  bagging.train(trainPair.first, trainPair.second);
+
+  PruningBudget budget;
+  budget._maxNumberOfTrees=5;
+  const vector<PruningStep> steps=bagging.prune(validPair.first, validPair.second, budget);
+  ASSERT_EQ(5u, steps.size());
+  const long numberOfKeptModels=_bestNumberOfSteps(steps);
+  EXPECT_EQ(steps[numberOfKeptModels-1]._loss,
+            Bagging::LossFunction(bagging.predict(validPair.first), validPair.second));
+
+  PruningBudget nodeBudget;
+  nodeBudget._maxNumberOfNodes=100;
+  EXPECT_THROW(bagging.prune(validPair.first, validPair.second, nodeBudget), std::exception);
+}
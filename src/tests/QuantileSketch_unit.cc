@@ -0,0 +1,153 @@
+#include <core/Definitions.hpp>
+#include <internal/_QuantileSketch.hpp>
+#include <internal/_BinnedDataset.hpp>
+#include <internal/_FeatureStore.hpp>
+#include <gtest/gtest.h>
+#include <random>
+
+using namespace Lib15x;
+
+namespace
+{
+  // weight of the values strictly below and at or below value
+  std::pair<double, double>
+  exactRanksOf(const vector<std::pair<double, double> >& sortedValues, const double value)
+  {
+    double rankBelow = 0.0;
+    double rankAtOrBelow = 0.0;
+    for (const auto& valueAndWeight : sortedValues) {
+      if (valueAndWeight.first < value) rankBelow += valueAndWeight.second;
+      if (valueAndWeight.first <= value) rankAtOrBelow += valueAndWeight.second;
+    }
+    return std::make_pair(rankBelow, rankAtOrBelow);
+  }
+}
+
+TEST(QuantileSketch, MergedRankError_test)
+{
+  const double epsilon=0.01;
+  const long numberOfData=20000;
+  const long numberOfChunks=7;
+  std::mt19937 generator{15};
+  std::uniform_real_distribution<double> valueDistribution{-1.0, 1.0};
+  std::uniform_real_distribution<double> weightDistribution{0.1, 3.0};
+
+  vector<std::pair<double, double> > values;
+  vector<_QuantileSketch> chunkSketches(numberOfChunks, _QuantileSketch{epsilon});
+  for (long dataId=0; dataId<numberOfData; ++dataId){
+    const double value=std::round(valueDistribution(generator)*1000.0);
+    const double weight=weightDistribution(generator);
+    values.push_back(std::make_pair(value, weight));
+    chunkSketches[dataId % numberOfChunks].push(value, weight);
+  }
+  std::sort(std::begin(values), std::end(values));
+  double totalWeight=0.0;
+  for (const auto& valueAndWeight : values)
+    totalWeight+=valueAndWeight.second;
+
+  _QuantileSketch sketch{epsilon};
+  for (const auto& chunkSketch : chunkSketches)
+    sketch.merge(chunkSketch);
+  EXPECT_NEAR(totalWeight, sketch.totalWeight(), 1e-6*totalWeight);
+
+  const vector<_QuantileSketch::_Entry> summary=sketch.summary();
+  EXPECT_LE(static_cast<long>(summary.size()), static_cast<long>(std::ceil(2.0/epsilon))+1);
+  for (const auto& entry : summary){
+    const auto exactRanks=exactRanksOf(values, entry._value);
+    EXPECT_LE(entry._rankMin, exactRanks.first+1e-6);
+    EXPECT_GE(entry._rankMax, exactRanks.second-1e-6);
+    EXPECT_LE(entry._rankMax-entry._rankMin-entry._weight, epsilon*totalWeight);
+  }
+
+  const long numberOfCuts=50;
+  const vector<double> cuts=sketch.cutPoints(numberOfCuts);
+  EXPECT_EQ(numberOfCuts, static_cast<long>(cuts.size()));
+  for (long cutId=0; cutId<static_cast<long>(cuts.size()); ++cutId){
+    if (cutId>0){
+      EXPECT_LT(cuts[cutId-1], cuts[cutId]);
+    }
+    const double targetRank=
+      static_cast<double>(cutId+1)*totalWeight/static_cast<double>(numberOfCuts+1);
+    EXPECT_NEAR(targetRank, exactRanksOf(values, cuts[cutId]).first, epsilon*totalWeight);
+  }
+}
+
+TEST(QuantileSketch, LongStreamRankError_test)
+{
+  // a stream long enough to fold through ten levels
+  const double epsilon=0.01;
+  const long numberOfData=1L<<18;
+  std::mt19937 generator{15};
+  std::uniform_real_distribution<double> valueDistribution{0.0, 1.0};
+
+  _QuantileSketch sketch{epsilon};
+  vector<double> values(numberOfData);
+  for (auto& value : values){
+    value=valueDistribution(generator);
+    sketch.push(value);
+  }
+  std::sort(std::begin(values), std::end(values));
+
+  const double totalWeight=static_cast<double>(numberOfData);
+  for (const auto& entry : sketch.summary()){
+    const double rankBelow=static_cast<double>(
+      std::lower_bound(std::begin(values), std::end(values), entry._value)-std::begin(values));
+    EXPECT_LE(entry._rankMin, rankBelow+1e-6);
+    EXPECT_GE(entry._rankMax, rankBelow+1.0-1e-6);
+    EXPECT_LE(entry._rankMax-entry._rankMin-entry._weight, epsilon*totalWeight);
+  }
+}
+
+TEST(QuantileSketch, FewDistinctValues_test)
+{
+  _QuantileSketch sketch{0.1};
+  for (long dataId=0; dataId<1000; ++dataId)
+    sketch.push(static_cast<double>(dataId % 5), static_cast<double>(1+dataId % 3));
+  sketch.push(std::numeric_limits<double>::quiet_NaN());
+  sketch.push(7.0, 0.0);
+
+  EXPECT_EQ(5, static_cast<long>(sketch.summary().size()));
+  EXPECT_EQ((vector<double>{0.5, 1.5, 2.5, 3.5}), sketch.cutPoints(10));
+  EXPECT_EQ((vector<double>{}), sketch.cutPoints(10, 1.0));
+  EXPECT_THROW(_QuantileSketch{0.0}, std::exception);
+  EXPECT_THROW(_QuantileSketch{1.0}, std::exception);
+}
+
+TEST(QuantileSketch, SketchedBinnedDataset_test)
+{
+  const long numberOfFeatures=3;
+  const long numberOfData=100000;
+  MatrixXd data=MatrixXd::Random(numberOfData, numberOfFeatures);
+  _FeatureStore featureStore;
+  featureStore.reset(data);
+
+  const double epsilon=1.0/255;
+  const _BinnedDataset<uint8_t>& binnedData=featureStore.binnedData<uint8_t>(epsilon);
+  EXPECT_EQ(epsilon, binnedData.sketchEpsilon());
+  for (long featId=0; featId<numberOfFeatures; ++featId){
+    const long numberOfBins=binnedData.numberOfBins(featId);
+    EXPECT_EQ(256, numberOfBins);
+    vector<long> binSizes(numberOfBins, 0);
+    const uint8_t* column=binnedData.column(featId);
+    for (long dataId=0; dataId<numberOfData; ++dataId){
+      ++binSizes[column[dataId]];
+      const double value=data(dataId, featId);
+      if (column[dataId]>0){
+        EXPECT_GT(value, binnedData.threshold(featId, column[dataId]-1));
+      }
+      if (column[dataId]<numberOfBins-1){
+        EXPECT_LE(value, binnedData.threshold(featId, column[dataId]));
+      }
+    }
+    const double expectedBinSize=static_cast<double>(numberOfData)/static_cast<double>(numberOfBins);
+    for (const long binSize : binSizes)
+      EXPECT_NEAR(expectedBinSize, static_cast<double>(binSize), 2.0*epsilon*numberOfData);
+  }
+
+  // each epsilon keeps its own dataset, so the sketched one stays valid for its splitters
+  const _BinnedDataset<uint8_t>& exactBinnedData=featureStore.binnedData<uint8_t>();
+  EXPECT_EQ(0.0, exactBinnedData.sketchEpsilon());
+  EXPECT_EQ(&binnedData, &featureStore.binnedData<uint8_t>(epsilon));
+  EXPECT_EQ(epsilon, binnedData.sketchEpsilon());
+  EXPECT_EQ(&exactBinnedData, &featureStore.binnedData<uint8_t>());
+}
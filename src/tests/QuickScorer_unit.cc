@@ -0,0 +1,64 @@
+#include <core/Definitions.hpp>
+#include <core/Utilities.hpp>
+#include <models/RandomForestClassifier.hpp>
+#include <models/GradientBoostingRegressor.hpp>
+#include <gtest/gtest.h>
+
+using namespace Lib15x;
+
+template<class LearningModel>
+void checkQuickScorer(LearningModel* learningModel, const ProblemType problemType)
+{
+  const long numberOfFeatures=learningModel->getNumberOfFeatures();
+  const long numberOfData=2000;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  // repeated values put equal thresholds into different trees
+  for (long dataId=0; dataId<numberOfData; dataId+=2)
+    trainData(dataId, 1)=std::round(4*trainData(dataId, 1))/4;
+  Labels labels{problemType};
+  labels._labelData.resize(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    labels._labelData(dataId)=(trainData(dataId, 0)+trainData(dataId, 1)*trainData(dataId, 2) > 0)+
+      (problemType == ProblemType::Classification ? (trainData(dataId, 3) > 0.5) :
+       0.1*trainData(dataId, 3));
+  learningModel->setUseQuickScorer() = true;
+  learningModel->train(trainData, labels);
+
+  MatrixXd testData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  testData.topRows(numberOfData/2)=trainData.topRows(numberOfData/2);
+  testData(0, 0)=std::numeric_limits<double>::quiet_NaN();
+  testData(1, 1)=std::numeric_limits<double>::quiet_NaN();
+  Labels predictedLabels=learningModel->predict(testData);
+  for (long dataId=0; dataId<testData.rows(); ++dataId){
+    Map<const VectorXd> instance(&testData(dataId, 0), numberOfFeatures);
+    EXPECT_EQ(learningModel->predictOne(instance), predictedLabels._labelData(dataId));
+  }
+}
+
+TEST(QuickScorer, RandomForest_test)
+{
+  const long numberOfFeatures=5;
+  for (long maxNumberOfLeafNodes : {1L, 2L, 17L, 64L}) {
+    Models::RandomForestClassifier<> randomForest{numberOfFeatures, 3, 10, 1, 1,
+        std::numeric_limits<long>::max(), 2, maxNumberOfLeafNodes};
+    checkQuickScorer(&randomForest, ProblemType::Classification);
+  }
+}
+
+TEST(QuickScorer, GradientBoosting_test)
+{
+  const long numberOfFeatures=5;
+  for (long maxNumberOfLeafNodes : {1L, 2L, 17L, 64L}) {
+    Models::GradientBoostingRegressor gradientBoosting{numberOfFeatures, 10, 1, 1,
+        std::numeric_limits<long>::max(), maxNumberOfLeafNodes};
+    checkQuickScorer(&gradientBoosting, ProblemType::Regression);
+  }
+}
+
+TEST(QuickScorer, TooManyLeaves_test)
+{
+  const long numberOfFeatures=5;
+  Models::GradientBoostingRegressor gradientBoosting{numberOfFeatures, 2};
+  EXPECT_THROW(checkQuickScorer(&gradientBoosting, ProblemType::Regression),
+               std::runtime_error);
+}
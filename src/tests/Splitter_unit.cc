@@ -0,0 +1,303 @@
+#include <core/Definitions.hpp>
+#include <core/Utilities.hpp>
+#include <internal/_Builder.hpp>
+#include <internal/_ClassificationTree.hpp>
+#include <internal/_ClassificationCriterion.hpp>
+#include <models/TreeRegressor.hpp>
+#include <models/RandomForestClassifier.hpp>
+#include <models/BaggingClassifier.hpp>
+#include <gtest/gtest.h>
+
+using namespace Lib15x;
+
+TEST(Splitter, PresortBestSplitter_test)
+{
+  using Criterion=_ClassificationCriterion<gini>;
+
+  const long numberOfFeatures=4;
+  const long numberOfData=200;
+  const long numberOfClasses=3;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  MatrixXd testData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  VectorXd labelData(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    labelData(dataId)=rand() % numberOfClasses;
+
+  vector<long> sampleIndices;
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    sampleIndices.push_back(rand() % numberOfData);
+  vector<long> presortSampleIndices=sampleIndices;
+
+  Criterion criterion{&labelData, numberOfClasses};
+  _ClassificationTree tree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _BestSplitter> builder(1, 1, std::numeric_limits<long>::max(),
+                                                       numberOfFeatures, &criterion);
+  srand(15);
+  builder.build(trainData, &tree, &sampleIndices);
+
+  _ClassificationTree presortTree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _PresortBestSplitter>
+    presortBuilder(1, 1, std::numeric_limits<long>::max(), numberOfFeatures, &criterion);
+  srand(15);
+  presortBuilder.build(trainData, &presortTree, &presortSampleIndices);
+
+  EXPECT_EQ(tree._nodeCount, presortTree._nodeCount);
+  tree.finalize();
+  presortTree.finalize();
+  for (long dataId=0; dataId<numberOfData; ++dataId){
+    Map<const VectorXd> instance(&testData(dataId, 0), numberOfFeatures);
+    const double* labelsCount=tree.predictOne(instance);
+    const double* presortLabelsCount=presortTree.predictOne(instance);
+    EXPECT_EQ(vector<double>(labelsCount, labelsCount+numberOfClasses),
+              vector<double>(presortLabelsCount, presortLabelsCount+numberOfClasses));
+  }
+}
+
+TEST(Splitter, HistogramSplitter_test)
+{
+  using Criterion=_ClassificationCriterion<gini>;
+
+  const long numberOfFeatures=4;
+  const long numberOfData=300;
+  const long numberOfClasses=3;
+  MatrixXd trainData(numberOfData, numberOfFeatures);
+  VectorXd labelData(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId){
+    for (long featId=0; featId<numberOfFeatures; ++featId)
+      trainData(dataId, featId)=rand() % 50;
+    labelData(dataId)=rand() % numberOfClasses;
+  }
+
+  vector<long> sampleIndices(numberOfData);
+  std::iota(std::begin(sampleIndices), std::end(sampleIndices), 0);
+  vector<long> histogramSampleIndices=sampleIndices;
+
+  Criterion criterion{&labelData, numberOfClasses};
+  _ClassificationTree tree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _BestSplitter> builder(1, 1, std::numeric_limits<long>::max(),
+                                                       numberOfFeatures, &criterion);
+  srand(15);
+  builder.build(trainData, &tree, &sampleIndices);
+
+  _ClassificationTree histogramTree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _HistogramSplitter>
+    histogramBuilder(1, 1, std::numeric_limits<long>::max(), numberOfFeatures, &criterion);
+  srand(15);
+  histogramBuilder.build(trainData, &histogramTree, &histogramSampleIndices);
+
+  EXPECT_EQ(tree._nodeCount, histogramTree._nodeCount);
+  tree.finalize();
+  histogramTree.finalize();
+  for (long dataId=0; dataId<numberOfData; ++dataId){
+    Map<const VectorXd> instance(&trainData(dataId, 0), numberOfFeatures);
+    const double* labelsCount=tree.predictOne(instance);
+    const double* histogramLabelsCount=histogramTree.predictOne(instance);
+    EXPECT_EQ(vector<double>(labelsCount, labelsCount+numberOfClasses),
+              vector<double>(histogramLabelsCount, histogramLabelsCount+numberOfClasses));
+  }
+}
+
+TEST(Splitter, SketchSplitter_test)
+{
+  using Criterion=_ClassificationCriterion<gini>;
+
+  const long numberOfFeatures=4;
+  const long numberOfData=300;
+  const long numberOfClasses=3;
+  MatrixXd trainData(numberOfData, numberOfFeatures);
+  VectorXd labelData(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId){
+    for (long featId=0; featId<numberOfFeatures; ++featId)
+      trainData(dataId, featId)=rand() % 50;
+    labelData(dataId)=rand() % numberOfClasses;
+  }
+
+  // with fewer distinct values than candidates the sketch keeps every threshold
+  vector<long> sampleIndices(numberOfData);
+  std::iota(std::begin(sampleIndices), std::end(sampleIndices), 0);
+  vector<long> sketchSampleIndices=sampleIndices;
+
+  Criterion criterion{&labelData, numberOfClasses};
+  _ClassificationTree tree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _HistogramSplitter>
+    builder(1, 1, std::numeric_limits<long>::max(), numberOfFeatures, &criterion);
+  srand(15);
+  builder.build(trainData, &tree, &sampleIndices);
+
+  _ClassificationTree sketchTree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _SketchSplitter>
+    sketchBuilder(1, 1, std::numeric_limits<long>::max(), numberOfFeatures, &criterion);
+  srand(15);
+  sketchBuilder.build(trainData, &sketchTree, &sketchSampleIndices);
+
+  ASSERT_EQ(tree._nodeCount, sketchTree._nodeCount);
+  for (long nodeId=0; nodeId<tree._nodeCount; ++nodeId){
+    EXPECT_EQ(tree._nodes[nodeId]._featureIndex, sketchTree._nodes[nodeId]._featureIndex);
+    EXPECT_EQ(tree._nodes[nodeId]._threshold, sketchTree._nodes[nodeId]._threshold);
+  }
+
+  const long numberOfRegressionData=20000;
+  MatrixXd regressionData=MatrixXd::Random(numberOfRegressionData, numberOfFeatures);
+  Labels regressionLabels{ProblemType::Regression};
+  regressionLabels._labelData.resize(numberOfRegressionData);
+  for (long dataId=0; dataId<numberOfRegressionData; ++dataId)
+    regressionLabels._labelData(dataId)=regressionData(dataId, 0)*regressionData(dataId, 1);
+  Models::TreeRegressor<_WideHistogramSplitter> histogramRegressor{numberOfFeatures, 5, 5};
+  histogramRegressor.train(regressionData, regressionLabels);
+  Models::TreeRegressor<_WideSketchSplitter> sketchRegressor{numberOfFeatures, 5, 5};
+  sketchRegressor.train(regressionData, regressionLabels);
+  const double histogramLoss=Models::TreeRegressor<>::LossFunction(
+    histogramRegressor.predict(regressionData), regressionLabels);
+  const double sketchLoss=Models::TreeRegressor<>::LossFunction(
+    sketchRegressor.predict(regressionData), regressionLabels);
+  EXPECT_LT(sketchLoss, 1.5*histogramLoss+1e-4);
+}
+
+TEST(Splitter, HistogramSplitterRegression_test)
+{
+  using LearningModel=Models::TreeRegressor<>;
+  using HistogramLearningModel=Models::TreeRegressor<_WideHistogramSplitter>;
+
+  const long numberOfFeatures=2;
+  const long numberOfData=500;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  Labels labels{ProblemType::Regression};
+  labels._labelData.resize(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    labels._labelData(dataId)=trainData(dataId, 0)*trainData(dataId, 1);
+
+  LearningModel learningModel{numberOfFeatures};
+  srand(15);
+  learningModel.train(trainData, labels);
+  Labels predictedLabels=learningModel.predict(trainData);
+
+  HistogramLearningModel histogramLearningModel{numberOfFeatures};
+  srand(15);
+  histogramLearningModel.train(trainData, labels);
+  Labels histogramPredictedLabels=histogramLearningModel.predict(trainData);
+
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    EXPECT_NEAR(predictedLabels._labelData(dataId),
+                histogramPredictedLabels._labelData(dataId), 1e-10);
+}
+
+template<template<class Criterion> class _Splitter>
+void
+checkParallelSplitSearch()
+{
+  using Criterion=_ClassificationCriterion<gini>;
+
+  const long numberOfFeatures=6;
+  const long numberOfData=12000;
+  const long numberOfClasses=3;
+  const long numberOfSplitThreads=4;
+  MatrixXd trainData(numberOfData, numberOfFeatures);
+  VectorXd labelData(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId){
+    for (long featId=0; featId<numberOfFeatures; ++featId)
+      trainData(dataId, featId)=rand() % 200;
+    trainData(dataId, numberOfFeatures-1)=1.0;
+    labelData(dataId)=rand() % numberOfClasses;
+  }
+
+  vector<long> sampleIndices(numberOfData);
+  std::iota(std::begin(sampleIndices), std::end(sampleIndices), 0);
+  vector<long> parallelSampleIndices=sampleIndices;
+
+  Criterion criterion{&labelData, numberOfClasses};
+  _ClassificationTree tree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _Splitter> builder(1, 1, 8, numberOfFeatures-2, &criterion);
+  srand(15);
+  builder.build(trainData, &tree, &sampleIndices);
+
+  _ClassificationTree parallelTree{numberOfFeatures, numberOfClasses};
+  _DepthFirstBuilder<Criterion, _Splitter>
+    parallelBuilder(1, 1, 8, numberOfFeatures-2, &criterion, 1, numberOfData,
+                    numberOfSplitThreads);
+  srand(15);
+  parallelBuilder.build(trainData, &parallelTree, &parallelSampleIndices);
+
+  ASSERT_EQ(tree._nodeCount, parallelTree._nodeCount);
+  for (long nodeId=0; nodeId<tree._nodeCount; ++nodeId){
+    EXPECT_EQ(tree._nodes[nodeId]._featureIndex, parallelTree._nodes[nodeId]._featureIndex);
+    EXPECT_EQ(tree._nodes[nodeId]._threshold, parallelTree._nodes[nodeId]._threshold);
+  }
+  EXPECT_EQ(sampleIndices, parallelSampleIndices);
+}
+
+TEST(Splitter, ParallelSplitSearch_test)
+{
+  checkParallelSplitSearch<_BestSplitter>();
+  checkParallelSplitSearch<_PresortBestSplitter>();
+  checkParallelSplitSearch<_HistogramSplitter>();
+  checkParallelSplitSearch<_RandomSplitter>();
+}
+
+TEST(Splitter, RandomSplitter_test)
+{
+  const long numberOfFeatures=4;
+  const long numberOfData=1000;
+  const long numberOfClasses=2;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  MatrixXd testData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  Labels trainLabels{ProblemType::Classification};
+  Labels testLabels{ProblemType::Classification};
+  trainLabels._labelData.resize(numberOfData);
+  testLabels._labelData.resize(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId){
+    trainLabels._labelData(dataId)=trainData(dataId, 0)+trainData(dataId, 1) > 0.2;
+    testLabels._labelData(dataId)=testData(dataId, 0)+testData(dataId, 1) > 0.2;
+  }
+
+  // the classification loss counts misclassified rows; fully grown trees separate every
+  // training row
+  Models::ExtraTreeClassifier<> extraTree{numberOfFeatures, numberOfClasses};
+  extraTree.train(trainData, trainLabels);
+  EXPECT_EQ(0.0, Models::ExtraTreeClassifier<>::LossFunction(extraTree.predict(trainData),
+                                                              trainLabels));
+
+  Models::ExtraTreesClassifier<> extraTrees{numberOfFeatures, numberOfClasses, 50};
+  extraTrees.train(trainData, trainLabels);
+  Models::RandomForestClassifier<> randomForest{numberOfFeatures, numberOfClasses, 50};
+  randomForest.train(trainData, trainLabels);
+  // over 150 runs extra trees missed at most 42 of the 1000 test rows and at most 7 more
+  // than the forest
+  const double extraTreesLoss=
+    Models::ExtraTreesClassifier<>::LossFunction(extraTrees.predict(testData), testLabels);
+  EXPECT_LT(extraTreesLoss, 60);
+  EXPECT_LT(extraTreesLoss,
+            Models::RandomForestClassifier<>::LossFunction(randomForest.predict(testData),
+                                                           testLabels)+15);
+
+  Models::BaggingClassifier<Models::ExtraTreeClassifier<> >
+    bagging{numberOfFeatures, numberOfClasses, 20};
+  bagging.train(trainData, trainLabels);
+  EXPECT_LT(Models::BaggingClassifier<>::LossFunction(bagging.predict(testData), testLabels),
+            100);
+}
+
+TEST(Splitter, RandomSplitterIntegerFeatures_test)
+{
+  // at 2^53 neighbouring integers are two apart, so drawn thresholds round onto the data
+  // values; every row has its own label, so a row predicted from another leaf shows up
+  const long numberOfFeatures=3;
+  const long numberOfData=300;
+  const double offset=9007199254740992.0;
+  MatrixXd trainData(numberOfData, numberOfFeatures);
+  Labels trainLabels{ProblemType::Regression};
+  trainLabels._labelData.resize(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId){
+    long code=dataId % 27;
+    trainLabels._labelData(dataId)=static_cast<double>(code);
+    for (long featureId=0; featureId<numberOfFeatures; ++featureId, code/=3)
+      trainData(dataId, featureId)=offset+static_cast<double>(2*(code % 3));
+  }
+
+  for (long treeId=0; treeId<20; ++treeId){
+    Models::ExtraTreeRegressor extraTree{numberOfFeatures};
+    extraTree.train(trainData, trainLabels);
+    Labels predictions=extraTree.predict(trainData);
+    for (long dataId=0; dataId<numberOfData; ++dataId)
+      ASSERT_EQ(trainLabels._labelData(dataId), predictions._labelData(dataId));
+  }
+}
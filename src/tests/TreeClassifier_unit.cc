@@ -32,3 +32,45 @@ TEST(TreeClassifier, test0)
   for (long testIndex=0; testIndex<numberOfData; ++testIndex)
     EXPECT_EQ(labels._labelData[testIndex], predictedLabels._labelData(testIndex));
 }
+
+TEST(TreeClassifier, retrain_test)
+{
+  const long numberOfFeatures=4;
+  const long numberOfData=500;
+  const long numberOfClasses=3;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  Labels labels{ProblemType::Classification};
+  labels._labelData.resize(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    labels._labelData(dataId)=rand() % numberOfClasses;
+
+  Models::TreeClassifier<> learningModel{numberOfFeatures, numberOfClasses};
+  learningModel.train(trainData, labels);
+  Labels firstPredictedLabels=learningModel.predict(trainData);
+  // the second build must start from an empty tree, not the finalized one
+  learningModel.train(trainData, labels);
+  Labels predictedLabels=learningModel.predict(trainData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    EXPECT_EQ(firstPredictedLabels._labelData(dataId), predictedLabels._labelData(dataId));
+}
+
+TEST(TreeClassifier, parallel_test)
+{
+  const long numberOfFeatures=3;
+  const long numberOfData=3000;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  Labels labels{ProblemType::Classification};
+  labels._labelData.resize(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    labels._labelData(dataId)=(trainData(dataId, 0)*trainData(dataId, 1) > 0)+
+      (trainData(dataId, 2) > 0.5);
+
+  // fully grown, the tree fits the training set however its subtrees are scheduled
+  Models::TreeClassifier<> learningModel{numberOfFeatures, 3};
+  learningModel.setNumberOfThreads()=4;
+  learningModel.setMinSamplesInAParallelTask()=100;
+  learningModel.train(trainData, labels);
+  Labels predictedLabels=learningModel.predict(trainData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    EXPECT_EQ(labels._labelData(dataId), predictedLabels._labelData(dataId));
+}
@@ -0,0 +1,29 @@
+#include <core/Definitions.hpp>
+#include <core/Utilities.hpp>
+#include <gtest/gtest.h>
+
+using namespace Lib15x;
+
+TEST(Utilities, SortKeyValue_test)
+{
+  Utilities::KeyValueSortBuffer<> sortBuffer;
+  for (long size : {0, 1, 7, 64, 65, 1000, 20000}) {
+    vector<double> keys(size);
+    vector<long> values(size);
+    for (long id=0; id<size; ++id){
+      keys[id]=static_cast<double>(rand() % 200 - 100)/8.0;
+      if (id % 11 == 0) keys[id]=-0.0;
+      values[id]=id;
+    }
+    vector<double> expectedKeys=keys;
+    vector<long> expectedValues=values;
+    Utilities::sortTwoArray(std::begin(expectedKeys), std::end(expectedKeys),
+                            std::begin(expectedValues));
+
+    Utilities::sortKeyValue(keys.data(), values.data(), size, &sortBuffer);
+    EXPECT_EQ(expectedKeys, keys);
+    EXPECT_EQ(expectedValues, values);
+    for (long id=0; id<size; ++id)
+      EXPECT_EQ(std::signbit(expectedKeys[id]), std::signbit(keys[id]));
+  }
+}
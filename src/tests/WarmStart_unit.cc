@@ -0,0 +1,101 @@
+#include <core/Definitions.hpp>
+#include <core/Utilities.hpp>
+#include <models/RandomForestClassifier.hpp>
+#include <models/GradientBoostingRegressor.hpp>
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace Lib15x;
+
+template<class LearningModel>
+std::string
+codeOf(const LearningModel& learningModel)
+{
+  std::ostringstream code;
+  learningModel.generateCode(code, "predict");
+  return code.str();
+}
+
+TEST(WarmStart, RandomForest_test)
+{
+  const long numberOfFeatures=5;
+  const long numberOfData=1000;
+  const long numberOfClasses=3;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  Labels trainLabels{ProblemType::Classification};
+  trainLabels._labelData.resize(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    trainLabels._labelData(dataId)=(trainData(dataId, 0)>0)+(trainData(dataId, 1)>0.3);
+
+  Models::RandomForestClassifier<> randomForest{numberOfFeatures, numberOfClasses, 15};
+  randomForest.setRandomSeed()=15;
+  randomForest.setComputeOutOfBag()=true;
+  randomForest.train(trainData, trainLabels);
+
+  // growing 10 trees by 5 gives the forest trained with 15 at once
+  Models::RandomForestClassifier<> warmForest{numberOfFeatures, numberOfClasses, 10};
+  warmForest.setComputeOutOfBag()=true;
+  warmForest.setWarmStart()=true;
+  srand(3);
+  warmForest.train(trainData, trainLabels);
+  warmForest.addTrees(5);
+  EXPECT_THROW(warmForest.predict(trainData), std::exception);
+  warmForest.setNumberOfThreads()=2;
+  warmForest.train(trainData, trainLabels);
+
+  Models::RandomForestClassifier<> coldForest{numberOfFeatures, numberOfClasses, 15};
+  coldForest.setComputeOutOfBag()=true;
+  srand(3);
+  coldForest.train(trainData, trainLabels);
+  EXPECT_EQ(codeOf(coldForest), codeOf(warmForest));
+  EXPECT_EQ(coldForest.outOfBagVotes(), warmForest.outOfBagVotes());
+  EXPECT_EQ(coldForest.outOfBagLoss(), warmForest.outOfBagLoss());
+  EXPECT_NE(codeOf(randomForest), codeOf(warmForest));
+
+  // without warm start every tree is rebuilt
+  warmForest.setWarmStart()=false;
+  warmForest.setRandomSeed()=15;
+  warmForest.train(trainData, trainLabels);
+  EXPECT_EQ(codeOf(randomForest), codeOf(warmForest));
+}
+
+TEST(WarmStart, GradientBoosting_test)
+{
+  const long numberOfFeatures=4;
+  const long numberOfData=2000;
+  MatrixXd trainData=MatrixXd::Random(numberOfData, numberOfFeatures);
+  Labels trainLabels{ProblemType::Regression};
+  trainLabels._labelData.resize(numberOfData);
+  for (long dataId=0; dataId<numberOfData; ++dataId)
+    trainLabels._labelData(dataId)=3.0+std::sin(3.0*trainData(dataId, 0))+
+      trainData(dataId, 1)*trainData(dataId, 2);
+
+  Models::GradientBoostingRegressor gradientBoosting{numberOfFeatures, 30, 1, 1, 3};
+  gradientBoosting.setLearningRate()=0.3;
+  srand(5);
+  gradientBoosting.train(trainData, trainLabels);
+
+  Models::GradientBoostingRegressor warmBoosting{numberOfFeatures, 10, 1, 1, 3};
+  warmBoosting.setLearningRate()=0.3;
+  warmBoosting.setWarmStart()=true;
+  srand(5);
+  warmBoosting.train(trainData, trainLabels);
+  double previousLoss=Models::GradientBoostingRegressor::LossFunction(
+    warmBoosting.predict(trainData), trainLabels);
+  for (long step=0; step<2; ++step){
+    warmBoosting.addTrees(10);
+    warmBoosting.train(trainData, trainLabels);
+    const double loss=Models::GradientBoostingRegressor::LossFunction(
+      warmBoosting.predict(trainData), trainLabels);
+    EXPECT_LT(loss, previousLoss);
+    previousLoss=loss;
+  }
+  EXPECT_EQ(codeOf(gradientBoosting), codeOf(warmBoosting));
+  EXPECT_EQ(gradientBoosting.predict(trainData)._labelData,
+            warmBoosting.predict(trainData)._labelData);
+
+  Labels fewLabels{ProblemType::Regression};
+  fewLabels._labelData=trainLabels._labelData.head(10);
+  warmBoosting.addTrees(1);
+  EXPECT_THROW(warmBoosting.train(MatrixXd(trainData.topRows(10)), fewLabels), std::exception);
+}